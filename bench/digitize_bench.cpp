@@ -0,0 +1,585 @@
+// 数字化性能基准：启动开销、各数字化器的批量数字化和完整运行、随机数抽样、响应函数求值、
+// 结果写出、击中输入读取和线程扩展，结果写入 JSON 文件，便于比较不同版本或参数下的运行速度
+#include "DetectorParameters.h"
+#include "DigitizationManager.h"
+#include "HitReader.h"
+#include "ScintillationDigitizer.h"
+#include "SiPMDigitizer.h"
+#include "ADCDigitizer.h"
+#include "TotalDigitizer.h"
+#include "CountingSamplers.h"
+#include "PhiloxRandom.h"
+#include <TF1.h>
+#include <TFile.h>
+#include <TRandom3.h>
+#include <TROOT.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 基准设置
+struct BenchOptions {
+    std::vector<std::string> configs;
+    std::string output = "digitize_bench.json";
+    std::string scratchDir = "/tmp";
+    int events = 200000;
+    int repeat = 3;
+    int maxThreads = 0;    // 0 表示硬件线程数
+    bool quick = false;
+};
+
+// 一条测量结果：字段按插入顺序写出
+class BenchRecord {
+public:
+    BenchRecord& set(const std::string& key, const std::string& value) {
+        fields.emplace_back(key, "\"" + escape(value) + "\"");
+        return *this;
+    }
+    BenchRecord& set(const std::string& key, const char* value) { return set(key, std::string(value)); }
+    BenchRecord& set(const std::string& key, double value) {
+        std::ostringstream oss;
+        oss.precision(6);
+        oss << value;
+        fields.emplace_back(key, oss.str());
+        return *this;
+    }
+    BenchRecord& set(const std::string& key, int value) { return set(key, static_cast<double>(value)); }
+    BenchRecord& set(const std::string& key, bool value) {
+        fields.emplace_back(key, value ? "true" : "false");
+        return *this;
+    }
+    
+    std::string json() const {
+        std::string s = "{";
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (i > 0) s += ", ";
+            s += "\"" + fields[i].first + "\": " + fields[i].second;
+        }
+        return s + "}";
+    }
+    
+    static std::string escape(const std::string& value) {
+        std::string s;
+        for (char c : value) {
+            if (c == '"' || c == '\\') s += '\\';
+            s += c;
+        }
+        return s;
+    }
+
+private:
+    std::vector<std::pair<std::string, std::string>> fields;
+};
+
+// 测量期间屏蔽数字化器的进度输出
+class QuietOutput {
+public:
+    QuietOutput() : saved(std::cout.rdbuf(&sink)) {}
+    ~QuietOutput() { std::cout.rdbuf(saved); }
+
+private:
+    struct NullBuffer : std::streambuf {
+        int overflow(int c) override { return c; }
+    } sink;
+    std::streambuf* saved;
+};
+
+// 重复 repeat 次，返回每次的耗时（秒），按从小到大排序
+std::vector<double> timeRepeated(int repeat, const std::function<void()>& body) {
+    std::vector<double> seconds;
+    for (int r = 0; r < repeat; ++r) {
+        auto start = Clock::now();
+        body();
+        seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    return seconds;
+}
+
+// 记录 n 次操作的耗时：中位数给出 ns/次和次/秒，同时保留最快的一次
+void setTiming(BenchRecord& record, const std::vector<double>& seconds, double n, const char* unit) {
+    const double median = seconds[seconds.size() / 2];
+    record.set(std::string(unit) + "s", n)
+          .set("seconds", median)
+          .set(std::string("ns_per_") + unit, median / n * 1e9)
+          .set(std::string("ns_per_") + unit + "_min", seconds.front() / n * 1e9)
+          .set(std::string(unit) + "s_per_s", n / median);
+}
+
+std::unique_ptr<DigitizationBase> makeDigitizer(const std::string& type) {
+    if (type == "Scintillation") return std::make_unique<ScintillationDigitizer>();
+    if (type == "SiPM") return std::make_unique<SiPMDigitizer>();
+    if (type == "ADC") return std::make_unique<ADCDigitizer>();
+    return std::make_unique<TotalDigitizer>();
+}
+
+const std::vector<std::string> kDigitizers = {"Scintillation", "SiPM", "ADC", "Total"};
+
+// 低、中、高能量点 (MeV)
+const std::vector<std::pair<const char*, double>> kEnergies = {{"low", 10.0}, {"mid", 500.0}, {"high", 5000.0}};
+
+// EcalSiPMDigiVerbose 的三种模式：线性、饱和、饱和并修正
+const std::vector<int> kVerboseModes = {0, 1, 2};
+
+class Bench {
+public:
+    explicit Bench(const BenchOptions& opts) : options(opts), params(DetectorParameters::getInstance()) {}
+    
+    void runWorkload(const std::string& config) {
+        workload = config;
+        {
+            QuietOutput quiet;
+            if (!params.loadFromConfigFile(config)) {
+                std::cerr << "警告：无法加载配置文件 " << config << "，跳过该工作负载" << std::endl;
+                return;
+            }
+        }
+        baseVerbose = params.getParameter("EcalSiPMDigiVerbose");
+        std::cout << "== 工作负载 " << config << " ==" << std::endl;
+        
+        benchStartup();
+        benchDigitizers();
+        benchRun();
+        benchRandom();
+        benchResponse();
+        benchSaveResults();
+        benchHitReader();
+        benchThreads();
+        
+        params.setParameter("EcalSiPMDigiVerbose", baseVerbose);
+    }
+    
+    bool write() const {
+        std::ofstream out(options.output);
+        if (!out) {
+            std::cerr << "错误：无法写入 " << options.output << std::endl;
+            return false;
+        }
+        std::time_t now = std::time(nullptr);
+        char timestamp[32];
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+        
+        out << "{\n";
+        out << "  \"benchmark\": \"digitize_bench\",\n";
+        out << "  \"timestamp\": \"" << timestamp << "\",\n";
+        out << "  \"root_version\": \"" << gROOT->GetVersion() << "\",\n";
+        out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        out << "  \"events\": " << options.events << ",\n";
+        out << "  \"repeat\": " << options.repeat << ",\n";
+        out << "  \"results\": [\n";
+        for (size_t i = 0; i < records.size(); ++i) {
+            out << "    " << records[i].json() << (i + 1 < records.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        std::cout << "结果已写入 " << options.output << " (" << records.size() << " 条)" << std::endl;
+        return true;
+    }
+
+private:
+    BenchRecord& newRecord(const char* suite, const std::string& name) {
+        records.emplace_back();
+        return records.back().set("workload", workload).set("suite", suite).set("name", name);
+    }
+    
+    static void report(const std::string& label, double nsPerEvent) {
+        std::printf("  %-58s %12.1f ns\n", label.c_str(), nsPerEvent);
+    }
+    
+    // 单个能量点上的数字化器：tree 决定是否填充事件树
+    std::unique_ptr<DigitizationBase> prepare(const std::string& type, double energy, int verbose, bool tree) {
+        params.setParameter("EcalSiPMDigiVerbose", verbose);
+        QuietOutput quiet;
+        auto digitizer = makeDigitizer(type);
+        OutputOptions output;
+        output.level = tree ? OutputOptions::kFullTree : OutputOptions::kSummary;
+        digitizer->setOutputOptions(output);
+        digitizer->setRandomSeed(1);
+        digitizer->clearEnergyPoints();
+        digitizer->addEnergyPoint(energy);
+        // 运行一个事件以按输出级别建立直方图和事件树
+        digitizer->run(1);
+        return digitizer;
+    }
+    
+    // 启动开销：管理器构造并加载配置、各数字化器构造、一次运行的准备（直方图和事件树）
+    void benchStartup() {
+        const int n = options.quick ? 20 : 100;
+        auto measure = [&](const std::string& name, const std::function<void()>& body) {
+            auto seconds = timeRepeated(options.repeat, [&]() {
+                QuietOutput quiet;
+                for (int i = 0; i < n; ++i) body();
+            });
+            BenchRecord& record = newRecord("startup", name);
+            setTiming(record, seconds, n, "call");
+            std::printf("  %-58s %12.1f us\n", ("startup " + name).c_str(),
+                        seconds[seconds.size() / 2] / n * 1e6);
+        };
+        
+        // 与 main 相同的启动路径：数字化器在首次使用时才创建
+        measure("DigitizationManager+config", [&]() {
+            DigitizationManager manager;
+            manager.loadFromConfigFile(workload);
+        });
+        
+        for (const auto& type : kDigitizers) {
+            measure("construct " + type, [&]() { makeDigitizer(type); });
+        }
+        
+        // run(0) 只包含每次运行的准备和收尾，不抽样事件
+        for (const auto& type : kDigitizers) {
+            std::unique_ptr<DigitizationBase> digitizer;
+            {
+                QuietOutput quiet;
+                digitizer = makeDigitizer(type);
+            }
+            measure("run(0) " + type, [&]() { digitizer->run(0); });
+        }
+    }
+    
+    // 批量数字化：每批 4096 个事件，不含直方图和统计
+    void benchDigitizers() {
+        const size_t batch = 4096;
+        for (const auto& type : kDigitizers) {
+            for (const auto& energy : kEnergies) {
+                for (int verbose : kVerboseModes) {
+                    for (bool tree : {false, true}) {
+                        auto digitizer = prepare(type, energy.second, verbose, tree);
+                        std::vector<double> inputs(batch, energy.second), outputs(batch);
+                        const size_t nBatches = std::max<size_t>(1, options.events / batch);
+                        auto seconds = timeRepeated(options.repeat, [&]() {
+                            QuietOutput quiet;
+                            for (size_t b = 0; b < nBatches; ++b) {
+                                digitizer->digitizeBatch(inputs.data(), outputs.data(), batch);
+                            }
+                        });
+                        
+                        BenchRecord& record = newRecord("digitize_batch", type);
+                        record.set("digitizer", type).set("energy_label", energy.first)
+                              .set("energy_MeV", energy.second).set("verbose", verbose).set("tree", tree);
+                        setTiming(record, seconds, static_cast<double>(nBatches * batch), "event");
+                        report("batch " + type + " " + energy.first + " v" + std::to_string(verbose)
+                                       + (tree ? " tree" : ""), seconds[seconds.size() / 2] / (nBatches * batch) * 1e9);
+                    }
+                }
+            }
+        }
+    }
+    
+    // 完整运行：直方图、统计量、事件树和分辨率计算
+    void benchRun() {
+        for (const auto& type : kDigitizers) {
+            for (const auto& energy : kEnergies) {
+                for (bool tree : {false, true}) {
+                    auto digitizer = prepare(type, energy.second, static_cast<int>(baseVerbose), tree);
+                    auto seconds = timeRepeated(options.repeat, [&]() {
+                        QuietOutput quiet;
+                        digitizer->run(options.events);
+                    });
+                    
+                    BenchRecord& record = newRecord("run", type);
+                    record.set("digitizer", type).set("energy_label", energy.first)
+                          .set("energy_MeV", energy.second).set("verbose", static_cast<int>(baseVerbose))
+                          .set("tree", tree);
+                    setTiming(record, seconds, options.events, "event");
+                    report("run " + type + " " + energy.first + (tree ? " tree" : ""),
+                           seconds[seconds.size() / 2] / options.events * 1e9);
+                }
+            }
+        }
+    }
+    
+    // 随机数抽样的单次代价
+    void benchRandom() {
+        const int n = options.quick ? 1000000 : 10000000;
+        PhiloxRandom philox(1, 2);
+        TRandom3 mersenne(1);
+        std::vector<double> buffer(4096);
+        double sink = 0.0;
+        
+        auto measure = [&](const char* name, const std::function<void()>& body) {
+            auto seconds = timeRepeated(options.repeat, body);
+            BenchRecord& record = newRecord("rng", name);
+            setTiming(record, seconds, n, "draw");
+            report(std::string("rng ") + name, seconds[seconds.size() / 2] / n * 1e9);
+        };
+        
+        measure("Philox.Rndm", [&]() { for (int i = 0; i < n; ++i) sink += philox.Rndm(); });
+        measure("Philox.Gaus", [&]() { for (int i = 0; i < n; ++i) sink += philox.Gaus(0, 1); });
+        measure("Philox.fillNormals", [&]() {
+            for (int i = 0; i < n; i += 4096) {
+                philox.fillNormals(static_cast<UInt_t>(i), 0, 0, buffer.size(), buffer.data());
+                sink += buffer[0];
+            }
+        });
+        measure("TRandom3.Gaus", [&]() { for (int i = 0; i < n; ++i) sink += mersenne.Gaus(0, 1); });
+        
+        for (double mean : {5.0, 100.0, 1e5}) {
+            PoissonSampler sampler;
+            sampler.setup(mean);
+            measure(("PoissonSampler(" + std::to_string(static_cast<int>(mean)) + ")").c_str(),
+                    [&]() { for (int i = 0; i < n; ++i) sink += sampler.sample(philox); });
+            measure(("TRandom3.Poisson(" + std::to_string(static_cast<int>(mean)) + ")").c_str(),
+                    [&]() { for (int i = 0; i < n; ++i) sink += mersenne.Poisson(mean); });
+        }
+        // 衰减：光子数逐事件变化，每次都重新计算抽样常数
+        const double att = params.getParameter("EcalCryAtt");
+        BinomialSampler binomial;
+        measure("BinomialSampler(varying n)", [&]() {
+            for (int i = 0; i < n; ++i) {
+                binomial.setup(100000 + (i & 1023), att);
+                sink += binomial.sample(philox);
+            }
+        });
+        measure("TRandom3.Binomial(varying n)", [&]() {
+            for (int i = 0; i < n; ++i) sink += mersenne.Binomial(100000 + (i & 1023), att);
+        });
+        if (sink == 0.123) std::cout << sink << std::endl;
+    }
+    
+    // SiPM响应：TF1 的 Eval/GetX 与数字化链使用的解析模型和逆查找表
+    void benchResponse() {
+        const int n = options.quick ? 100000 : 1000000;
+        const int nGetX = options.quick ? 1000 : 10000;
+        TF1* response = params.getSiPMResponseFunction();
+        const SiPMResponseModel& model = params.getSiPMResponseModel();
+        double sink = 0.0;
+        
+        auto measure = [&](const char* name, int count, const std::function<void()>& body) {
+            auto seconds = timeRepeated(options.repeat, body);
+            BenchRecord& record = newRecord("response", name);
+            setTiming(record, seconds, count, "call");
+            report(std::string("response ") + name, seconds[seconds.size() / 2] / count * 1e9);
+        };
+        
+        // 光电子数在 100 到 1e5 之间对数分布
+        auto pe = [](int i, int count) { return 100.0 * std::pow(1000.0, (i % count) / static_cast<double>(count)); };
+        if (response) {
+            measure("TF1.Eval", n, [&]() { for (int i = 0; i < n; ++i) sink += response->Eval(pe(i, n)); });
+            measure("TF1.GetX", nGetX, [&]() {
+                for (int i = 0; i < nGetX; ++i) sink += response->GetX(model.response(pe(i, nGetX)));
+            });
+        }
+        measure("SiPMResponseModel.response", n, [&]() { for (int i = 0; i < n; ++i) sink += model.response(pe(i, n)); });
+        measure("invertSiPMResponse", n, [&]() {
+            for (int i = 0; i < n; ++i) sink += params.invertSiPMResponse(model.response(pe(i, n)));
+        });
+        if (sink == 0.123) std::cout << sink << std::endl;
+    }
+    
+    // saveResults 的写出速度（含全部事件树）
+    void benchSaveResults() {
+        const std::string file = options.scratchDir + "/digitize_bench_save.root";
+        for (const auto& type : kDigitizers) {
+            auto digitizer = prepare(type, kEnergies[1].second, static_cast<int>(baseVerbose), true);
+            {
+                QuietOutput quiet;
+                digitizer->run(options.events);
+            }
+            auto seconds = timeRepeated(options.repeat, [&]() {
+                QuietOutput quiet;
+                digitizer->saveResults(file);
+            });
+            std::ifstream in(file, std::ios::binary | std::ios::ate);
+            const double bytes = in ? static_cast<double>(in.tellg()) : 0.0;
+            std::remove(file.c_str());
+            
+            const double median = seconds[seconds.size() / 2];
+            BenchRecord& record = newRecord("save_results", type);
+            record.set("digitizer", type).set("events", options.events).set("bytes", bytes)
+                  .set("seconds", median).set("seconds_min", seconds.front())
+                  .set("MB_per_s", bytes / median / 1e6)
+                  .set("ns_per_event", median / options.events * 1e9);
+            std::printf("  %-58s %12.1f MB/s\n", ("saveResults " + type).c_str(), bytes / median / 1e6);
+        }
+    }
+    
+    // 击中输入：HitReader 逐条目和整篮读取每个条目一个击中的标量树、读取每个条目一个事件的向量树，
+    // 与 Total 对同样的击中做批量数字化的吞吐量比较，读取应快于数字化
+    void benchHitReader() {
+        const std::string file = options.scratchDir + "/digitize_bench_hits.root";
+        const Long64_t nHits = options.events;
+        const int hitsPerEvent = 100;
+        {
+            QuietOutput quiet;
+            TFile out(file.c_str(), "RECREATE");
+            Long64_t event = 0;
+            Int_t channel = 0;
+            Double_t edep = 0.0;
+            TTree scalar("hits", "Scalar Hits");
+            scalar.Branch("event", &event, "event/L");
+            scalar.Branch("channel", &channel, "channel/I");
+            scalar.Branch("edep", &edep, "edep/D");
+            std::vector<double> edeps;
+            std::vector<int> channels;
+            TTree vectors("eventHits", "Vector Hits");
+            vectors.Branch("event", &event, "event/L");
+            vectors.Branch("channel", &channels);
+            vectors.Branch("edep", &edeps);
+            PhiloxRandom rng(1, 3);
+            for (Long64_t i = 0; i < nHits; ++i) {
+                event = i / hitsPerEvent;
+                channel = static_cast<Int_t>(i % 10000);
+                edep = 1 + 999 * rng.Rndm();
+                scalar.Fill();
+                channels.push_back(channel);
+                edeps.push_back(edep);
+                if (channels.size() == static_cast<size_t>(hitsPerEvent) || i + 1 == nHits) {
+                    vectors.Fill();
+                    channels.clear();
+                    edeps.clear();
+                }
+            }
+            scalar.Write();
+            vectors.Write();
+        }
+        
+        std::vector<double> edeps;
+        auto measureReader = [&](const char* name, const char* treeName, bool bulkRead) {
+            HitInputOptions input;
+            input.fileName = file;
+            input.treeName = treeName;
+            input.bulkRead = bulkRead;
+            auto seconds = timeRepeated(options.repeat, [&]() {
+                QuietOutput quiet;
+                HitReader reader(input);
+                if (!reader.open()) return;
+                HitBatch batch;
+                edeps.clear();
+                while (reader.next(batch, 65536)) {
+                    edeps.insert(edeps.end(), batch.edep.begin(), batch.edep.end());
+                }
+            });
+            BenchRecord& record = newRecord("hit_reader", name);
+            setTiming(record, seconds, static_cast<double>(nHits), "hit");
+            report(std::string("hit reader ") + name, seconds[seconds.size() / 2] / nHits * 1e9);
+        };
+        measureReader("scalar", "hits", false);
+        measureReader("scalar_bulk", "hits", true);
+        measureReader("vector", "eventHits", false);
+        
+        if (!edeps.empty()) {
+            auto digitizer = prepare("Total", kEnergies[1].second, static_cast<int>(baseVerbose), false);
+            std::vector<double> outputs(edeps.size());
+            auto seconds = timeRepeated(options.repeat, [&]() {
+                QuietOutput quiet;
+                for (size_t first = 0; first < edeps.size(); first += 4096) {
+                    const size_t n = std::min<size_t>(4096, edeps.size() - first);
+                    digitizer->digitizeBatch(edeps.data() + first, outputs.data() + first, n);
+                }
+            });
+            BenchRecord& record = newRecord("hit_reader", "Total digitizeBatch");
+            record.set("digitizer", "Total");
+            setTiming(record, seconds, static_cast<double>(edeps.size()), "hit");
+            report("hit digitize Total", seconds[seconds.size() / 2] / edeps.size() * 1e9);
+        }
+        std::remove(file.c_str());
+    }
+    
+    // 线程扩展：Total 完整运行，线程数按 2 的幂增加
+    void benchThreads() {
+        const int maxThreads = options.maxThreads > 0 ? options.maxThreads
+                                                      : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<int> threadCounts;
+        for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+        threadCounts.push_back(maxThreads);
+        
+        const int events = options.events * 4;
+        double serial = 0.0;
+        for (int threads : threadCounts) {
+            auto digitizer = prepare("Total", kEnergies[1].second, static_cast<int>(baseVerbose), false);
+            digitizer->setNumberOfThreads(threads);
+            auto seconds = timeRepeated(options.repeat, [&]() {
+                QuietOutput quiet;
+                digitizer->run(events);
+            });
+            const double median = seconds[seconds.size() / 2];
+            if (threads == 1) serial = median;
+            
+            BenchRecord& record = newRecord("threads", "Total");
+            record.set("digitizer", "Total").set("threads", threads);
+            setTiming(record, seconds, events, "event");
+            record.set("speedup", serial / median);
+            std::printf("  %-58s %12.2f x\n", ("threads " + std::to_string(threads)).c_str(), serial / median);
+        }
+    }
+    
+    BenchOptions options;
+    DetectorParameters& params;
+    std::string workload;
+    double baseVerbose = 1.0;
+    std::vector<BenchRecord> records;
+};
+
+void printUsage() {
+    std::cout << "Usage: digitize_bench [options]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -h, --help                     显示帮助信息" << std::endl;
+    std::cout << "  -c, --config <file>            工作负载的配置文件，可重复 (默认: configs/default.conf configs/DS_LYSO.conf)" << std::endl;
+    std::cout << "  -n, --events <number>          每项测量的事件数 (默认: 200000)" << std::endl;
+    std::cout << "  -r, --repeat <number>          每项测量的重复次数，取中位数 (默认: 3)" << std::endl;
+    std::cout << "  -j, --max-threads <number>     线程扩展测量的最大线程数 (默认: 硬件线程数)" << std::endl;
+    std::cout << "  -o, --output <file>            JSON 结果文件 (默认: digitize_bench.json)" << std::endl;
+    std::cout << "  --scratch <dir>                saveResults 测量的临时目录 (默认: /tmp)" << std::endl;
+    std::cout << "  --quick                        减少事件数和抽样次数，用于快速检查" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if ((arg == "-c" || arg == "--config") && i + 1 < argc) {
+            options.configs.push_back(argv[++i]);
+        } else if ((arg == "-n" || arg == "--events") && i + 1 < argc) {
+            options.events = std::max(1, std::atoi(argv[++i]));
+        } else if ((arg == "-r" || arg == "--repeat") && i + 1 < argc) {
+            options.repeat = std::max(1, std::atoi(argv[++i]));
+        } else if ((arg == "-j" || arg == "--max-threads") && i + 1 < argc) {
+            options.maxThreads = std::atoi(argv[++i]);
+        } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            options.scratchDir = argv[++i];
+        } else if (arg == "--quick") {
+            options.quick = true;
+        } else {
+            std::cerr << "未知选项: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+    if (options.quick) {
+        options.events = std::min(options.events, 20000);
+        options.repeat = 1;
+    }
+    if (options.configs.empty()) {
+        options.configs = {"configs/default.conf", "configs/DS_LYSO.conf"};
+    }
+    
+    Bench bench(options);
+    for (const auto& config : options.configs) {
+        bench.runWorkload(config);
+    }
+    return bench.write() ? 0 : 1;
+}
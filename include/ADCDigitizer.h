@@ -11,13 +11,25 @@ public:
     // 数字化方法
     double digitize(double energy) override;
     
+    // 批量数字化方法
+    void digitizeBatch(const double* energies, double* outputs, size_t n,
+                       const BatchIntermediates* aux = nullptr) override;
+    
 protected:
+    // 创建并行运行的工作实例
+    std::unique_ptr<DigitizationBase> createWorker() const override;
+    
     // 覆盖树初始化方法
     void initializeTree() override;
     
     // 添加：覆盖均匀抽样树初始化方法
     void initializeSamplingTree() override;
     
+    // 将批量结果装入树分支变量
+    void loadBatchEvent(size_t i) override;
+    
+    bool hasADCStage() const override { return true; }
+    
 private:
     // 用于存储Tree数据的变量
     double inputEnergy;
@@ -26,7 +38,7 @@ private:
     double adcGainMean;
     double adcGainSigma;
     double adcGain;
-    int gainRange;
+    double gainRange;
     double outputEnergy;
 };
 
@@ -0,0 +1,74 @@
+#ifndef ANALYTIC_MODEL_H
+#define ANALYTIC_MODEL_H
+
+#include "DetectorParameters.h"
+#include <string>
+#include <vector>
+
+// 解析矩传播引擎：不抽样，沿 Total 数字化链逐级传播输出的均值和方差
+// 使用与 TotalDigitizer 相同的参数快照、饱和模型和增益档位切换逻辑；
+// 方差按来源分级记录，最后换算到重建能量 (MeV^2)
+class AnalyticModel {
+public:
+    // 方差来源
+    enum Stage {
+        kScintillation = 0,   // 闪烁光子产额涨落（Poisson 或 LOFlu）
+        kAttenuation,         // 光衰减（二项）
+        kLYNonUniformity,     // 光产额不均匀性
+        kSiPM,                // SiPM 光电子统计（含串扰）或饱和区探测器分辨率
+        kDarkNoise,           // 暗计数及其串扰
+        kGainFluctuation,     // SiPM 增益涨落
+        kElectronics,         // ADC 噪声、增益档位切换和零压缩
+        kNumStages
+    };
+    
+    static const char* stageName(int stage);
+    
+    // 单个能量点的解析结果
+    struct Result {
+        double energy = 0.0;
+        double mean = 0.0;
+        double sigma = 0.0;
+        double resolution = 0.0;          // sigma / mean
+        double linearity = 0.0;           // (mean - E) / E
+        double stageVariance[kNumStages] = {};
+        double gainFraction[3] = {};      // 三个增益档位的选中概率
+    };
+    
+    // 在构造时生成参数快照，之后的求值不再读取参数表
+    explicit AnalyticModel(const DetectorParameters& params);
+    
+    Result evaluate(double energy) const;
+    std::vector<Result> evaluate(const std::vector<double>& energies) const;
+    
+    // 打印分辨率和各级方差占比
+    static void printTable(const std::vector<Result>& results);
+
+private:
+    // 各来源的方差，按当前级的量纲记录
+    struct Moments {
+        double mean = 0.0;
+        double var[kNumStages] = {};
+        
+        double variance() const;
+        // 线性变换 y = a*x 把所有已有来源的方差乘以 a^2
+        void scale(double a);
+    };
+    
+    // 截断在 (lo, hi) 内的正态分布的概率、均值和方差
+    struct Truncated {
+        double probability = 0.0;
+        double mean = 0.0;
+        double variance = 0.0;
+    };
+    static Truncated truncatedNormal(double mean, double sigma, double lo, double hi);
+    
+    // 响应曲线的逆及其数值导数
+    double invert(double y) const;
+    double invertSlope(double y) const;
+    
+    const DetectorParameters& params;
+    ParameterSnapshot par;
+};
+
+#endif // ANALYTIC_MODEL_H
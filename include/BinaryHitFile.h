@@ -0,0 +1,118 @@
+#ifndef BINARY_HIT_FILE_H
+#define BINARY_HIT_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 定长记录的二进制击中文件（小端）：64 字节文件头之后是 nRecords 条定长记录。
+// 读取时整个文件只读映射到内存，记录按下标直接访问，不做解析和复制；
+// 格式说明见 docs/USAGE.md「二进制击中文件」
+struct BinaryHitHeader {
+    char magic[8];          // "ECALHITS" 输入击中 / "ECALDIGI" 数字化结果
+    uint32_t version;       // 格式版本
+    uint32_t recordSize;    // 每条记录的字节数
+    uint32_t flags;         // kHasTime: 含击中时间；kHasADC: 数字化结果含ADC值和增益档位
+    uint32_t reserved0;
+    uint64_t nRecords;      // 记录条数
+    uint8_t reserved[32];
+    
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kHasTime = 1u << 0;
+    static constexpr uint32_t kHasADC = 1u << 1;
+};
+static_assert(sizeof(BinaryHitHeader) == 64, "二进制击中文件头应为 64 字节");
+
+// 输入击中（16 字节）
+struct HitRecord {
+    int64_t event;
+    int32_t channel;
+    float edep;             // MeV
+};
+static_assert(sizeof(HitRecord) == 16, "HitRecord 应为 16 字节");
+
+// 含时间的输入击中（24 字节），前 16 字节与 HitRecord 相同
+struct TimedHitRecord {
+    int64_t event;
+    int32_t channel;
+    float edep;             // MeV
+    float time;             // ns
+    int32_t reserved;
+};
+static_assert(sizeof(TimedHitRecord) == 24, "TimedHitRecord 应为 24 字节");
+
+// 数字化结果（32 字节）
+struct DigiRecord {
+    int64_t event;
+    int32_t channel;
+    float edep;             // MeV
+    float energy;           // 重建能量 (MeV)
+    int32_t adc;            // 所选增益档位的ADC值，无ADC级时为 -1
+    int32_t gain;           // 增益档位，无ADC级时为 -1
+    float time;             // ns，输入不含时间时为 0
+};
+static_assert(sizeof(DigiRecord) == 32, "DigiRecord 应为 32 字节");
+
+// 映射到内存的二进制击中文件：只读打开已有文件，或按记录数创建可写文件
+class BinaryHitFile {
+public:
+    enum Kind { kHits, kDigis };
+    
+    BinaryHitFile() = default;
+    BinaryHitFile(const BinaryHitFile&) = delete;
+    BinaryHitFile& operator=(const BinaryHitFile&) = delete;
+    ~BinaryHitFile();
+    
+    // 只读映射并检查文件头
+    bool open(const std::string& filename);
+    
+    // 创建含 nRecords 条记录的文件并映射为可写，写入文件头；
+    // flags 中的 kHasTime 决定输入击中的记录长度
+    bool create(const std::string& filename, Kind kind, uint64_t nRecords, uint32_t flags);
+    
+    // 解除映射并关闭文件（可写文件先同步到磁盘）
+    void close();
+    
+    bool isOpen() const { return base != nullptr; }
+    Kind kind() const { return fileKind; }
+    bool hasTime() const { return header().flags & BinaryHitHeader::kHasTime; }
+    bool hasADC() const { return header().flags & BinaryHitHeader::kHasADC; }
+    uint64_t size() const { return header().nRecords; }
+    
+    // 输入击中：无时间和有时间的记录前 16 字节相同，time 在无时间时返回 0
+    const HitRecord& hit(uint64_t i) const {
+        return *reinterpret_cast<const HitRecord*>(records + i * stride);
+    }
+    float time(uint64_t i) const {
+        return hasTime() ? reinterpret_cast<const TimedHitRecord*>(records + i * stride)->time : 0.0f;
+    }
+    HitRecord& hit(uint64_t i) { return *reinterpret_cast<HitRecord*>(records + i * stride); }
+    void setTime(uint64_t i, float t) {
+        if (hasTime()) reinterpret_cast<TimedHitRecord*>(records + i * stride)->time = t;
+    }
+    
+    // 数字化结果
+    const DigiRecord& digi(uint64_t i) const { return reinterpret_cast<const DigiRecord*>(records)[i]; }
+    DigiRecord& digi(uint64_t i) { return reinterpret_cast<DigiRecord*>(records)[i]; }
+    
+    // 提示内核记录 [first, last) 已处理完，可以回收其中完整的页面
+    void release(uint64_t first, uint64_t last);
+    
+    // 各类型记录的长度和对应的文件头（顺序写出文件时使用）
+    static size_t recordSize(Kind kind, bool withTime);
+    static BinaryHitHeader makeHeader(Kind kind, uint64_t nRecords, uint32_t flags);
+
+private:
+    const BinaryHitHeader& header() const { return *reinterpret_cast<const BinaryHitHeader*>(base); }
+    
+    int fd = -1;
+    unsigned char* base = nullptr;
+    unsigned char* records = nullptr;
+    size_t length = 0;
+    size_t stride = 0;
+    bool writable = false;
+    Kind fileKind = kHits;
+    std::string name;
+};
+
+#endif // BINARY_HIT_FILE_H
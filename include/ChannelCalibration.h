@@ -0,0 +1,65 @@
+#ifndef CHANNEL_CALIBRATION_H
+#define CHANNEL_CALIBRATION_H
+
+#include "ParameterSnapshot.h"
+#include <Rtypes.h>
+#include <string>
+#include <vector>
+
+// 多通道刻度表：每个通道一组光产额、衰减、PDE、暗计数率、增益、基线和噪声参数
+// 读入后按字段连续存储（结构数组），第 0 行为全局参数，未列出的通道和参数使用全局值；
+// 数字化时先把批内通道号换算为行号，之后按行号顺序读取各字段数组
+class ChannelCalibration {
+public:
+    // 可以按通道设置的参数名
+    static const std::vector<std::string>& fieldNames();
+    
+    // 读取刻度文件：首个非注释行为列名（channel 和参数名），之后每行一个通道，
+    // 值为 "-" 时该通道的此参数使用全局值
+    bool load(const std::string& filename);
+    
+    // 用全局参数快照计算各通道的派生量（参数变化后需重新调用）
+    void build(const ParameterSnapshot& defaults);
+    
+    bool empty() const { return channelIds.empty(); }
+    size_t channelCount() const { return channelIds.size(); }
+    
+    // 通道号对应的行号，未列出的通道返回 0（全局参数）
+    int rowOf(Int_t channel) const;
+    void rowsOf(const Int_t* channels, int* rows, size_t n) const;
+    
+    // 每行的数字化参数（已含派生量），下标为行号
+    struct Columns {
+        std::vector<double> intLY;
+        std::vector<double> att;
+        std::vector<double> pde;
+        std::vector<double> meanDarkCount;
+        std::vector<double> darkPedestal;
+        std::vector<double> gainMean;
+        std::vector<double> gainSigmaAbs;
+        std::vector<double> pedestal;
+        std::vector<double> asicNoise;
+        std::vector<double> invPhotonNorm;
+        std::vector<double> invPENorm;
+        std::vector<double> rangeGain[3];
+        std::vector<double> rangeFEENoise[3];
+        std::vector<double> rangeADCSigma[3];
+        std::vector<double> rangePedestalMean[3];
+    };
+    const Columns& columns() const { return cols; }
+
+private:
+    // 文件中的通道号（第 r 行对应 channelIds[r-1]）和各参数列，NaN 表示使用全局值
+    std::vector<Int_t> channelIds;
+    std::vector<std::string> fileFields;
+    std::vector<std::vector<double>> fileValues;
+    
+    // 通道号 -> 行号：通道号范围不大时使用稠密数组，否则在排序后的通道号中二分查找
+    Int_t minChannel = 0;
+    std::vector<int> denseRows;
+    std::vector<std::pair<Int_t, int>> sortedRows;
+    
+    Columns cols;
+};
+
+#endif // CHANNEL_CALIBRATION_H
@@ -0,0 +1,84 @@
+#ifndef CONVOLUTION_MODEL_H
+#define CONVOLUTION_MODEL_H
+
+#include "DetectorParameters.h"
+#include "StreamingStats.h"
+#include <TH1D.h>
+#include <vector>
+
+// 等间距网格上的离散概率分布：第 i 点位于 x0 + i*dx，代表 [x - dx/2, x + dx/2) 内的概率
+struct GridPdf {
+    double x0 = 0.0;
+    double dx = 1.0;
+    std::vector<double> p;
+    
+    size_t size() const { return p.size(); }
+    double x(size_t i) const { return x0 + i * dx; }
+    
+    double total() const;
+    double mean() const;
+    double variance() const;
+    
+    // 最近点（integerLattice 时即四舍五入）或线性分配到相邻两点
+    void addPoint(double value, double mass, bool nearest);
+    
+    // 正态分布 N(mean, sigma^2) 在各点区间上的积分，只统计 [lo, hi] 内的部分
+    void addGaussian(double mean, double sigma, double mass, double lo, double hi);
+    
+    // 去掉两端累积概率低于 eps 的点
+    void trim(double eps);
+    
+    // 相邻 factor 个点合并，使点数不超过 maxPoints
+    void coarsen(size_t maxPoints);
+};
+
+// 数值卷积引擎：不抽样，直接计算 Total 数字化链输出能量的完整概率分布
+// 光子数和光电子数在整数网格上按离散分布传播（支撑过大时改用粗网格），
+// 与 Borel 串扰的暗计数分布做卷积（支撑大时用 FFT），再依次展开增益涨落、
+// 电子学噪声和增益档位切换；尾部、基线扣除的截断和档位混合都保留在分布中
+class ConvolutionModel {
+public:
+    // 单个能量点的输出分布：连续部分和零压缩置零的比例
+    struct ResponsePdf {
+        double energy = 0.0;
+        GridPdf pdf;
+        double zeroFraction = 0.0;
+    };
+    
+    // maxPoints 为各级网格的最大点数
+    explicit ConvolutionModel(const DetectorParameters& params, size_t maxPoints = 4096);
+    
+    ResponsePdf evaluate(double energy) const;
+    
+    // 按 nEvents 个事件的期望计数填充直方图（含上下溢出箱）
+    static void fillHistogram(const ResponsePdf& response, TH1D* hist, double nEvents);
+    
+    // 由分布计算与蒙特卡罗相同定义的响应汇总，entries 为名义事件数
+    static ResponseSummary summarize(const ResponsePdf& response, double rangeMin, double rangeMax,
+                                     int64_t entries);
+    
+    // 两个分布之和的分布（dx 必须相同），点数乘积较大时使用 FFT
+    static GridPdf convolve(const GridPdf& a, const GridPdf& b);
+
+private:
+    // 覆盖 [lo, hi] 的网格；integerLattice 且点数允许时使用整数网格
+    GridPdf makeGrid(double lo, double hi, bool integerLattice) const;
+    
+    // Poisson 分布：均值较小时为精确分布，否则为整数或粗网格上的正态近似
+    GridPdf poisson(double mean) const;
+    
+    // 暗计数（Poisson）与 Borel 串扰的复合分布
+    GridPdf darkCountPdf() const;
+    
+    // 电子学级：高增益ADC、档位选择、中低增益重新数字化和能量重建
+    ResponsePdf reconstruct(const GridPdf& signal, double energy) const;
+    
+    const DetectorParameters& params;
+    ParameterSnapshot par;
+    size_t maxPoints;
+    
+    // 截掉的尾部概率
+    static constexpr double kTailCut = 1e-13;
+};
+
+#endif // CONVOLUTION_MODEL_H
@@ -0,0 +1,139 @@
+#ifndef COUNTING_SAMPLERS_H
+#define COUNTING_SAMPLERS_H
+
+#include "PhiloxRandom.h"
+#include <algorithm>
+#include <cmath>
+
+// 光子数、光电子数等计数的精确抽样器（Hörmann 1993 的变换拒绝法）
+// setup 按分布参数预先计算抽样常数，参数未变化时不重新计算；固定能量点的均值不变，
+// 同一抽样器可以在整个能量点上重复使用。期望值较小时改用逆变换（逐项累加概率）
+
+// 泊松分布：均值 < 10 用逆变换，否则用 PTRS
+class PoissonSampler {
+public:
+    void setup(double mean);
+    int sample(PhiloxRandom& rng) const;
+    
+    double getMean() const { return mu; }
+
+private:
+    double mu = -1.0;
+    bool inversion = true;
+    
+    // 逆变换：P(0) = exp(-mu)
+    double expMinusMu = 1.0;
+    
+    // PTRS 常数
+    double logMu = 0.0;
+    double a = 0.0;
+    double b = 0.0;
+    double logInvAlpha = 0.0;
+    double vr = 0.0;
+    
+    // 不在快速接受区时按精确概率判断
+    bool accept(double k, double us, double V) const;
+    
+    // 逆变换的均值上限和最大项数（防止舍入使累积概率达不到均匀随机数时死循环）
+    static constexpr double kInversionLimit = 10.0;
+    static constexpr int kMaxInversionTerms = 1000;
+};
+
+// 二项分布 B(n, p)：n*min(p, 1-p) < 10 用逆变换，否则用 BTRS；p > 0.5 时对 1-p 抽样后翻转
+class BinomialSampler {
+public:
+    void setup(int n, double p);
+    int sample(PhiloxRandom& rng) const;
+    
+    int getTrials() const { return trials; }
+    double getProbability() const { return prob; }
+
+private:
+    int trials = -1;
+    double prob = -1.0;
+    
+    bool flipped = false;       // 抽样的是失败次数
+    bool inversion = true;
+    double p = 0.0;             // min(prob, 1-prob)
+    double q = 1.0;
+    double ratio = 0.0;         // p/q
+    
+    // 逆变换：P(0) = q^n
+    double probZero = 1.0;
+    
+    // BTRS 常数
+    double a = 0.0;
+    double b = 0.0;
+    double c = 0.0;
+    double alpha = 0.0;
+    double vr = 0.0;
+    double mode = 0.0;
+    
+    // 不在快速接受区时按 f(k)/f(mode) 判断
+    bool accept(double k, double us, double V) const;
+    
+    static constexpr double kInversionLimit = 10.0;
+};
+
+// 统计检验：对一组泊松均值和二项分布参数（含 p > 0.5）各抽样 nDraws 次，
+// 与精确概率比较，打印均值、方差和卡方，全部一致时返回 true
+bool checkCountingSamplers(int nDraws, PhiloxRandom& rng);
+
+inline int PoissonSampler::sample(PhiloxRandom& rng) const {
+    if (!(mu > 0)) return 0;
+    
+    if (inversion) {
+        double u = rng.Rndm();
+        double term = expMinusMu;
+        int k = 0;
+        while (u > term && k < kMaxInversionTerms) {
+            u -= term;
+            ++k;
+            term *= mu / k;
+        }
+        return k;
+    }
+    
+    for (;;) {
+        const double U = rng.Rndm() - 0.5;
+        const double V = rng.Rndm();
+        const double us = 0.5 - std::fabs(U);
+        const double k = std::floor((2 * a / us + b) * U + mu + 0.43);
+        // 快速接受区
+        if (us >= 0.07 && V <= vr) return static_cast<int>(k);
+        if (k < 0 || (us < 0.013 && V > us)) continue;
+        if (accept(k, us, V)) return static_cast<int>(k);
+    }
+}
+
+inline int BinomialSampler::sample(PhiloxRandom& rng) const {
+    if (trials <= 0 || !(p > 0)) return flipped ? std::max(trials, 0) : 0;
+    const int n = trials;
+    int k = 0;
+    
+    if (inversion) {
+        double u = rng.Rndm();
+        double term = probZero;
+        while (u > term && k < n) {
+            u -= term;
+            term *= ratio * (n - k) / (k + 1);
+            ++k;
+        }
+    } else {
+        for (;;) {
+            const double U = rng.Rndm() - 0.5;
+            const double V = rng.Rndm();
+            const double us = 0.5 - std::fabs(U);
+            const double kd = std::floor((2 * a / us + b) * U + c);
+            if (kd < 0 || kd > n) continue;
+            // 快速接受区
+            if ((us >= 0.07 && V <= vr) || accept(kd, us, V)) {
+                k = static_cast<int>(kd);
+                break;
+            }
+        }
+    }
+    return flipped ? n - k : k;
+}
+
+#endif // COUNTING_SAMPLERS_H
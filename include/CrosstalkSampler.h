@@ -0,0 +1,76 @@
+#ifndef CROSSTALK_SAMPLER_H
+#define CROSSTALK_SAMPLER_H
+
+#include <TRandom.h>
+#include <vector>
+
+// SiPM暗计数串扰抽样器
+// 每个初级暗计数触发的计数总数服从参数为 CT 的 Borel 分布：
+//   P(k) = (CT*k)^(k-1) * exp(-CT*k) / k!,  k >= 1
+// n 个初级暗计数的总计数服从 Borel-Tanner 分布：
+//   P(s|n) = n/s * (CT*s)^(s-n) * exp(-CT*s) / (s-n)!,  s >= n
+class CrosstalkSampler {
+public:
+    // 抽样模式
+    enum Mode {
+        kPerCount = 0,   // 逐个暗计数查 Borel 累积分布表
+        kCompound = 1    // 按 Borel-Tanner 条件分布一次抽出总计数
+    };
+    
+    CrosstalkSampler() = default;
+    
+    // 设置串扰概率和模式，参数未变化时不重建表
+    void configure(double crosstalk, Mode mode);
+    
+    // 对 darkCount 个初级暗计数抽样含串扰的总计数
+    int sampleTotal(int darkCount, TRandom& rng);
+    
+    // 单个暗计数触发的计数数（Borel 分布）
+    int sampleSingle(TRandom& rng) const;
+    
+    double getCrosstalk() const { return ct; }
+    Mode getMode() const { return mode; }
+    
+    // 统计检验：比较两种模式与原 TF1 逐项求和的逐计数循环，打印均值、方差和卡方
+    static bool compareWithReference(double crosstalk, double meanDarkCount, 
+                                     int nTrials, TRandom& rng);
+    
+private:
+    // 累积分布表及其引导表，引导表使逆变换抽样的期望代价为 O(1)
+    struct CdfTable {
+        int offset = 0;                 // 表中第一个值
+        std::vector<double> cdf;
+        std::vector<int> guide;
+        
+        void buildGuide();
+        int sample(double u) const;
+    };
+    
+    // n 个初级暗计数对应的 Borel-Tanner 表，按需构建；缓存已达 kMaxTannerEntries 时返回 nullptr
+    const CdfTable* tannerTable(int darkCount);
+    
+    // 按 Borel-Tanner 分布抽样 darkCount <= kMaxTannerDarkCount 个初级暗计数的总计数，
+    // 没有表时逐个暗计数抽样
+    int sampleCompound(int darkCount, TRandom& rng);
+    
+    double ct = -1.0;
+    Mode mode = kPerCount;
+    
+    // Borel 分布表（单个暗计数）
+    CdfTable borel;
+    
+    // 按初级暗计数缓存的 Borel-Tanner 表，按需构建，以及已缓存的表项总数
+    std::vector<CdfTable> tanner;
+    size_t tannerEntries = 0;
+    
+    // 累积概率截断：尾部概率低于此值时停止建表
+    static constexpr double kTailCut = 1e-12;
+    
+    // 缓存上限（每个抽样器，并行时每个工作实例各有一份）：只为不超过 kMaxTannerDarkCount 个
+    // 初级暗计数建表，更多的暗计数按 Borel-Tanner 分布对 n 的可加性拆成若干份分别抽样；
+    // 表项总数不超过 kMaxTannerEntries（约 48 MB），超过后未建表的暗计数改为逐个抽样
+    static constexpr int kMaxTannerDarkCount = 128;
+    static constexpr size_t kMaxTannerEntries = size_t(1) << 22;
+};
+
+#endif // CROSSTALK_SAMPLER_H
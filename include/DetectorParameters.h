@@ -3,9 +3,13 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <iostream>
 #include <vector>
 #include <TF1.h>
+#include "ParameterSnapshot.h"
+#include "SiPMResponseInverse.h"
+#include "SiPMResponseFunctions.h"
 #include <memory>
 
 class DetectorParameters {
@@ -22,6 +26,9 @@ public:
     // 参数设置方法
     void setParameter(const std::string& name, double value);
     
+    // 检查参数名（配置文件、命令行 -p 和 --scan），未知参数只报告一次
+    void checkParameterName(const std::string& name) const;
+    
     // 打印所有参数
     void printParameters() const;
     
@@ -44,8 +51,16 @@ public:
     // 添加获取所有参数名称的方法
     std::vector<std::string> getAllParameterNames() const;
     
+    // 生成只读参数快照（含派生量），供数字化热路径使用
+    ParameterSnapshot createSnapshot() const;
+    
     // ===== 添加SiPM响应函数 =====
     
+    // 获取共享的SiPM响应模型（编译型函数对象，供数字化热路径调用）
+    const SiPMResponseModel& getSiPMResponseModel() const { return responseModel; }
+    
+    // 以下 TF1 由响应模型导出，仅用于绘图，首次访问时创建
+    
     // 获取SiPM响应函数
     TF1* getSiPMResponseFunction();
     
@@ -63,6 +78,9 @@ public:
     
     // 更新SiPM响应函数参数
     void updateSiPMResponseParameters();
+    
+    // SiPM响应函数求逆（饱和修正），查表实现，可在多线程中调用
+    double invertSiPMResponse(double signal) const { return responseInverse.invert(signal); }
 
 private:
     // 私有构造函数（单例模式）
@@ -78,6 +96,9 @@ private:
     // 添加能量点存储
     std::vector<double> m_energyPoints;
     
+    // 已报告过的未知参数名
+    mutable std::set<std::string> reportedUnknownParameters;
+    
     // 初始化默认参数
     void initializeDefaultParameters();
     
@@ -85,12 +106,26 @@ private:
     void initializeDefaultEnergyPoints();
     
     // ===== SiPM响应函数 =====
+    SiPMResponseModel responseModel;
+    
+    // 导出的 TF1（绘图用）
     std::unique_ptr<TF1> f_SiPMResponse;
     std::unique_ptr<TF1> f_SiPMSigmaDet;
     std::unique_ptr<TF1> f_SiPMSigmaRecp;
     std::unique_ptr<TF1> f_SiPMSigmaRecm;
     std::unique_ptr<TF1> f_AsymGauss;
     
+    // SiPM响应函数的逆查找表，响应函数参数变化时重建
+    SiPMResponseInverse responseInverse;
+    
+    // 建立逆查找表时的串扰和容差，未变化时跳过重建
+    bool responseInverseBuilt = false;
+    double responseInverseCT = 0.0;
+    double responseInverseTolerance = 0.0;
+    
+    // 重建SiPM响应逆查找表
+    void buildResponseInverse();
+    
     // 初始化SiPM响应函数
     void initializeSiPMFunctions();
 };
@@ -2,18 +2,29 @@
 #define DIGITIZATION_BASE_H
 
 #include "DetectorParameters.h"
+#include "CrosstalkSampler.h"
+#include "PhiloxRandom.h"
+#include "OutputOptions.h"
+#include "StreamingStats.h"
+#include "ChannelCalibration.h"
+#include "DigitizationStages.h"
+#include "RunInstrumentation.h"
 #include <TF1.h>
-#include <TRandom3.h>
 #include <TH1D.h>
 #include <TH2D.h>
 #include <TGraph.h>
 #include <TGraphErrors.h>
 #include <TFile.h>
 #include <TTree.h>
+#include <array>
 #include <vector>
 #include <string>
 #include <memory>
 #include <chrono>
+#include <algorithm>
+#include <utility>
+
+class HitReader;
 
 class DigitizationBase {
 public:
@@ -23,17 +34,75 @@ public:
     // 数字化单个能量值
     virtual double digitize(double energy) = 0;
     
+    // 批量数字化的可选中间量输出，未请求的量保持 nullptr
+    struct BatchIntermediates {
+        double* phScin = nullptr;       // 闪烁光子数
+        double* phScinAtt = nullptr;    // 衰减后到达SiPM的光子数
+        double* peSiPM = nullptr;       // SiPM光电子数
+        double* peSiPMSat = nullptr;    // 饱和后的光电子数
+        double* dc = nullptr;           // 暗计数
+        double* dcCT = nullptr;         // 含串扰的暗计数
+        double* adcInitial = nullptr;   // 初始ADC值
+        double* gainMode = nullptr;     // 增益档位
+        double* adc = nullptr;          // 所选增益档位的ADC值
+    };
+    
+    // 批量数字化：energies[i] -> outputs[i]，共 n 个事件
+    virtual void digitizeBatch(const double* energies, double* outputs, size_t n,
+                               const BatchIntermediates* aux = nullptr);
+    
     // 运行数字化过程并生成结果
     virtual void run(int nEvents = 100000);
     
+    // 数字化外部击中：按簇批量读取 (event, channel, edep)，逐击中写出重建能量，
+    // 有ADC级的数字化器同时写出所选增益档位的ADC值和档位
+    void runHits(HitReader& reader, const std::string& outputFile);
+    
+    // 数字化二进制击中文件：输入只读映射，结果直接写入映射的二进制输出文件，
+    // 格式见 BinaryHitFile.h
+    void runHitFile(const std::string& inputFile, const std::string& outputFile);
+    
+    // 在运行前打开输出文件，事件树直接写入文件并按设定大小自动刷新
+    // 未调用时事件树保存在内存中，由 saveResults 一次写出
+    bool openOutput(const std::string& outputFile);
+    
+    // 关闭运行前打开的输出文件
+    void closeOutput();
+    
     // 保存结果
     virtual void saveResults(const std::string& outputFile);
     
     // 获取能量直方图
     std::vector<TH1D*> getEnergyHistograms() const;
     
-    // 设置随机数种子
-    void setRandomSeed(unsigned int seed) { rand.SetSeed(seed); }
+    // 设置随机数种子，直接调用 digitize 的事件序号从 0 重新计数
+    void setRandomSeed(unsigned int seed) { 
+        randomSeed = seed; 
+        rand.SetSeed(seed); 
+        streamNextEvent = 0;
+    }
+    
+    // 设置逐通道刻度表（nullptr 表示只使用全局参数），只在击中模式下按击中的通道号使用
+    void setChannelCalibration(const ChannelCalibration* table) { calibration = table; }
+    
+    // 设置事件级输出选项；分支列表中有本数字化器未声明的分支时给出警告
+    void setOutputOptions(const OutputOptions& options);
+    const OutputOptions& getOutputOptions() const { return output; }
+    
+    // 设置自适应事件数的目标精度（0 表示关闭）：每个能量点分轮运行，直到均值的
+    // 相对误差和分辨率 sigma/mean 的绝对误差都不超过该值，或达到 run 的事件数上限
+    void setTargetPrecision(double precision) { targetPrecision = precision > 0 ? precision : 0.0; }
+    double getTargetPrecision() const { return targetPrecision; }
+    
+    // 设置并行线程数（1 表示串行运行）
+    void setNumberOfThreads(int threads) { nThreads = threads > 0 ? threads : 1; }
+    int getNumberOfThreads() const { return nThreads; }
+    
+    // 设置运行报告的 JSON 文件（空字符串表示只写入输出文件的 Parameters 目录）
+    void setRunReportFile(const std::string& filename) { runReportFile = filename; }
+    
+    // 最近一次 run、runHits 或 runHitFile 的运行报告
+    const RunReport& getRunReport() const { return runReport; }
     
     // 获取结果直方图和图表的访问器
     TH1D* getResponseHistogram(double energy) const;
@@ -62,13 +131,16 @@ public:
         energies.push_back(energy);
     }
     
+    // 从 DetectorParameters 重新生成参数快照，并按需重建串扰抽样表
+    void refreshParameters();
+    
     // 更新参数
     virtual void updateParameters() {
         // 不需要重新获取参数实例，因为params是引用
         // 直接使用现有的引用即可
         
-        // 更新函数参数
-        initializeFunctions();
+        // 更新参数快照（SiPM响应函数由 DetectorParameters 共享）
+        refreshParameters();
         
         std::cout << "已更新 " << moduleName << " 数字化器的参数" << std::endl;
     }
@@ -80,8 +152,35 @@ protected:
     // 参数访问
     DetectorParameters& params;
     
-    // 随机数生成器
-    TRandom3 rand;
+    // 参数快照，digitize 热路径只读取这里的字段
+    ParameterSnapshot par;
+    
+    // 随机数生成器，密钥为（种子, 数字化器名称）
+    PhiloxRandom rand;
+    
+    // 随机数流的抽样阶段编号见 DigitizationStages.h 中的 RandomStage
+    
+    // 能量点槽位：0 为均匀抽样，i+1 为第 i 个能量点，直接调用 digitize 时使用 kDirectStreamSlot
+    static constexpr UInt_t kDirectStreamSlot = 0xFFFFFFFFu;
+    UInt_t streamEnergySlot = kDirectStreamSlot;
+    
+    // 外部击中按输入中的全局序号 h 定位：槽位 kHitStreamSlot - h / 2^32，事件序号 h mod 2^32
+    static constexpr UInt_t kHitStreamSlot = kDirectStreamSlot - 1;
+    
+    // 当前批第一个事件的序号和下一批的起始序号
+    UInt_t streamFirstEvent = 0;
+    UInt_t streamNextEvent = 0;
+    
+    // 批量数字化开始时调用：为 n 个事件分配连续的事件序号
+    void beginBatchStream(size_t n) {
+        streamFirstEvent = streamNextEvent;
+        streamNextEvent += static_cast<UInt_t>(n);
+    }
+    
+    // 定位到批内第 i 个事件在 stage 阶段的随机数流
+    void selectEventStream(size_t i, UInt_t stage) {
+        rand.setStream(streamFirstEvent + static_cast<UInt_t>(i), streamEnergySlot, stage);
+    }
     
     // 能量点
     std::vector<double> energies;
@@ -115,20 +214,29 @@ protected:
     ResolutionData resolutionData;
     LinearityData linearityData;
     
-    // 响应函数
-    std::unique_ptr<TF1> f_SiPMResponse;
-    std::unique_ptr<TF1> f_SiPMSigmaDet;
-    std::unique_ptr<TF1> f_SiPMSigmaRecp;
-    std::unique_ptr<TF1> f_SiPMSigmaRecm;
-    std::unique_ptr<TF1> f_AsymGauss;
-    std::unique_ptr<TF1> f_DarkNoise;
+    // 每个能量点的流式统计量（Welford 矩、分位数草图、直方图范围外计数）
+    std::vector<EnergyPointStats> energyStats;
+    
+    // 当前任务的统计量，任务结束后按任务顺序合并到 energyStats
+    EnergyPointStats taskStats;
+    
+    // sigma 筛选的参考统计量：相对偏差 (输出-输入)/输入 在当前任务中累计的矩。
+    // 能量点任务只有一个区间；均匀抽样任务按输入能量把抽样范围分为
+    // kFilterEnergyBins 个区间，各区间的标准差即 sigma(E)/E
+    std::vector<RunningMoments> filterMoments;
+    static constexpr int kFilterEnergyBins = 32;
+    
+    // 由 energyStats 计算的每个能量点响应汇总
+    std::vector<ResponseSummary> responseSummaries;
+    
+    // 将响应汇总树、分辨率图和线性图写入当前目录
+    void writeResponseSummary();
     
     // 2D直方图容器
     std::vector<TH2D*> histograms2D;
     
-    // 初始化函数
+    // 创建能量直方图和流式统计量，每次运行开始时调用一次
     void initializeHistograms();
-    void initializeFunctions();
     
     // 添加初始化树的方法
     virtual void initializeTree();
@@ -136,18 +244,102 @@ protected:
     // 新增：初始化均匀抽样树的方法
     virtual void initializeSamplingTree();
     
+    // 按输出级别创建或清除事件树，不写事件树时不调用 initializeTree
+    void prepareTrees();
+    void prepareSamplingTree();
+    
+    // 对挂载到输出文件的事件树设置自动刷新和自动保存
+    void configureTreeFlush(TTree* tree) const;
+    
+    // 运行期间打开的输出文件
+    std::unique_ptr<TFile> outFile;
+    std::string outFileName;
+    
     // 初始化数据树
     void initializeDataTrees();
     
-    // 计算能量分辨率（不再进行拟合）
+    // 由流式统计量计算能量分辨率和线性（不进行拟合）
     void calculateResolution();
     
-    // 计算暗噪声平均值
+    // 清空响应汇总、分辨率和线性数据
+    void clearResponseSummaries();
+    
+    // 记录一个能量点的响应汇总，并更新分辨率和线性数据
+    void recordResponseSummary(const ResponseSummary& summary);
+    
+    // 计算每个初级暗计数的平均串扰计数
     double calculateMeanCT();
     
     // 新增：执行均匀能量抽样
     void runUniformSampling(int nEvents);
     
+    // ===== 并行运行 =====
+    
+    // 运行任务：某个能量点（或均匀抽样）中的一段连续事件
+    struct RunTask {
+        int energyIndex;   // 能量点索引，-1 表示均匀抽样任务
+        int firstEvent;    // 任务内第一个事件的序号
+        int nEvents;       // 任务内的事件数
+    };
+    
+    // 每个任务的事件数
+    static constexpr int kEventsPerTask = 10000;
+    
+    // 批量数字化的块大小
+    static constexpr int kBatchSize = 4096;
+    
+    // 外部击中每批至少读入的击中数
+    static constexpr size_t kHitBatchSize = 65536;
+    
+    // 击中数字化的工作实例（串行时为空）、批内结果和刻度表行号
+    struct HitContext {
+        std::vector<std::unique_ptr<DigitizationBase>> workers;
+        std::vector<double> outputs;
+        std::vector<double> adc;
+        std::vector<double> gainMode;
+        std::vector<int> rows;
+        Long64_t nextHit = 0;           // 下一批第一个击中的全局序号
+        UInt_t savedSlot = 0;
+        UInt_t savedNextEvent = 0;
+        std::chrono::steady_clock::time_point start;
+        double inputSeconds = 0.0;      // 读取输入击中的时间
+        double digitizeSeconds = 0.0;   // digitizeHits 的墙钟时间（含并行）
+    };
+    
+    // 开始和结束击中数字化：创建工作实例、保存并恢复随机数流位置，结束时生成运行报告
+    void beginHits(HitContext& context);
+    void endHits(HitContext& context, const char* mode, Long64_t nHits, const RunningMoments& moments);
+    
+    // 数字化一批击中 edep[i]（通道号 channels[i]），结果写入 context 的各缓冲
+    void digitizeHits(HitContext& context, const double* edep, const Int_t* channels, size_t n);
+    
+    // 逐通道刻度表，以及批量数字化时批内每个事件的刻度表行号（nullptr 时使用全局参数）
+    const ChannelCalibration* calibration = nullptr;
+    const int* batchRows = nullptr;
+    
+    // 创建同类型的数字化器实例，作为并行运行的工作实例
+    virtual std::unique_ptr<DigitizationBase> createWorker() const = 0;
+    
+    // 将从 firstEvent 开始的 nEvents 个事件切分为任务并追加到任务列表
+    void appendTasks(std::vector<RunTask>& tasks, int energyIndex, int firstEvent, int nEvents) const;
+    
+    // 自适应事件数运行，maxEvents 为每个能量点的上限
+    void runAdaptive(int maxEvents);
+    
+    // 自适应模式的目标精度和每个能量点实际使用的事件数
+    double targetPrecision = 0.0;
+    std::vector<int> eventsPerPoint;
+    
+    // 执行任务列表：串行或由线程池并行执行，并合并结果
+    void runTasks(const std::vector<RunTask>& tasks, TH2D* h2Sampling);
+    
+    // 在当前实例上执行单个任务
+    void processTask(const RunTask& task, TH2D* h2Sampling);
+    
+    // 并行线程数和随机数种子
+    int nThreads = 1;
+    unsigned int randomSeed = 0;
+    
     // 新增：均匀抽样相关变量
     bool uniformSampling = false;
     double samplingMinEnergy = 0.0;
@@ -156,6 +348,139 @@ protected:
     // 保存参数到ROOT文件
     void saveParametersToFile(TFile* file);
     
+    // ===== 运行报告 =====
+    
+    // 本实例累积的计时和计数，并行运行时由各工作实例合并而来
+    RunInstrumentation instrumentation;
+    
+    // 最近一次运行的报告及其 JSON 文件名
+    RunReport runReport;
+    std::string runReportFile;
+    
+    // 运行结束时由 instrumentation 生成报告，打印并按需写出 JSON；
+    // 击中模式另给出读取输入和数字化的墙钟时间
+    void finishRunReport(const char* mode, uint64_t events, std::chrono::steady_clock::time_point start,
+                         double inputSeconds = 0.0, double digitizeSeconds = 0.0);
+    
+    // ===== 批量数字化 =====
+    
+    // 将批量结果中的第 i 个事件装入树分支变量
+    virtual void loadBatchEvent(size_t /*i*/) {}
+    
+    // 批量数字化结束后按输出级别逐事件填充事件树
+    void fillTreesFromBatch(const double* inputs, const double* outputs, size_t n);
+    
+    // 批内第 i 个事件是否发生增益档位切换，用于筛选输出
+    virtual bool isGainTransition(size_t i) const {
+        return i < eventStates.size() && eventStates[i].gainMode > 1;
+    }
+    
+    // 批内每个事件在数字化链中的状态，只在需要填充事件树时保存，由 loadBatchEvent 读取
+    std::vector<EventState> eventStates;
+    
+    // 每批各抽样阶段的标准正态数（runChain 使用）
+    std::vector<double> normalBuffers[kStageCount];
+    
+    // 是否有事件树需要填充
+    bool recordsEvents() const { return dataTree || (fillSamplingTree && samplingTree); }
+    
+    // 用编译期串联的链 Chain 数字化一批事件，cal 提供通道参数（GlobalParameters 或
+    // ChannelParameters）；按参数快照的模式组合查表选定内核，需要填充事件树时保存每个事件的状态
+    template <class Chain, class Calibration>
+    void runChain(const double* energies, double* outputs, size_t n,
+                  const BatchIntermediates* aux, const Calibration& cal) {
+        static constexpr auto kernels =
+            chainKernels<Chain, Calibration>(std::make_index_sequence<RunModes::kCount>{});
+        beginBatchStream(n);
+        (this->*kernels[RunModes::select(par).index()])(energies, outputs, n, aux, cal);
+    }
+    
+    // 链 Chain 在模式组合 Modes 下的内核：先为链用到的各阶段按块生成整批的正态数，再逐事件执行
+    template <class Chain, class Calibration, class Modes>
+    void runChainKernel(const double* energies, double* outputs, size_t n,
+                        const BatchIntermediates* aux, const Calibration& cal) {
+        constexpr unsigned kNormalStages = Chain::template normalStages<Modes>();
+        const double* normals[kStageCount] = {};
+        {
+            ScopedRunTimer timer(instrumentation, kTimerNormals);
+            for (UInt_t stage = 0; stage < kStageCount; ++stage) {
+                if (!(kNormalStages & (1u << stage))) continue;
+                normalBuffers[stage].resize(n);
+                rand.fillNormals(streamFirstEvent, streamEnergySlot, stage, n, normalBuffers[stage].data());
+                normals[stage] = normalBuffers[stage].data();
+            }
+        }
+        StageContext<Calibration, Modes> ctx{rand, crosstalk, samplers, params, par, cal,
+                                             streamFirstEvent, streamEnergySlot, normals,
+                                             instrumentation};
+        if (recordsEvents()) {
+            eventStates.resize(n);
+            runStageChain<Chain, true>(ctx, energies, outputs, n, aux, eventStates.data());
+        } else {
+            runStageChain<Chain, false>(ctx, energies, outputs, n, aux, nullptr);
+        }
+    }
+    
+    // 分派表：下标为 RunModes::index，每项是对应模式组合实例化的内核
+    template <class Chain, class Calibration, size_t... I>
+    static constexpr auto chainKernels(std::index_sequence<I...>) {
+        using Kernel = void (DigitizationBase::*)(const double*, double*, size_t,
+                                                  const BatchIntermediates*, const Calibration&);
+        return std::array<Kernel, sizeof...(I)>{
+            {&DigitizationBase::runChainKernel<Chain, Calibration, StageModesAt<I>>...}};
+    }
+    
+    // 批量数字化是否输出ADC值和增益档位
+    virtual bool hasADCStage() const { return false; }
+    
+    // 事件级输出选项
+    OutputOptions output;
+    
+    // 事件树分支的存储类型
+    enum class BranchStorage { kDouble, kFloat, kInt, kShort };
+    
+    // 声明事件树分支（在派生类构造函数中调用）：source 为 loadBatchEvent 装入的变量，
+    // storage 为精简存储类型
+    void declareBranch(const char* name, const double* source, BranchStorage storage);
+    
+    // 按输出选项（存储类型、分支选择）在事件树上创建已声明的分支
+    void createBranches(TTree* tree);
+    
+    // 将 loadBatchEvent 装入的变量转换到分支缓冲区
+    void storeBranches();
+    
+    // 已写出分支的 "名称/类型" 列表，记录到 Parameters 目录
+    std::string describeBranches() const;
+    
+    struct TreeBranch {
+        std::string name;
+        const double* source;
+        BranchStorage storage;     // 精简存储类型
+        BranchStorage written;     // 实际写出的类型
+        bool active;               // 是否被选中写出
+        union {
+            Double_t d;
+            Float_t f;
+            Int_t i;
+            Short_t s;
+        } buffer;
+    };
+    
+    // 声明后不再增删，分支缓冲区地址保持不变
+    std::vector<TreeBranch> treeBranches;
+    
+    // 批内事件是否写入事件树
+    std::vector<char> outputSelection;
+    
+    // 是否同时填充均匀抽样树
+    bool fillSamplingTree = false;
+    
+    // 暗计数串扰抽样器，EcalSiPMCT 变化时重建
+    CrosstalkSampler crosstalk;
+    
+    // 光子数、光电子数和暗计数的抽样器
+    StageSamplers samplers;
+    
     double inputEnergy;  // 输入能量
 };
 
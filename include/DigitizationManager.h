@@ -5,6 +5,7 @@
 #include "SiPMDigitizer.h"
 #include "ADCDigitizer.h"
 #include "TotalDigitizer.h"
+#include "HitReader.h"
 #include <memory>
 #include <string>
 
@@ -20,6 +21,18 @@ public:
     // 设置事件数
     void setNumberOfEvents(int events) { nEvents = events; }
     
+    // 设置并行线程数
+    void setNumberOfThreads(int threads);
+    
+    // 设置自适应事件数的目标精度（0 表示关闭），事件数作为每个能量点的上限
+    void setTargetPrecision(double precision);
+    
+    // 设置事件级输出选项（所有数字化器）
+    void setOutputOptions(const OutputOptions& options);
+    
+    // 是否为每次运行另外写出 JSON 运行报告 <输出文件名>_report.json
+    void setRunReportJSON(bool enable) { runReportJSON = enable; }
+    
     // 加载参数文件
     bool loadParameters(const std::string& filename);
     
@@ -30,13 +43,42 @@ public:
     void runSingleDigitizer(const std::string& digitizerType, 
                            const std::string& outputPrefix = "");
     
+    // 读取逐通道刻度表，击中模式下按击中的通道号使用
+    bool loadChannelCalibration(const std::string& filename);
+    
+    // 用指定的数字化器处理外部击中树，输出 <prefix>_<type>_hits.root
+    void runHits(const HitInputOptions& input, const std::string& digitizerType,
+                 const std::string& outputPrefix = "");
+    
+    // 用指定的数字化器处理二进制击中文件，输出 <prefix>_<type>_hits.bin
+    void runHitFile(const std::string& inputFile, const std::string& digitizerType,
+                    const std::string& outputPrefix = "");
+    
+    // 把击中树转换为二进制击中文件
+    bool convertHitsToBinary(const HitInputOptions& input, const std::string& outputFile);
+    
+    // 把二进制数字化结果转换为与击中模式相同格式的 digiHits 树
+    bool convertDigiToRoot(const std::string& inputFile, const std::string& outputFile);
+    
     // 运行所有数字化器
     void runAllDigitizers(const std::string& outputPrefix = "");
     
-    // 扫描参数
+    // 解析矩传播：用当前参数计算各能量点的分辨率和各级方差，不运行蒙特卡罗
+    void runAnalytic(const std::string& outputPrefix = "");
+    
+    // 数值卷积：由 Total 链输出能量的完整分布生成与蒙特卡罗相同格式的结果文件
+    void runConvolution(const std::string& outputPrefix = "");
+    
+    // 生成快速模拟用的响应查找表（对数能量网格 [eMin, eMax] 上 nEnergies 个点），
+    // 并在配置的能量点上与直接 digitize 的输出比较，KS 距离超过容许值时返回 false
+    bool buildResponseTable(const std::string& outputPrefix = "", double eMin = 1.0,
+                            double eMax = 10000.0, int nEnergies = 81);
+    
+    // 扫描参数；analytic 为 true 时只做解析预扫描
     void scanParameter(const std::string& paramName, 
                       const std::vector<double>& values,
-                      const std::string& outputDir = "param_scan");
+                      const std::string& outputDir = "param_scan",
+                      bool analytic = false);
                       
     // 获取参数值
     double getParameter(const std::string& name);
@@ -61,15 +103,77 @@ public:
     // 更新所有数字化器的参数
     void updateDigitizersParameters();
     
+    // 用当前参数检验串扰抽样器与原逐计数循环的一致性
+    bool checkCrosstalkSampler(int nTrials = 1000000);
+    
+    // 检验光子数、光电子数等计数抽样器与精确概率分布的一致性
+    bool checkCountingSamplers(int nDraws = 1000000);
+    
 private:
-    // 数字化器实例
+    // 按类型名查找数字化器，未知类型时返回 nullptr
+    DigitizationBase* findDigitizer(const std::string& type);
+    
+    // 击中模式下为数字化器设置逐通道刻度表（已加载时）
+    void applyChannelCalibration(DigitizationBase* digitizer);
+    
+    // 按输出文件名设置数字化器的 JSON 运行报告文件（未启用时清空）
+    void applyRunReportFile(DigitizationBase* digitizer, const std::string& outputFile);
+    
+    // 首次使用时创建数字化器，并应用当前的运行设置
+    template <class T>
+    T* obtain(std::unique_ptr<T>& digitizer) {
+        if (!digitizer) {
+            digitizer = std::make_unique<T>();
+            configureDigitizer(*digitizer);
+        }
+        return digitizer.get();
+    }
+    
+    // 把种子、线程数、输出选项等运行设置应用到新建的数字化器
+    void configureDigitizer(DigitizationBase& digitizer) const;
+    
+    // 对已创建的数字化器逐个调用 f，设置方法只需更新已有实例
+    template <class F>
+    void forEachDigitizer(F f) {
+        DigitizationBase* digitizers[] = {scinDigitizer.get(), sipmDigitizer.get(),
+                                          adcDigitizer.get(), totalDigitizer.get()};
+        for (DigitizationBase* digitizer : digitizers) {
+            if (digitizer) f(*digitizer);
+        }
+    }
+    
+    // 把能量点设置到已创建的数字化器（新建的数字化器从 DetectorParameters 读取）
+    void applyEnergyPoints(const std::vector<double>& energies);
+    
+    // 生成响应查找表时每个网格能量点直接数字化的事件数，以及验证时 KS 容许值中的插值误差
+    static constexpr int kResponseTableSamples = 500000;
+    static constexpr double kResponseTableKSInterpolation = 0.005;
+    
+    // 数字化器实例，首次使用时创建
     std::unique_ptr<ScintillationDigitizer> scinDigitizer;
     std::unique_ptr<SiPMDigitizer> sipmDigitizer;
     std::unique_ptr<ADCDigitizer> adcDigitizer;
     std::unique_ptr<TotalDigitizer> totalDigitizer;
     
+    // 逐通道刻度表
+    ChannelCalibration calibration;
+    
     // 事件数
     int nEvents;
+    
+    // 随机数种子
+    unsigned int randomSeed = 0;
+    
+    // 新建数字化器时应用的运行设置
+    int nThreads = 1;
+    double targetPrecision = 0.0;
+    OutputOptions outputOptions;
+    bool uniformSampling = false;
+    double samplingMinEnergy = 0.0;
+    double samplingMaxEnergy = 0.0;
+    
+    // 是否写出 JSON 运行报告
+    bool runReportJSON = false;
 };
 
 #endif // DIGITIZATION_MANAGER_H 
\ No newline at end of file
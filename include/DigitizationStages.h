@@ -0,0 +1,681 @@
+#ifndef DIGITIZATION_STAGES_H
+#define DIGITIZATION_STAGES_H
+
+#include "DetectorParameters.h"
+#include "CrosstalkSampler.h"
+#include "ChannelCalibration.h"
+#include "CountingSamplers.h"
+#include "PhiloxRandom.h"
+#include "RunInstrumentation.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// 数字化链的各级在编译期串联：每一级是一个无状态的类型，apply 读写单个事件的状态，
+// StageChain<级1, 级2, ...> 把它们展开为一个逐事件的内核。单级数字化器、Total 和
+// 任意子链（例如 SiPM+ADC）都由同一组级组合而成，整条链在一个循环体内内联，
+// 中间量留在寄存器中，只在需要填充事件树时才逐事件保存
+
+// 随机数流的抽样阶段编号，每个事件的每个阶段使用独立的流
+enum RandomStage : UInt_t {
+    kStageInputEnergy = 0,   // 均匀抽样的输入能量（按事件序号跳跃定位）
+    kStageLYFactor,          // 光产额不均匀因子
+    kStageScinGen,           // 闪烁光子产生
+    kStageAttenuation,       // 光衰减
+    kStageSiPMSat,           // SiPM饱和
+    kStageDarkCount,         // 暗计数和串扰
+    kStageGainFluc,          // 增益涨落
+    kStageADCHigh,           // 高增益ADC
+    kStageADCRange,          // 中、低增益ADC
+    kStageCount
+};
+
+// 单个事件在链中的状态，各级只读写自己用到的字段
+struct EventState {
+    double energy = 0.0;        // 输入能量 (MeV)
+    
+    // 闪烁体
+    double lyFactor = 0.0;      // 光产额不均匀因子
+    double phScin = 0.0;        // 闪烁光子数
+    double phScinAtt = 0.0;     // 衰减后的光子数
+    double phScinAttLYRand = 0.0;
+    
+    // SiPM
+    double peSiPM = 0.0;        // 光电子数
+    double peSiPMSat = 0.0;     // 饱和后的光电子数
+    double dc = 0.0;            // 暗计数
+    double dcCT = 0.0;          // 含串扰的暗计数
+    double peTotal = 0.0;       // 光信号 + 暗噪声
+    double gainFluc = 0.0;      // 增益涨落后的光电子数
+    double pedSub = 0.0;        // 扣除暗噪声基线
+    double pedSubCorr = 0.0;    // 饱和修正后的光电子数
+    
+    // ADC
+    double signal = 0.0;        // 送入ADC的光电子数
+    double adcMean = 0.0;       // 所选档位的ADC均值
+    double adcSigma = 0.0;      // 所选档位的ADC噪声
+    double adcInitial = 0.0;    // 高增益ADC值
+    double gainMode = 0.0;      // 增益档位 1/2/3
+    double adc = 0.0;           // 所选档位的ADC值
+    double adcCorr = 0.0;       // 饱和修正后的ADC值
+    double gain = 0.0;          // 所选档位的增益
+    double noiseFEE = 0.0;
+    double noiseASIC = 0.0;
+    double pedMean = 0.0;       // 所选档位含暗噪声的基线
+    
+    double output = 0.0;        // 重建能量 (MeV)
+};
+
+// 通道参数访问：全局参数，批内所有事件相同
+struct GlobalParameters {
+    const ParameterSnapshot& p;
+    
+    double intLY(size_t) const { return p.EcalCryIntLY; }
+    double att(size_t) const { return p.EcalCryAtt; }
+    double pde(size_t) const { return p.EcalSiPMPDE; }
+    double meanDarkCount(size_t) const { return p.meanDarkCount; }
+    double darkPedestal(size_t) const { return p.darkPedestal; }
+    double gainMean(size_t) const { return p.EcalSiPMGainMean; }
+    double gainSigmaAbs(size_t) const { return p.gainSigmaAbs; }
+    double pedestal(size_t) const { return p.Pedestal; }
+    double asicNoise(size_t) const { return p.EcalASICNoiseSigma; }
+    double invPhotonNorm(size_t) const { return p.invPhotonNorm; }
+    double invPENorm(size_t) const { return p.invPENorm; }
+    double rangeGain(size_t, int g) const { return p.rangeGain[g]; }
+    double rangeFEENoise(size_t, int g) const { return p.rangeFEENoise[g]; }
+    double rangeADCSigma(size_t, int g) const { return p.rangeADCSigma[g]; }
+    double rangePedestalMean(size_t, int g) const { return p.rangePedestalMean[g]; }
+};
+
+// 通道参数访问：按批内事件的刻度表行号读取各字段数组
+struct ChannelParameters {
+    const ChannelCalibration::Columns& c;
+    const int* rows;
+    
+    double intLY(size_t i) const { return c.intLY[rows[i]]; }
+    double att(size_t i) const { return c.att[rows[i]]; }
+    double pde(size_t i) const { return c.pde[rows[i]]; }
+    double meanDarkCount(size_t i) const { return c.meanDarkCount[rows[i]]; }
+    double darkPedestal(size_t i) const { return c.darkPedestal[rows[i]]; }
+    double gainMean(size_t i) const { return c.gainMean[rows[i]]; }
+    double gainSigmaAbs(size_t i) const { return c.gainSigmaAbs[rows[i]]; }
+    double pedestal(size_t i) const { return c.pedestal[rows[i]]; }
+    double asicNoise(size_t i) const { return c.asicNoise[rows[i]]; }
+    double invPhotonNorm(size_t i) const { return c.invPhotonNorm[rows[i]]; }
+    double invPENorm(size_t i) const { return c.invPENorm[rows[i]]; }
+    double rangeGain(size_t i, int g) const { return c.rangeGain[g][rows[i]]; }
+    double rangeFEENoise(size_t i, int g) const { return c.rangeFEENoise[g][rows[i]]; }
+    double rangeADCSigma(size_t i, int g) const { return c.rangeADCSigma[g][rows[i]]; }
+    double rangePedestalMean(size_t i, int g) const { return c.rangePedestalMean[g][rows[i]]; }
+};
+
+// ===== 运行模式 =====
+// 整个运行期间不变的模式开关在每批开始前选定一次，按模式组合分派到各自实例化的内核，
+// 各级用编译期常量分支，逐事件的代码中不再检查模式。
+// 新增模式值：在枚举的 kCount 之前加一项，并在 RunModes::select 中给出判定；
+// 新增模式维度：在 StageModes、RunModes 和 StageModesAt 中各加一个参数
+
+// 闪烁光子数涨落：泊松（EcalCryLOFlu == 0）或按 EcalCryLOFlu 的高斯涨落
+enum class LightOutputMode { kPoisson, kGaussian, kCount };
+
+// SiPM响应（EcalSiPMDigiVerbose）：0 线性，其余启用饱和响应，>= 2 时重建时再做饱和修正
+enum class SiPMResponseMode { kLinear, kSaturated, kCorrected, kCount };
+
+// 编译期的模式组合，作为 StageContext 的模板参数传给各级
+template <LightOutputMode kLight, SiPMResponseMode kSiPM>
+struct StageModes {
+    static constexpr LightOutputMode lightOutput = kLight;
+    static constexpr SiPMResponseMode sipmResponse = kSiPM;
+};
+
+// 运行期的模式组合及其在分派表中的下标
+struct RunModes {
+    LightOutputMode lightOutput;
+    SiPMResponseMode sipmResponse;
+    
+    static constexpr size_t kLightCount = static_cast<size_t>(LightOutputMode::kCount);
+    static constexpr size_t kSiPMCount = static_cast<size_t>(SiPMResponseMode::kCount);
+    static constexpr size_t kCount = kLightCount * kSiPMCount;
+    
+    static RunModes select(const ParameterSnapshot& par) {
+        RunModes m;
+        m.lightOutput = par.EcalCryLOFlu == 0.0 ? LightOutputMode::kPoisson : LightOutputMode::kGaussian;
+        if (par.EcalSiPMDigiVerbose == 0) {
+            m.sipmResponse = SiPMResponseMode::kLinear;
+        } else if (par.EcalSiPMDigiVerbose >= 2) {
+            m.sipmResponse = SiPMResponseMode::kCorrected;
+        } else {
+            m.sipmResponse = SiPMResponseMode::kSaturated;
+        }
+        return m;
+    }
+    
+    size_t index() const {
+        return static_cast<size_t>(lightOutput) * kSiPMCount + static_cast<size_t>(sipmResponse);
+    }
+};
+
+// 分派表下标对应的编译期模式组合（与 RunModes::index 互逆）
+template <size_t I>
+using StageModesAt = StageModes<static_cast<LightOutputMode>(I / RunModes::kSiPMCount),
+                                static_cast<SiPMResponseMode>(I % RunModes::kSiPMCount)>;
+
+// 各计数级的抽样器，抽样常数在均值不变时跨事件复用
+struct StageSamplers {
+    PoissonSampler detected;        // 泊松模式下到达SiPM的光子数
+    PoissonSampler lost;            // 泊松模式下衰减损失的光子数
+    BinomialSampler attenuation;    // 高斯模式下衰减后的光子数
+    PoissonSampler photoelectrons;  // 线性区的光电子数
+    PoissonSampler darkCount;       // 初级暗计数
+};
+
+// 各级共用的运行环境：随机数流、参数快照、通道参数、模式组合和当前事件在批内的序号
+template <class Calibration, class StageModesT>
+struct StageContext {
+    using Modes = StageModesT;
+    
+    PhiloxRandom& rand;
+    CrosstalkSampler& crosstalk;
+    StageSamplers& samplers;
+    const DetectorParameters& params;
+    const ParameterSnapshot& par;
+    const Calibration& cal;
+    UInt_t firstEvent;
+    UInt_t energySlot;
+    const double* const* normals;   // 各阶段批内的标准正态数，链未用到的阶段为空
+    RunInstrumentation& stats;
+    size_t i = 0;
+    
+    // 定位到当前事件在 stage 阶段的随机数流
+    void select(UInt_t stage) {
+        rand.setStream(firstEvent + static_cast<UInt_t>(i), energySlot, stage);
+    }
+    
+    // 当前事件在 stage 阶段的正态抽样，等同于 select(stage) 后调用 rand.Gaus
+    double gaus(UInt_t stage, double mean, double sigma) const {
+        return mean + sigma * normals[stage][i];
+    }
+    
+    // 计数器（DIGITIZATION_INSTRUMENTATION=0 时为空操作）
+    void count(RunCounter c, uint64_t k = 1) const { stats.count(c, k); }
+};
+
+// 对单个事件的一级计时，计入该级在模式组合下所属的计时器
+template <class Stage, class Context>
+void profileStage(Context& ctx, EventState& s) {
+    const auto start = std::chrono::steady_clock::now();
+    Stage::apply(ctx, s);
+    ctx.stats.addStageSample(Stage::template timer<typename Context::Modes>(),
+                             std::chrono::steady_clock::now() - start);
+}
+
+// 级的编译期串联；store 把各级的中间量写到按需请求的输出数组，
+// normalStages 为各级在模式组合 Modes 下需要预先生成正态数的阶段（按位），
+// applyProfiled 与 apply 相同但逐级计时
+template <class... Stages>
+struct StageChain {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        (Stages::apply(ctx, s), ...);
+    }
+    
+    template <class Context>
+    static void applyProfiled(Context& ctx, EventState& s) {
+        (profileStage<Stages>(ctx, s), ...);
+    }
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() {
+        return (Stages::template normalStages<Modes>() | ... | 0u);
+    }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        (Stages::store(aux, s, i), ...);
+    }
+};
+
+// 级的默认 store（不输出中间量）、normalStages（不用正态数）和 timer（算术级）
+struct StageBase {
+    template <class Intermediates>
+    static void store(const Intermediates&, const EventState&, size_t) {}
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() { return 0; }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerOtherStages; }
+};
+
+// ===== 闪烁体 =====
+
+// 光产额不均匀因子
+struct LightYieldStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        s.lyFactor = ctx.gaus(kStageLYFactor, 1.0, ctx.par.EcalCryLYUn);
+    }
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() { return 1u << kStageLYFactor; }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerSamplingStages; }
+};
+
+// 闪烁光子产生：泊松涨落，或按 EcalCryLOFlu 的高斯涨落。
+// 泊松模式下直接按泊松分布的稀疏化抽取到达和损失的光子数：
+// Poisson(mean) 中每个光子以概率 att 到达，等价于两个独立的 Poisson(mean*att)
+// 和 Poisson(mean*(1-att))，两个均值在同一能量点上不变，抽样常数只计算一次
+struct ScintillationStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const double mean = s.energy * ctx.cal.intLY(ctx.i);
+        if constexpr (Context::Modes::lightOutput == LightOutputMode::kPoisson) {
+            const double att = std::min(ctx.cal.att(ctx.i), 1.0);
+            ctx.select(kStageAttenuation);
+            ctx.samplers.detected.setup(mean * att);
+            s.phScinAtt = ctx.samplers.detected.sample(ctx.rand);
+            ctx.select(kStageScinGen);
+            ctx.samplers.lost.setup(mean * (1 - att));
+            s.phScin = s.phScinAtt + ctx.samplers.lost.sample(ctx.rand);
+        } else {
+            s.phScin = std::round(ctx.gaus(kStageScinGen, mean, mean * ctx.par.EcalCryLOFlu));
+        }
+    }
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() {
+        return Modes::lightOutput == LightOutputMode::kGaussian ? 1u << kStageScinGen : 0u;
+    }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerSamplingStages; }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.phScin) aux.phScin[i] = s.phScin;
+    }
+};
+
+// 光衰减后到达SiPM的光子数：高斯模式下对光子数做精确的二项抽样，
+// 泊松模式下已由 ScintillationStage 抽出
+struct AttenuationStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        if constexpr (Context::Modes::lightOutput == LightOutputMode::kGaussian) {
+            const int ScinGen = s.phScin;
+            ctx.select(kStageAttenuation);
+            ctx.samplers.attenuation.setup(ScinGen, ctx.cal.att(ctx.i));
+            s.phScinAtt = ctx.samplers.attenuation.sample(ctx.rand);
+        }
+    }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerSamplingStages; }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.phScinAtt) aux.phScinAtt[i] = s.phScinAtt;
+    }
+};
+
+// 给光子数加上光产额不均匀
+struct LightYieldSmearStage : StageBase {
+    template <class Context>
+    static void apply(Context&, EventState& s) {
+        s.phScinAttLYRand = std::max(std::round(s.phScinAtt * s.lyFactor), 0.0);
+    }
+};
+
+// 闪烁体单级的输出：光子数换算回能量
+struct PhotonEnergyStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        s.output = s.phScinAttLYRand * ctx.cal.invPhotonNorm(ctx.i);
+    }
+};
+
+// ===== SiPM =====
+
+// 由到达的光子数抽取整数光电子数（接在闪烁体级之后）
+struct PhotonDetectionStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        s.peSiPM = std::round(s.phScinAttLYRand * ctx.cal.pde(ctx.i));
+    }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.peSiPM) aux.peSiPM[i] = s.peSiPM;
+    }
+};
+
+// 由输入能量直接得到光电子数的期望值（SiPM、ADC 单级的输入，不含闪烁体涨落），
+// 同时作为ADC的输入信号
+struct ExpectedPhotoelectronStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const size_t i = ctx.i;
+        s.peSiPM = s.energy * (ctx.cal.intLY(i) * ctx.cal.att(i) * ctx.cal.pde(i));
+        s.signal = s.peSiPM;
+    }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.peSiPM) aux.peSiPM[i] = s.peSiPM;
+    }
+};
+
+// SiPM饱和：低光强或未启用饱和模型时为泊松涨落加串扰，否则按响应函数抽样
+struct SaturationStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const double NPE = s.peSiPM;
+        double NPESat = 0.0;
+        if (Context::Modes::sipmResponse == SiPMResponseMode::kLinear || NPE < 100) {
+            ctx.select(kStageSiPMSat);
+            ctx.samplers.photoelectrons.setup(NPE);
+            NPESat = ctx.samplers.photoelectrons.sample(ctx.rand) * (1 + ctx.par.EcalSiPMCT);
+        } else {
+            const SiPMResponseModel& model = ctx.params.getSiPMResponseModel();
+            double NPE_ = model.response(NPE);
+            NPESat = ctx.gaus(kStageSiPMSat, NPE_, model.sigmaDet(NPE_));
+        }
+        if (NPESat < 0) ctx.count(kCounterClampedPhotoelectrons);
+        s.peSiPMSat = std::max(NPESat, 0.0);
+    }
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() {
+        return Modes::sipmResponse != SiPMResponseMode::kLinear ? 1u << kStageSiPMSat : 0u;
+    }
+    
+    // 线性模式只做泊松抽样，其余模式主要是响应函数的计算
+    template <class Modes>
+    static constexpr RunTimer timer() {
+        return Modes::sipmResponse == SiPMResponseMode::kLinear ? kTimerSamplingStages : kTimerResponseStages;
+    }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.peSiPMSat) aux.peSiPMSat[i] = s.peSiPMSat;
+    }
+};
+
+// 暗计数和串扰
+struct DarkNoiseStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        ctx.select(kStageDarkCount);
+        ctx.samplers.darkCount.setup(ctx.cal.meanDarkCount(ctx.i));
+        const int darkCount = ctx.samplers.darkCount.sample(ctx.rand);
+        s.dc = darkCount;
+        s.dcCT = ctx.crosstalk.sampleTotal(darkCount, ctx.rand);
+        if (kInstrumentation && darkCount > 0) {
+            ctx.count(kCounterDarkCounts, darkCount);
+            ctx.count(kCounterCrosstalkCounts, static_cast<uint64_t>(s.dcCT) - darkCount);
+            if (ctx.crosstalk.getCrosstalk() > 0) {
+                ctx.count(kCounterCrosstalkIterations,
+                          ctx.crosstalk.getMode() == CrosstalkSampler::kCompound ? 1 : darkCount);
+            }
+        }
+    }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerSamplingStages; }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.dc) aux.dc[i] = s.dc;
+        if (aux.dcCT) aux.dcCT[i] = s.dcCT;
+    }
+};
+
+// 增益涨落；kClampCharge 时负电荷截断为 0（SiPM 单级），否则留到扣除基线后截断
+template <bool kClampCharge>
+struct GainFluctuationStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const size_t i = ctx.i;
+        const double SiPMGainMean = ctx.cal.gainMean(i);
+        s.peTotal = s.peSiPMSat + s.dcCT;
+        double SiPMCharge = ctx.gaus(kStageGainFluc, s.peTotal * SiPMGainMean, std::sqrt(s.peTotal) * ctx.cal.gainSigmaAbs(i));
+        if (kClampCharge && SiPMCharge < 0) {
+            ctx.count(kCounterClampedCharge);
+            SiPMCharge = 0.0;
+        }
+        s.gainFluc = SiPMCharge / SiPMGainMean;
+    }
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() { return 1u << kStageGainFluc; }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerSamplingStages; }
+};
+
+// 扣除暗噪声基线；kClampSignal 时负信号截断为 0（Total）
+template <bool kClampSignal>
+struct PedestalSubtractionStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        s.pedSub = s.gainFluc - ctx.cal.darkPedestal(ctx.i);
+        if (kClampSignal && s.pedSub < 0) {
+            ctx.count(kCounterClampedSignal);
+            s.pedSub = 0.0;
+        }
+    }
+};
+
+// SiPM 单级的输出：按需做饱和修正后换算回能量
+struct SiPMEnergyStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        if constexpr (Context::Modes::sipmResponse == SiPMResponseMode::kCorrected) {
+            s.pedSubCorr = ctx.params.invertSiPMResponse(s.pedSub);
+        } else {
+            s.pedSubCorr = s.pedSub;
+        }
+        s.output = s.pedSubCorr * ctx.cal.invPENorm(ctx.i);
+    }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() {
+        return Modes::sipmResponse == SiPMResponseMode::kCorrected ? kTimerResponseStages : kTimerOtherStages;
+    }
+};
+
+// 积分门宽内的信号比例，作为ADC的输入信号
+struct TimeWindowStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        s.signal = s.pedSub * ctx.par.EcalRatioTimeInterval;
+    }
+};
+
+// ===== ADC =====
+
+// 高增益ADC值
+struct HighGainADCStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const size_t i = ctx.i;
+        s.adcMean = s.signal * ctx.cal.rangeGain(i, 0) + ctx.cal.pedestal(i);
+        int adc = std::round(ctx.gaus(kStageADCHigh, s.adcMean, ctx.cal.rangeADCSigma(i, 0)));
+        if (adc < 0) ctx.count(kCounterClampedADCLow);
+        s.adcInitial = std::max(adc, 0);
+    }
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() { return 1u << kStageADCHigh; }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerSamplingStages; }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.adcInitial) aux.adcInitial[i] = s.adcInitial;
+    }
+};
+
+// 按高增益ADC值选择增益档位
+struct GainSelectionStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const int adc = s.adcInitial;
+        const int adcSwitch = ctx.par.ADCSwitch;
+        if (adc <= adcSwitch) {
+            s.gainMode = 1;
+        } else if (static_cast<int>(adc / ctx.par.GainRatio_12) <= adcSwitch) {
+            s.gainMode = 2;
+        } else {
+            s.gainMode = 3;
+        }
+        ctx.count(static_cast<RunCounter>(kCounterGainRange1 + static_cast<int>(s.gainMode) - 1));
+    }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.gainMode) aux.gainMode[i] = s.gainMode;
+    }
+};
+
+// 低增益档的满量程：ADC位数（ADC 单级）或档位切换阈值（Total）
+enum class ADCFullScale { kBits, kSwitch };
+
+// 中、低增益档位重新抽取ADC值并截断
+template <ADCFullScale kFullScale>
+struct RangeADCStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const size_t i = ctx.i;
+        const int g = static_cast<int>(s.gainMode) - 1;
+        s.adcSigma = ctx.cal.rangeADCSigma(i, g);
+        if (g == 0) {
+            s.adc = s.adcInitial;
+            return;
+        }
+        
+        s.adcMean = s.signal * ctx.cal.rangeGain(i, g) + ctx.cal.pedestal(i);
+        int adc = std::round(ctx.gaus(kStageADCRange, s.adcMean, s.adcSigma));
+        const int adcMax = kFullScale == ADCFullScale::kBits ? ctx.par.adcMax
+                                                              : static_cast<int>(ctx.par.ADCSwitch);
+        if (adc < 0) {
+            ctx.count(kCounterClampedADCLow);
+            adc = 0;
+        }
+        if (g == 2 && adc > adcMax) {
+            ctx.count(kCounterClampedADCHigh);
+            adc = adcMax;
+        }
+        s.adc = adc;
+    }
+    
+    template <class Intermediates>
+    static void store(const Intermediates& aux, const EventState& s, size_t i) {
+        if (aux.adc) aux.adc[i] = s.adc;
+    }
+    
+    template <class Modes>
+    static constexpr unsigned normalStages() { return 1u << kStageADCRange; }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() { return kTimerSamplingStages; }
+};
+
+// ADC 单级的输出：扣除基线后按所选档位的增益换算回能量
+struct ADCEnergyStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const size_t i = ctx.i;
+        const int g = static_cast<int>(s.gainMode) - 1;
+        s.output = (s.adc - ctx.cal.pedestal(i)) / ctx.cal.rangeGain(i, g) * ctx.cal.invPENorm(i);
+    }
+};
+
+// 启用饱和修正时，由ADC值反推光电子数并按饱和响应的逆函数修正
+struct SaturationCorrectionStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const size_t i = ctx.i;
+        double adcValue = s.adc;
+        if (Context::Modes::sipmResponse == SiPMResponseMode::kCorrected && s.signal >= 100) {
+            const double pedestal = ctx.cal.pedestal(i);
+            const double gain = ctx.cal.rangeGain(i, static_cast<int>(s.gainMode) - 1);
+            double signalSiPM_ADCRec = (adcValue - pedestal) / ctx.cal.gainMean(i);
+            double signalSiPM_ADCRec_mean = ctx.params.invertSiPMResponse(signalSiPM_ADCRec);
+            adcValue = static_cast<int>(signalSiPM_ADCRec_mean * gain + pedestal);
+        }
+        s.adcCorr = std::max(adcValue, 0.0);
+    }
+    
+    template <class Modes>
+    static constexpr RunTimer timer() {
+        return Modes::sipmResponse == SiPMResponseMode::kCorrected ? kTimerResponseStages : kTimerOtherStages;
+    }
+};
+
+// 完整链的输出：扣除所选档位含暗噪声的基线，换算回能量并做零压缩
+struct ReconstructionStage : StageBase {
+    template <class Context>
+    static void apply(Context& ctx, EventState& s) {
+        const size_t i = ctx.i;
+        const int g = static_cast<int>(s.gainMode) - 1;
+        s.gain = ctx.cal.rangeGain(i, g);
+        s.noiseFEE = ctx.cal.rangeFEENoise(i, g);
+        s.noiseASIC = ctx.cal.asicNoise(i);
+        s.pedMean = ctx.cal.rangePedestalMean(i, g);
+        
+        double energy = (s.adcCorr - s.pedMean) / s.gain * ctx.cal.invPENorm(i);
+        if (energy < ctx.par.EcalMIP_Thre * ctx.par.EcalMIPEnergy) {
+            ctx.count(kCounterZeroSuppressed);
+            energy = 0;
+        }
+        s.output = energy;
+    }
+};
+
+// ===== 预定义的链 =====
+
+using ScintillationChain = StageChain<
+    LightYieldStage, ScintillationStage, AttenuationStage, LightYieldSmearStage, PhotonEnergyStage>;
+
+using SiPMChain = StageChain<
+    ExpectedPhotoelectronStage, SaturationStage, DarkNoiseStage,
+    GainFluctuationStage<true>, PedestalSubtractionStage<false>, SiPMEnergyStage>;
+
+using ADCChain = StageChain<
+    ExpectedPhotoelectronStage, HighGainADCStage, GainSelectionStage,
+    RangeADCStage<ADCFullScale::kBits>, ADCEnergyStage>;
+
+using TotalChain = StageChain<
+    LightYieldStage, ScintillationStage, AttenuationStage, LightYieldSmearStage,
+    PhotonDetectionStage, SaturationStage, DarkNoiseStage,
+    GainFluctuationStage<false>, PedestalSubtractionStage<true>, TimeWindowStage,
+    HighGainADCStage, GainSelectionStage, RangeADCStage<ADCFullScale::kSwitch>,
+    SaturationCorrectionStage, ReconstructionStage>;
+
+// 用 Chain 数字化 n 个事件：每个事件整条链跑完再处理下一个；
+// kRecord 时把每个事件的完整状态保存到 states（填充事件树用），否则只保留输出，
+// 未使用的中间量由编译器消去；aux 非空时写出请求的中间量。
+// 启用计时时每 kStageProfileStride 个事件中有一个逐级计时，其余事件走融合的循环体
+template <class Chain, bool kRecord, class Context, class Intermediates>
+void runStageChain(Context& ctx, const double* energies, double* outputs, size_t n,
+                   const Intermediates* aux, EventState* states) {
+    for (size_t i = 0; i < n; ++i) {
+        EventState s;
+        s.energy = energies[i];
+        ctx.i = i;
+        if (kInstrumentation && i % kStageProfileStride == 0) {
+            Chain::applyProfiled(ctx, s);
+        } else {
+            Chain::apply(ctx, s);
+        }
+        outputs[i] = s.output;
+        if (aux) Chain::store(*aux, s, i);
+        if (kRecord) states[i] = s;
+    }
+}
+
+#endif // DIGITIZATION_STAGES_H
@@ -0,0 +1,141 @@
+#ifndef HIT_READER_H
+#define HIT_READER_H
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TBranch.h>
+#include <TLeaf.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TBufferFile;
+
+// 外部击中输入（Geant4 输出的晶体击中树）的设置
+struct HitInputOptions {
+    std::string fileName;
+    std::string treeName = "hits";
+    
+    // 事件号、通道号和沉积能量的分支名；事件号分支为空时以条目序号作为事件号
+    std::string eventBranch = "event";
+    std::string channelBranch = "channel";
+    std::string edepBranch = "edep";
+    
+    // 击中时间的分支名（ns），为空时不读取时间
+    std::string timeBranch;
+    
+    // 沉积能量换算到 MeV 的系数
+    double energyScale = 1.0;
+    
+    // 所有分支都是基本类型的标量叶时整篮读取并解码（试验性，默认逐条目读取）
+    bool bulkRead = false;
+    
+    bool enabled() const { return !fileName.empty(); }
+    
+    // 解析分支列表 "event,channel,edep[,time]"
+    bool parseBranches(const std::string& spec);
+};
+
+// 一批击中（结构数组）
+struct HitBatch {
+    std::vector<Long64_t> event;
+    std::vector<Int_t> channel;
+    std::vector<double> edep;       // MeV
+    std::vector<double> time;       // ns，未读取时间时为空
+    
+    size_t size() const { return edep.size(); }
+    void clear() {
+        event.clear();
+        channel.clear();
+        edep.clear();
+        time.clear();
+    }
+};
+
+// 按簇读取击中树：每次读入若干个完整的簇，簇内的篮子由 TTreeCache 一次读取，
+// 只解压输入分支。分支可以是每个条目一个击中的标量，也可以是每个条目一个事件的
+// std::vector<double/float/int/Long64_t>。设置 bulkRead 且所有分支都是基本类型的标量时
+// 整篮读取并解码，不再逐条目调用 GetEntry 和 TLeaf::GetValue
+class HitReader {
+public:
+    explicit HitReader(const HitInputOptions& options);
+    ~HitReader();
+    
+    bool open();
+    void close();
+    
+    Long64_t entries() const { return nEntries; }
+    Long64_t entriesRead() const { return nextEntry; }
+    bool hasTime() const { return hasTimeColumn; }
+    
+    // 从当前位置读入完整的簇，直到至少有 minHits 个击中或读完；没有更多条目时返回 false
+    bool next(HitBatch& batch, size_t minHits);
+
+private:
+    // 单个输入列：标量叶或 std::vector 分支
+    struct Column {
+        std::string name;
+        TBranch* branch = nullptr;
+        TLeaf* leaf = nullptr;
+        std::vector<double>* vecDouble = nullptr;
+        std::vector<float>* vecFloat = nullptr;
+        std::vector<int>* vecInt = nullptr;
+        std::vector<Long64_t>* vecLong64 = nullptr;
+        
+        // 整篮读取：叶的类型（kBulkTypes 中的下标，-1 表示不支持），当前篮子的条目范围
+        // [basketFirst, basketEnd) 和解码后的值（浮点类型存入 values，整数类型存入 integers）
+        int bulkType = -1;
+        std::unique_ptr<TBufferFile> buffer;
+        Long64_t basketFirst = 0;
+        Long64_t basketEnd = 0;
+        std::vector<double> values;
+        std::vector<Long64_t> integers;
+        
+        bool bind(TTree* tree, const std::string& branchName);
+        void release();
+        size_t length() const;
+        double value(size_t i) const;
+        Long64_t integer(size_t i) const;
+        
+        bool bulk() const { return bulkType >= 0; }
+        bool integral() const;
+        
+        // 读入并解码从 entry 开始的篮子（entry 须为篮子的第一个条目），失败时返回 false
+        bool readBasket(Long64_t entry);
+        double bulkValue(Long64_t entry) const {
+            return integral() ? integers[entry - basketFirst] : values[entry - basketFirst];
+        }
+        Long64_t bulkInteger(Long64_t entry) const {
+            return integral() ? integers[entry - basketFirst]
+                              : static_cast<Long64_t>(values[entry - basketFirst]);
+        }
+    };
+    
+    // 读取条目 [first, end)：整篮读取，返回第一个未读的条目（失败时早于 end）
+    Long64_t readBulk(HitBatch& batch, Long64_t first, Long64_t end);
+    // 逐条目读取
+    void readEntries(HitBatch& batch, Long64_t first, Long64_t end);
+    
+    HitInputOptions options;
+    std::unique_ptr<TFile> file;
+    TTree* tree = nullptr;
+    Column eventColumn;
+    Column channelColumn;
+    Column edepColumn;
+    Column timeColumn;
+    bool hasEventColumn = false;
+    bool hasTimeColumn = false;
+    bool bulkMode = false;
+    
+    Long64_t nEntries = 0;
+    Long64_t nextEntry = 0;
+    
+    // 各簇的起始条目，最后一个元素为条目总数
+    std::vector<Long64_t> clusterStarts;
+    size_t nextCluster = 0;
+    
+    // 读入缓存大小
+    static constexpr Long64_t kCacheSize = 64LL * 1024 * 1024;
+};
+
+#endif // HIT_READER_H
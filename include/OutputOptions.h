@@ -0,0 +1,70 @@
+#ifndef OUTPUT_OPTIONS_H
+#define OUTPUT_OPTIONS_H
+
+#include <string>
+#include <vector>
+
+// 事件级输出选项：控制 dataTree / samplingTree 的写入方式
+struct OutputOptions {
+    // 输出级别
+    enum Level {
+        kSummary = 0,      // 只保存每个能量点的统计量
+        kHistograms,       // 保存能量直方图，不创建事件树
+        kFullTree,         // 保存全部事件（默认）
+        kPrescaled,        // 每 prescale 个事件保存 1 个
+        kFiltered          // 只保存满足筛选条件的事件
+    };
+    
+    Level level = kFullTree;
+    
+    // 预缩放因子，按事件序号选取，与线程数无关
+    int prescale = 1;
+    
+    // 筛选条件：增益档位切换（离开高增益档）
+    bool filterGainTransition = true;
+    
+    // 筛选条件：相对偏差偏离同一能量点（均匀抽样时为同一输入能量区间）的均值超过
+    // filterSigma 倍标准差，0 表示不使用
+    double filterSigma = 3.0;
+    
+    // 事件树写入输出文件时的自动刷新大小（字节），内存占用与事件数无关
+    long long autoFlushBytes = 32LL * 1024 * 1024;
+    
+    // 分支按各自的精简类型存储（整数计数、单精度能量），默认 false 时全部存为 double，
+    // 与按 Double_t 绑定分支的已有读取程序兼容；文件中的 branchTypes 记录所用类型
+    bool compactBranches = false;
+    
+    // 只写出列出的分支，为空时写出全部分支
+    std::vector<std::string> branchSelection;
+    
+    // 输出文件压缩设置（算法*100+级别），-1 表示使用ROOT默认值
+    int compressionSettings = -1;
+    std::string compressionName = "default";
+    
+    // 是否创建事件树
+    bool writesTrees() const { return level >= kFullTree; }
+    
+    // 是否写出能量直方图
+    bool writesHistograms() const { return level != kSummary; }
+    
+    // 级别名称与解析
+    static const char* levelName(Level level);
+    static bool parseLevel(const std::string& name, Level& level);
+    
+    // 解析筛选条件列表，例如 "gain,sigma"
+    bool parseFilter(const std::string& spec);
+    
+    // 解析压缩设置，例如 "lz4"、"zstd:5"、"none"
+    bool parseCompression(const std::string& spec);
+    
+    // 解析分支列表，例如 "inputEnergy,outputEnergy"
+    void parseBranchSelection(const std::string& spec);
+    
+    // 分支是否被选中写出
+    bool isBranchSelected(const std::string& name) const;
+    
+    // 打印当前设置
+    std::string describe() const;
+};
+
+#endif // OUTPUT_OPTIONS_H
@@ -0,0 +1,90 @@
+#ifndef PARAMETER_SNAPSHOT_H
+#define PARAMETER_SNAPSHOT_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// 参数快照：运行开始时从 DetectorParameters 生成的只读参数集合
+// 数字化热路径直接读取字段，避免逐事件的字符串查找
+struct ParameterSnapshot {
+    // 晶体参数
+    double EcalMIPEnergy = 0.0;
+    double EcalCryMipLY = 0.0;
+    double EcalCryEffLY = 0.0;
+    double EcalCryIntLY = 0.0;
+    double EcalCryIntLYFlu = 0.0;
+    double EcalCryLOFlu = 0.0;
+    double EcalCryLYUn = 0.0;
+    double EcalCryAtt = 0.0;
+    
+    // SiPM参数
+    double EcalSiPMDigiVerbose = 0.0;
+    double EcalSiPMPDE = 0.0;
+    double EcalSiPMPDEFlu = 0.0;
+    double EcalSiPMDCR = 0.0;
+    double EcalSiPMCT = 0.0;
+    double EcalSiPMCTMode = 0.0;
+    double EcalSiPMNeuFluence = 0.0;
+    double EcalSiPMGainMean = 0.0;
+    double EcalSiPMGainSigma = 0.0;
+    double EcalSiPMGainMeanFlu = 0.0;
+    double EcalSiPMInvTolerance = 0.0;
+    
+    // 触发参数
+    double EcalTriggerThreshold = 0.0;
+    double EcalTimeInterval = 0.0;
+    double EcalRatioTimeInterval = 0.0;
+    
+    // 电子学参数
+    double EcalFEENoiseSigma = 0.0;
+    double EcalASICNoiseSigma = 0.0;
+    double EcalADCError = 0.0;
+    double EcalMIP_Thre = 0.0;
+    double ADCbit = 0.0;
+    double ADCSwitch = 0.0;
+    double NofGain = 0.0;
+    double Pedestal = 0.0;
+    double SiPMDigiVerbose = 0.0;
+    double TotalGain = 0.0;
+    double GainRatio_12 = 0.0;
+    double GainRatio_23 = 0.0;
+    
+    // ===== 派生量（由 computeDerived 计算） =====
+    
+    // 闪烁光子数 -> 能量的换算因子 1/(LY*Att)
+    double invPhotonNorm = 0.0;
+    // 光电子数 -> 能量的换算因子 1/(LY*Att*PDE)
+    double invPENorm = 0.0;
+    // 门宽内的平均暗计数
+    double meanDarkCount = 0.0;
+    // 含串扰的暗噪声基线（光电子数）
+    double darkPedestal = 0.0;
+    // 暗计数串扰 Borel 分布使用的串扰概率，CT >= 1 时截断为 kMaxCrosstalk
+    double borelCrosstalk = 0.0;
+    // SiPM增益的绝对涨落 GainMean*GainSigma
+    double gainSigmaAbs = 0.0;
+    // ADC满量程 2^ADCbit-1
+    int adcMax = 0;
+    // 三个增益档位的增益、FEE噪声、总噪声和含暗噪声的基线
+    double rangeGain[3] = {0.0, 0.0, 0.0};
+    double rangeFEENoise[3] = {0.0, 0.0, 0.0};
+    double rangeADCSigma[3] = {0.0, 0.0, 0.0};
+    double rangePedestalMean[3] = {0.0, 0.0, 0.0};
+    
+    // 由基本参数计算派生量
+    void computeDerived();
+    
+    // Borel 分布在 CT >= 1 时不收敛，抽样器和解析、卷积模型统一截断到该值
+    static constexpr double kMaxCrosstalk = 0.99;
+    static double clampCrosstalk(double ct) { return ct >= 1.0 ? kMaxCrosstalk : ct; }
+    
+    // 已知参数名与快照字段的对应表
+    using Field = double ParameterSnapshot::*;
+    static const std::vector<std::pair<std::string, Field>>& fields();
+    
+    // 检查参数名是否为已知参数
+    static bool isKnownParameter(const std::string& name);
+};
+
+#endif // PARAMETER_SNAPSHOT_H
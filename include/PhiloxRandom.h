@@ -0,0 +1,74 @@
+#ifndef PHILOX_RANDOM_H
+#define PHILOX_RANDOM_H
+
+#include <TRandom.h>
+#include <cstddef>
+#include <string>
+
+// 基于计数器的随机数生成器（Philox4x32-10）
+// 密钥为（种子, 数字化器），计数器为（块序号, 事件序号, 能量点, 抽样阶段），
+// 任一事件任一阶段的随机数流都可以直接定位，与线程数和任务划分无关。
+// 继承 TRandom，Poisson/Binomial 等抽样方法沿用 TRandom 的实现，Gaus 改用 ziggurat。
+class PhiloxRandom final : public TRandom {
+public:
+    explicit PhiloxRandom(UInt_t seed = 0, UInt_t streamId = 0);
+    
+    // 设置种子，数字化器标识保持不变，流位置回到起点
+    void SetSeed(ULong_t seed = 0) override;
+    UInt_t GetSeed() const override { return key[0]; }
+    
+    // 设置数字化器标识（密钥的第二个字）
+    void setStreamId(UInt_t streamId);
+    
+    // 由名称导出数字化器标识
+    static UInt_t streamIdFromName(const std::string& name);
+    
+    // 定位到（事件, 能量点, 阶段）对应的随机数流的起点
+    void setStream(UInt_t event, UInt_t energySlot, UInt_t stage);
+    
+    // 在当前流内跳到第 position 个随机数
+    void skipTo(ULong64_t position);
+    
+    // (0,1) 开区间均匀分布
+    Double_t Rndm() override { return toUniform(nextWord()); }
+    
+    // 批量生成：整块调用 Philox，不经过逐个缓冲
+    void RndmArray(Int_t n, Double_t* array) override;
+    void RndmArray(Int_t n, Float_t* array) override;
+    
+    // 在当前流上抽取标准正态数（128 层 ziggurat）；Gaus 由它换算
+    Double_t normal();
+    Double_t Gaus(Double_t mean = 0, Double_t sigma = 1) override { return mean + sigma * normal(); }
+    
+    // 批量标准正态数：out[i] 与定位到流（firstEvent+i, energySlot, stage）后调用 normal() 的结果相同。
+    // 各事件流的首个 Philox 块按 8 路并行生成（CPU 支持 AVX2 时用向量指令，否则逐路计算），
+    // 绝大多数事件直接落在 ziggurat 的矩形内，其余事件回到逐个抽样；调用后需重新 setStream
+    void fillNormals(UInt_t firstEvent, UInt_t energySlot, UInt_t stage, size_t n, Double_t* out);
+    
+    // 单次 Philox4x32-10 变换，供验证使用
+    static void philox(const UInt_t ctr[4], const UInt_t key[2], UInt_t out[4]);
+    
+private:
+    // 生成当前计数器的一个块（4 个 32 位整数）并推进块序号
+    void nextBlock(UInt_t out[4]);
+    
+    // 当前流的下一个 32 位整数
+    UInt_t nextWord() {
+        if (bufferPos == 4) {
+            nextBlock(buffer);
+            bufferPos = 0;
+        }
+        return buffer[bufferPos++];
+    }
+    
+    static Double_t toUniform(UInt_t x) { return (x + 0.5) * 2.3283064365386963e-10; }
+    
+    UInt_t key[2];
+    UInt_t counter[4] = {0, 0, 0, 0};   // counter[0] 为块序号
+    
+    // 当前块的缓冲
+    UInt_t buffer[4] = {0, 0, 0, 0};
+    int bufferPos = 4;
+};
+
+#endif // PHILOX_RANDOM_H
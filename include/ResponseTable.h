@@ -0,0 +1,103 @@
+#ifndef RESPONSE_TABLE_H
+#define RESPONSE_TABLE_H
+
+#include "DetectorParameters.h"
+#include <string>
+#include <vector>
+
+class DigitizationBase;
+
+// 快速模拟用的响应查找表：对数能量网格上 Total 链输出能量的分位数表
+// 每个能量点保存零压缩置零的比例、非零输出中各增益档位的比例和各档位内的条件分位数
+// （除以输入能量）。抽样时只需一个均匀随机数：先判断是否置零、属于哪个档位，再在分位水平上
+// 线性插值、在对数能量上对最近的三个能量点做二次插值，最后把结果放回该档位的ADC计数格点上
+class ResponseTable {
+public:
+    ResponseTable() = default;
+    
+    // 由 digitizer（Total）在 [eMin, eMax] 上 nEnergies 个对数等间距能量点各直接数字化
+    // nSamples 个事件生成表，输出的ADC取整和截断都包含在分位数中；档位比例在增益档位
+    // 切换处随能量突变，切换能量两侧按 kTransitionOffsets 另加能量点
+    bool build(DigitizationBase& digitizer, const DetectorParameters& params, double eMin,
+               double eMax, int nEnergies, int nSamples = 500000, int nQuantiles = 512);
+    
+    // 保存为ROOT文件（responseTable 树和参数树），或从文件读取
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+    
+    bool empty() const { return energies.empty(); }
+    int energyCount() const { return static_cast<int>(energies.size()); }
+    int quantileCount() const { return static_cast<int>(levels.size()); }
+    double minEnergy() const { return energies.empty() ? 0.0 : energies.front(); }
+    double maxEnergy() const { return energies.empty() ? 0.0 : energies.back(); }
+    
+    // 增益档位切换处的沉积能量（网格范围内，build 时求出）
+    const std::vector<double>& transitionEnergies() const { return transitions; }
+    
+    // 由 (0,1) 均匀随机数 u 抽样沉积能量 energy 的输出能量
+    // 网格外的能量按最近端点的相对分布缩放
+    double sample(double energy, double u) const;
+    
+    // 沉积能量 energy 的输出被零压缩置零的概率
+    double zeroFraction(double energy) const;
+    
+    // 直接 digitize 输出与查表抽样的比较
+    struct Comparison {
+        double energy = 0.0;
+        double mean[2] = {};           // [0] 直接数字化，[1] 查表
+        double rms[2] = {};
+        double zeroFraction[2] = {};
+        double q01[2] = {};
+        double q50[2] = {};
+        double q99[2] = {};
+        double ks = 0.0;               // 两样本 Kolmogorov-Smirnov 距离
+    };
+    
+    // 比较两组样本（会被排序）
+    static Comparison compare(double energy, std::vector<double>& direct, std::vector<double>& table);
+    
+    static void printComparison(const std::vector<Comparison>& results);
+
+private:
+    // 分位水平 u_j = (1 - cos(pi j / (n-1))) / 2，两端加密
+    void makeLevels(int nQuantiles);
+    
+    // 能量所在的网格区间 k 和区间内的插值权重 w
+    void locate(double energy, int& k, double& w) const;
+    
+    // 把插值得到的输出能量放到档位 range 的ADC格点上，dither ∈ [0,1) 为随机舍入用的均匀数；
+    // range 为 -1 时（没有档位比例的旧表）按输出能量所在区间取档位
+    double snapToLattice(double value, int range, double dither) const;
+    
+    // 第 k 个能量点档位 range 在条件分位水平 v 处的相对分位数
+    double relativeQuantile(int k, int range, double v) const;
+    
+    // 第 k 个能量点非零输出属于档位 range 的比例
+    double rangeFraction(int k, int range) const { return rangeFrac[static_cast<size_t>(k) * nRanges + range]; }
+    
+    // 切换能量两侧另加能量点的相对偏移
+    static constexpr double kTransitionOffsets[] = {0.0025, 0.005, 0.0075, 0.01, 0.015, 0.02, 0.03, 0.045, 0.07};
+    
+    // 平均输出能量等于 output 时的沉积能量（在 [eMin, eMax] 上对数二分），不在范围内时返回 0
+    static double inputEnergyForOutput(DigitizationBase& digitizer, double output, double eMin, double eMax);
+    
+    std::vector<double> energies;
+    std::vector<double> logEnergies;
+    std::vector<double> transitions;
+    std::vector<double> levels;
+    int nRanges = 1;                 // 每个能量点的档位行数：3，旧表为 1
+    std::vector<float> zeroFrac;     // 每个能量点的零压缩比例
+    std::vector<float> rangeFrac;    // [能量点][档位]，非零输出中该档位的比例
+    std::vector<float> quantiles;    // 行主序 [能量点][档位][分位水平]，分位数 / 输入能量
+    
+    // 输出能量格点：档位 g 的输出与 Total 链相同地由整数ADC值 k 计算，
+    // 即 (k - latticePedestal[g]) / latticeGain[g] * latticeNorm；高增益档的输出不超过
+    // latticeEdge[0]，没有档位比例的旧表按 latticeEdge 区分档位。latticeNorm 为 0 时不取格点（旧的表文件）
+    double latticeGain[3] = {};
+    double latticePedestal[3] = {};
+    double latticeNorm = 0.0;
+    double latticeEdge[2] = {};
+    double zeroThreshold = 0.0;
+};
+
+#endif // RESPONSE_TABLE_H
@@ -0,0 +1,137 @@
+#ifndef RUN_INSTRUMENTATION_H
+#define RUN_INSTRUMENTATION_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+class TDirectory;
+
+// 热路径计时器和计数器，用于按探测器配置判断应优化的数字化阶段。
+// 编译开关 DIGITIZATION_INSTRUMENTATION（CMake 选项同名，默认开启）为 0 时
+// 计数和计时都编译为空操作，运行报告只保留事件数、耗时和峰值内存
+#ifndef DIGITIZATION_INSTRUMENTATION
+#define DIGITIZATION_INSTRUMENTATION 1
+#endif
+
+constexpr bool kInstrumentation = DIGITIZATION_INSTRUMENTATION != 0;
+
+// 计时器：前两项和事件树、直方图的填充按批计时；各级的时间每 kStageProfileStride
+// 个事件抽样计时一次，运行结束时按抽样的比例分摊 digitize 中除正态数以外的时间
+enum RunTimer : unsigned {
+    kTimerDigitize = 0,     // digitizeBatch 的总时间
+    kTimerNormals,          // 整批预先生成正态数
+    kTimerSamplingStages,   // 抽取随机数的级（光子、光电子、暗计数、增益涨落、ADC噪声）
+    kTimerResponseStages,   // 计算 SiPM 饱和响应及其逆函数的级
+    kTimerOtherStages,      // 其余算术级
+    kTimerTreeFill,         // 填充事件树
+    kTimerHistogramFill,    // 填充直方图和流式统计量
+    kTimerCount
+};
+
+// 计数器
+enum RunCounter : unsigned {
+    kCounterGainRange1 = 0,          // 选中高增益档的事件
+    kCounterGainRange2,              // 选中中增益档的事件
+    kCounterGainRange3,              // 选中低增益档的事件
+    kCounterDarkCounts,              // 初级暗计数
+    kCounterCrosstalkCounts,         // 串扰产生的计数
+    kCounterCrosstalkIterations,     // 串扰抽样的循环次数（逐计数模式每个暗计数一次）
+    kCounterClampedPhotoelectrons,   // 饱和响应抽样为负、截断为 0
+    kCounterClampedCharge,           // 增益涨落后电荷为负、截断为 0
+    kCounterClampedSignal,           // 扣除基线后信号为负、截断为 0
+    kCounterClampedADCLow,           // ADC 值低于 0
+    kCounterClampedADCHigh,          // 低增益档 ADC 值超出满量程
+    kCounterZeroSuppressed,          // 重建能量低于阈值、置为 0
+    kCounterCount
+};
+
+// 每隔多少个事件对各级逐一计时一次
+constexpr size_t kStageProfileStride = 64;
+
+// 一个数字化器实例（或工作实例）累积的计时和计数，并行运行结束后合并
+struct RunInstrumentation {
+    std::array<double, kTimerCount> seconds{};
+    std::array<uint64_t, kCounterCount> counts{};
+    
+    void count(RunCounter c, uint64_t k = 1) {
+        if constexpr (kInstrumentation) counts[c] += k;
+    }
+    
+    void addTime(RunTimer t, std::chrono::steady_clock::duration elapsed) {
+        if constexpr (kInstrumentation) seconds[t] += std::chrono::duration<double>(elapsed).count();
+    }
+    
+    // 单个抽样事件上某一级的时间：扣除读时钟本身的开销后按抽样间隔外推
+    void addStageSample(RunTimer t, std::chrono::steady_clock::duration elapsed) {
+        if constexpr (kInstrumentation) {
+            const double dt = std::chrono::duration<double>(elapsed).count() - clockOverhead();
+            if (dt > 0) seconds[t] += dt * kStageProfileStride;
+        }
+    }
+    
+    void merge(const RunInstrumentation& other);
+    void reset() { *this = RunInstrumentation(); }
+    
+    // 抽样计时含读时钟和缓存失效的额外开销，只用其比例：把各级时间缩放到
+    // 按批测得的链时间（digitize 减去 normals）
+    void apportionStageTimes();
+    
+    static const char* timerName(RunTimer t);
+    static const char* counterName(RunCounter c);
+    
+    // 连续两次读取 steady_clock 的最小间隔（秒），首次调用时测定
+    static double clockOverhead();
+};
+
+// 作用域计时：析构时把经过的时间计入 timer
+class ScopedRunTimer {
+public:
+    ScopedRunTimer(RunInstrumentation& stats, RunTimer timer) : stats(stats), timer(timer) {
+        if constexpr (kInstrumentation) start = std::chrono::steady_clock::now();
+    }
+    ~ScopedRunTimer() {
+        if constexpr (kInstrumentation) stats.addTime(timer, std::chrono::steady_clock::now() - start);
+    }
+    
+    ScopedRunTimer(const ScopedRunTimer&) = delete;
+    ScopedRunTimer& operator=(const ScopedRunTimer&) = delete;
+
+private:
+    RunInstrumentation& stats;
+    RunTimer timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+// 一次运行（run、runHits 或 runHitFile）的报告
+struct RunReport {
+    std::string digitizer;
+    std::string mode;           // run / hits / hitFile
+    int threads = 1;
+    uint64_t events = 0;
+    double wallSeconds = 0.0;
+    double peakRSSMB = 0.0;
+    double inputSeconds = 0.0;      // 击中模式：读取输入的时间
+    double digitizeSeconds = 0.0;   // 击中模式：数字化的墙钟时间（含并行）
+    RunInstrumentation stats;   // 各线程之和
+    
+    double eventsPerSecond() const { return wallSeconds > 0 ? events / wallSeconds : 0.0; }
+    double inputRate() const { return inputSeconds > 0 ? events / inputSeconds : 0.0; }
+    double digitizeRate() const { return digitizeSeconds > 0 ? events / digitizeSeconds : 0.0; }
+    
+    // 打印耗时分布和计数器
+    void print(std::ostream& os) const;
+    
+    // 写入目录 dir：TNamed instrumentation 和 (name, value) 树 runReport
+    void write(TDirectory* dir) const;
+    
+    // 写出 JSON 文件，失败时返回 false
+    bool writeJSON(const std::string& filename) const;
+    
+    // 进程的峰值常驻内存 (MB)
+    static double peakRSS();
+};
+
+#endif // RUN_INSTRUMENTATION_H
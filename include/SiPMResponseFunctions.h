@@ -0,0 +1,73 @@
+#ifndef SIPM_RESPONSE_FUNCTIONS_H
+#define SIPM_RESPONSE_FUNCTIONS_H
+
+#include <TF1.h>
+#include <cmath>
+#include <memory>
+
+// SiPM响应曲线（饱和模型），参数化与原 TF1 公式相同：
+// f(x) = ((1-p1)*p0*(1-exp(-x/p0)) + p1*x) * (p2+1) / (p2 + x/(p0*(1-exp(-x/p0)))) * (1+p3*exp(-x/p0))
+// 其中 p0 为有效像素数，p3 为串扰概率
+struct SiPMResponseCurve {
+    double par[4] = {1.47821e+05, 2.81116e-01, 1.55157e+01, 0.0};
+    
+    static double evaluate(double x, const double* p) {
+        double decay = std::exp(-x / p[0]);
+        double fired = p[0] * (1 - decay);
+        return ((1 - p[1]) * fired + p[1] * x) * (p[2] + 1) / (p[2] + x / fired) * (1 + p[3] * decay);
+    }
+    
+    double operator()(double x) const { return evaluate(x, par); }
+    
+    // 导出 TF1 用于绘图，不加入 ROOT 全局函数列表
+    std::unique_ptr<TF1> makeTF1(const char* name, double xmin = 0, double xmax = 1e+9) const {
+        auto f = std::make_unique<TF1>(name, [](double* x, double* p) { return evaluate(x[0], p); }, 
+                                       xmin, xmax, 4, 1, TF1::EAddToList::kNo);
+        f->SetParameters(par);
+        return f;
+    }
+};
+
+// SiPM探测器分辨率曲线 sigma(x) = p0*sqrt(x+p1)
+struct SiPMSigmaDetCurve {
+    double par[2] = {8.90971e-01, 5.47081e-01};
+    
+    static double evaluate(double x, const double* p) {
+        return p[0] * std::sqrt(x + p[1]);
+    }
+    
+    double operator()(double x) const { return evaluate(x, par); }
+    
+    std::unique_ptr<TF1> makeTF1(const char* name, double xmin = 0, double xmax = 1e+9) const {
+        auto f = std::make_unique<TF1>(name, [](double* x, double* p) { return evaluate(x[0], p); }, 
+                                       xmin, xmax, 2, 1, TF1::EAddToList::kNo);
+        f->SetParameters(par[0], par[1]);
+        return f;
+    }
+};
+
+// 非对称高斯函数，参数为均值、左侧宽度和右侧宽度
+struct AsymGaussCurve {
+    static double evaluate(double x, const double* p) {
+        double sigma = x < p[0] ? p[1] : p[2];
+        double t = (x - p[0]) / sigma;
+        return std::exp(-0.5 * t * t);
+    }
+    
+    std::unique_ptr<TF1> makeTF1(const char* name, double xmin = -10, double xmax = 10) const {
+        return std::make_unique<TF1>(name, [](double* x, double* p) { return evaluate(x[0], p); }, 
+                                     xmin, xmax, 3, 1, TF1::EAddToList::kNo);
+    }
+};
+
+// SiPM响应模型：响应曲线及其分辨率带，数字化热路径直接调用
+struct SiPMResponseModel {
+    SiPMResponseCurve response;
+    SiPMSigmaDetCurve sigmaDet;
+    
+    // 响应曲线加减一倍分辨率
+    double sigmaUpper(double x) const { return response(x) + sigmaDet(x); }
+    double sigmaLower(double x) const { return response(x) - sigmaDet(x); }
+};
+
+#endif // SIPM_RESPONSE_FUNCTIONS_H
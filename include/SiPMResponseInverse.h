@@ -0,0 +1,43 @@
+#ifndef SIPM_RESPONSE_INVERSE_H
+#define SIPM_RESPONSE_INVERSE_H
+
+#include <functional>
+#include <vector>
+
+// SiPM响应曲线的单调逆查找表
+// 在对数网格上自适应加密，使分段线性逆函数的相对误差不超过给定容差；
+// 逐事件求逆只需一次二分查找和一次线性插值
+class SiPMResponseInverse {
+public:
+    SiPMResponseInverse() = default;
+    
+    // 在 [xMin, xMax] 上为单调递增的响应函数建表，遇到不再递增的点时截止
+    void build(const std::function<double(double)>& response, 
+               double xMin, double xMax, double tolerance);
+    
+    // 求逆：返回响应值为 y 的输入 x
+    double invert(double y) const;
+    
+    bool empty() const { return xs.empty(); }
+    size_t size() const { return xs.size(); }
+    double getTolerance() const { return tolerance; }
+    
+private:
+    // 对区间 [x0, x1] 递归加密，直到中点的插值误差满足容差
+    void refine(const std::function<double(double)>& response,
+                double x0, double y0, double x1, double y1, int depth);
+    
+    std::vector<double> xs;
+    std::vector<double> ys;
+    
+    // 表首以下按过原点的直线外推
+    double lowSlope = 1.0;
+    double tolerance = 0.0;
+    
+    // 初始网格每十倍频程的点数和最大加密深度
+    static constexpr int kPointsPerDecade = 20;
+    static constexpr int kMaxDepth = 24;
+    static constexpr double kMinTolerance = 1e-9;
+};
+
+#endif // SIPM_RESPONSE_INVERSE_H
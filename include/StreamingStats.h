@@ -0,0 +1,119 @@
+#ifndef STREAMING_STATS_H
+#define STREAMING_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 单遍统计量（Welford 算法），可按 Chan 公式合并
+class RunningMoments {
+public:
+    void add(double x);
+    void merge(const RunningMoments& other);
+    void clear() { *this = RunningMoments(); }
+
+    int64_t count() const { return n; }
+    double mean() const { return mu; }
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0.0; }
+    double rms() const;
+    double minimum() const { return xMin; }
+    double maximum() const { return xMax; }
+
+private:
+    int64_t n = 0;
+    double mu = 0.0;
+    double m2 = 0.0;
+    double xMin = 0.0;
+    double xMax = 0.0;
+};
+
+// 可合并的分位数草图（相对误差对数分桶，DDSketch）
+// 桶 k 覆盖 (gamma^(k-1), gamma^k]，任一分位数的相对误差不超过 alpha；
+// 零和负值单独计数。桶计数为整数，合并与顺序无关
+class QuantileSketch {
+public:
+    explicit QuantileSketch(double relativeAccuracy = 1e-4);
+
+    void add(double x);
+    void merge(const QuantileSketch& other);
+    void clear();
+
+    int64_t count() const { return total; }
+
+    // 分位数 q ∈ [0, 1]
+    double quantile(double q) const;
+
+    // 包含比例 fraction 的事件的最短区间的半宽（fraction=0.6827 时为 sigma_eff）
+    double shortestHalfWidth(double fraction) const;
+
+    // 半高全宽：在 [Q(0.005), Q(0.995)] 上重新分 nBins 个箱后求峰的半高宽度
+    double fwhm(int nBins = 100) const;
+
+    // 截断RMS：只用 [Q(lower), Q(upper)] 之间的事件计算
+    double truncatedRMS(double lower = 0.05, double upper = 0.95) const;
+
+private:
+    // 按升序排列的桶（区间、代表值、计数），负值、零和正值依次排列
+    struct Bin { double lower; double upper; double value; int64_t count; };
+    std::vector<Bin> sortedBins() const;
+
+    int keyOf(double x) const;
+    double valueOf(int key) const;
+
+    // 稠密桶存储，counts[i] 对应键 offset + i；超出 kMaxBuckets 时合并最低的桶
+    struct Store {
+        std::vector<int64_t> counts;
+        int offset = 0;
+
+        void add(int key, int64_t count);
+        void merge(const Store& other);
+    };
+
+    double alpha;
+    double gamma;
+    double logGamma;
+
+    Store positive;
+    Store negative;          // 存储 -x 的键
+    int64_t zeroCount = 0;
+    int64_t total = 0;
+
+    static constexpr int kMaxBuckets = 65536;
+};
+
+// 单个能量点的输出统计：矩、分位数草图和直方图范围外的比例
+struct EnergyPointStats {
+    RunningMoments moments;
+    QuantileSketch sketch;
+
+    // 对应能量直方图的范围，用于统计被截掉的尾部
+    double rangeMin = 0.0;
+    double rangeMax = 0.0;
+    int64_t underflow = 0;
+    int64_t overflow = 0;
+
+    void fill(const double* values, size_t n);
+    void merge(const EnergyPointStats& other);
+    void clear();
+};
+
+// 由统计量导出的能量点响应汇总
+struct ResponseSummary {
+    double energy = 0.0;
+    int64_t entries = 0;
+    double mean = 0.0;
+    double meanError = 0.0;
+    double rms = 0.0;
+    double sigmaEff = 0.0;        // 包含 68.27% 事件的最短区间半宽
+    double fwhm = 0.0;
+    double truncatedRMS = 0.0;    // 中间 90% 事件的RMS
+    double underflowFraction = 0.0;
+    double overflowFraction = 0.0;
+    double resolution = 0.0;      // rms / mean
+    double resolutionError = 0.0;
+    double linearity = 0.0;       // (mean - E) / E
+
+    static ResponseSummary compute(double energy, const EnergyPointStats& stats);
+};
+
+#endif // STREAMING_STATS_H
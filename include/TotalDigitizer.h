@@ -13,9 +13,17 @@ public:
     // 数字化方法
     double digitize(double energy) override;
     
+    // 批量数字化方法
+    void digitizeBatch(const double* energies, double* outputs, size_t n,
+                       const BatchIntermediates* aux = nullptr) override;
+    
     // 重载运行方法，添加等效噪声能量(ENE)计算
     virtual void run(int nEvents = 100000) override;
     
+    // 数值卷积运行：不抽样，由输出能量分布直接得到每个能量点的直方图和响应汇总
+    // nEvents 为直方图的名义事件数
+    void runConvolution(int nEvents = 100000);
+    
     // 重载保存方法，添加ENE直方图保存
     virtual void saveResults(const std::string& outputFile) override;
     
@@ -23,12 +31,20 @@ public:
     void plotResults(const std::string& outputPrefix);
     
 protected:
+    // 创建并行运行的工作实例
+    std::unique_ptr<DigitizationBase> createWorker() const override;
+    
     // 覆盖树初始化方法
     void initializeTree() override;
     
     // 添加：覆盖均匀抽样树初始化方法
     void initializeSamplingTree() override;
     
+    // 将批量结果装入树分支变量
+    void loadBatchEvent(size_t i) override;
+    
+    bool hasADCStage() const override { return true; }
+    
 private:
     // 用于存储Tree数据的变量
     double inputEnergy;
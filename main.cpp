@@ -2,6 +2,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
 
 void printUsage() {
     std::cout << "Usage: digitize [options]" << std::endl;
@@ -9,6 +10,8 @@ void printUsage() {
     std::cout << "  -h, --help                     显示帮助信息" << std::endl;
     std::cout << "  -n, --events <number>          设置模拟事件数 (默认: 100000)" << std::endl;
     std::cout << "  -s, --seed <number>            设置随机数种子 (默认: 0)" << std::endl;
+    std::cout << "  -j, --threads <number>         设置并行线程数 (默认: 1)" << std::endl;
+    std::cout << "  --target-precision <p>         自适应事件数：达到目标精度即停止，-n 为每个能量点的上限" << std::endl;
     std::cout << "  -d, --digitizer <type>         运行指定的数字化器 (Scintillation/SiPM/ADC/Total)" << std::endl;
     std::cout << "  -a, --all                      运行所有数字化器" << std::endl;
     std::cout << "  -o, --output <prefix>          设置输出文件前缀" << std::endl;
@@ -16,12 +19,36 @@ void printUsage() {
     std::cout << "  -l, --load <file>              从文件加载参数" << std::endl;
     std::cout << "  -w, --save <file>              保存参数到文件" << std::endl;
     std::cout << "  --scan <name> <v1> <v2> ...    扫描参数值" << std::endl;
+    std::cout << "  --analytic                     用解析矩传播代替蒙特卡罗计算分辨率（需放在 --scan 之前）" << std::endl;
+    std::cout << "  --convolution                  用数值卷积计算 Total 链的输出能量分布，代替蒙特卡罗" << std::endl;
+    std::cout << "  --response-table               生成快速模拟用的响应查找表，并在能量点上与直接数字化比较" << std::endl;
+    std::cout << "  --table-grid <min> <max> <n>   查找表的对数能量网格 (默认: 1 10000 81，单位 MeV)" << std::endl;
+    std::cout << "  --hits <file>                  数字化外部击中树中的 (event, channel, edep)，配合 -d 选择数字化器 (默认: Total)" << std::endl;
+    std::cout << "  --hit-tree <name>              击中树名 (默认: hits)" << std::endl;
+    std::cout << "  --hit-branches <ev,ch,edep[,t]> 事件号、通道号、沉积能量和可选时间的分支名 (默认: event,channel,edep)" << std::endl;
+    std::cout << "  --hit-energy-scale <k>         沉积能量换算到 MeV 的系数 (默认: 1)" << std::endl;
+    std::cout << "  --hit-bulk-read                标量击中分支整篮读取（试验性，默认逐条目读取）" << std::endl;
+    std::cout << "  --channel-calib <file>         逐通道刻度表（增益、基线、光产额、DCR 等），用于 --hits 和 --hit-file" << std::endl;
+    std::cout << "  --hit-file <file.bin>          数字化二进制击中文件（内存映射），输出 <prefix>_<type>_hits.bin" << std::endl;
+    std::cout << "  --convert-hits <file.bin>      把 --hits 指定的击中树转换为二进制击中文件" << std::endl;
+    std::cout << "  --convert-digi <in.bin> <out.root>  把二进制数字化结果转换为 digiHits 树" << std::endl;
     std::cout << "  --print-params                 打印所有参数" << std::endl;
     std::cout << "  -e, --energy-points <file>     从文件加载能量点" << std::endl;
     std::cout << "  -c, --config <file>            从配置文件加载所有参数" << std::endl;
     std::cout << "  --energy <e1> <e2> ...         设置模拟能量点 (MeV)" << std::endl;
     std::cout << "  --uniform-sampling             启用均匀能量抽样" << std::endl;
     std::cout << "  --sampling-range <min> <max>   设置均匀抽样的能量范围 (MeV)" << std::endl;
+    std::cout << "  --output-level <level>         事件级输出级别 summary/histograms/full/prescaled/filtered (默认: full)" << std::endl;
+    std::cout << "  --prescale <N>                 事件树每 N 个事件保存 1 个" << std::endl;
+    std::cout << "  --filter <gain,sigma>          事件树只保存增益档位切换或偏离超过 k 倍标准差的事件" << std::endl;
+    std::cout << "  --filter-sigma <k>             设置 sigma 筛选的倍数 (默认: 3)" << std::endl;
+    std::cout << "  --autoflush <MB>               事件树自动写盘的基块大小 (默认: 32)" << std::endl;
+    std::cout << "  --branch-types <compact|double> 事件树分支类型 (默认: double)" << std::endl;
+    std::cout << "  --branches <b1,b2,...>         只写出指定的事件树分支" << std::endl;
+    std::cout << "  --compression <algo[:level]>   输出压缩算法 none/zlib/lzma/lz4/zstd" << std::endl;
+    std::cout << "  --check-crosstalk [n]          检验串扰抽样器与原逐计数循环的一致性 (默认: 1000000 次)" << std::endl;
+    std::cout << "  --check-samplers [n]           检验泊松和二项抽样器与精确分布的一致性 (默认: 每组 1000000 次)" << std::endl;
+    std::cout << "  --report-json                  另外写出 JSON 运行报告 <输出文件名>_report.json" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -30,11 +57,27 @@ int main(int argc, char* argv[]) {
     std::string digitizerType;
     std::string outputPrefix = "digi_out";
     bool runAll = false;
+    bool analytic = false;
+    bool convolution = false;
+    bool responseTable = false;
+    double tableMinEnergy = 1.0;
+    double tableMaxEnergy = 10000.0;
+    int tableEnergies = 81;
+    bool scanned = false;
     
     bool uniformSampling = false;
     double samplingMinEnergy = 0.0;
     double samplingMaxEnergy = 0.0;
     
+    HitInputOptions hitInput;
+    std::string hitFile;
+    std::string convertHitsOutput;
+    std::string convertDigiInput;
+    std::string convertDigiOutput;
+    
+    OutputOptions outputOptions;
+    bool outputOptionsSet = false;
+    
     // 解析命令行参数
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -53,6 +96,16 @@ int main(int argc, char* argv[]) {
                 manager.setRandomSeed(std::stoi(argv[++i]));
             }
         }
+        else if (arg == "-j" || arg == "--threads") {
+            if (i + 1 < argc) {
+                manager.setNumberOfThreads(std::stoi(argv[++i]));
+            }
+        }
+        else if (arg == "--target-precision") {
+            if (i + 1 < argc) {
+                manager.setTargetPrecision(std::stod(argv[++i]));
+            }
+        }
         else if (arg == "-d" || arg == "--digitizer") {
             if (i + 1 < argc) {
                 digitizerType = argv[++i];
@@ -93,10 +146,17 @@ int main(int argc, char* argv[]) {
                 }
                 
                 if (!values.empty()) {
-                    manager.scanParameter(paramName, values);
+                    manager.scanParameter(paramName, values, "param_scan", analytic);
+                    scanned = true;
                 }
             }
         }
+        else if (arg == "--analytic") {
+            analytic = true;
+        }
+        else if (arg == "--convolution") {
+            convolution = true;
+        }
         else if (arg == "--print-params") {
             manager.printParameters();
         }
@@ -127,12 +187,138 @@ int main(int argc, char* argv[]) {
         else if (arg == "--uniform-sampling") {
             uniformSampling = true;
         }
+        else if (arg == "--output-level") {
+            if (i + 1 < argc) {
+                outputOptionsSet |= OutputOptions::parseLevel(argv[++i], outputOptions.level);
+            }
+        }
+        else if (arg == "--prescale") {
+            if (i + 1 < argc) {
+                outputOptions.prescale = std::max(std::stoi(argv[++i]), 1);
+                outputOptions.level = OutputOptions::kPrescaled;
+                outputOptionsSet = true;
+            }
+        }
+        else if (arg == "--filter") {
+            if (i + 1 < argc && outputOptions.parseFilter(argv[++i])) {
+                outputOptions.level = OutputOptions::kFiltered;
+                outputOptionsSet = true;
+            }
+        }
+        else if (arg == "--filter-sigma") {
+            if (i + 1 < argc) {
+                outputOptions.filterSigma = std::stod(argv[++i]);
+                outputOptionsSet = true;
+            }
+        }
+        else if (arg == "--autoflush") {
+            if (i + 1 < argc) {
+                outputOptions.autoFlushBytes = static_cast<long long>(std::stod(argv[++i]) * 1024 * 1024);
+                outputOptions.autoFlushBytes = std::max(outputOptions.autoFlushBytes, 1024LL);
+                outputOptionsSet = true;
+            }
+        }
+        else if (arg == "--branch-types") {
+            if (i + 1 < argc) {
+                std::string types = argv[++i];
+                if (types == "compact" || types == "double") {
+                    outputOptions.compactBranches = (types == "compact");
+                    outputOptionsSet = true;
+                } else {
+                    std::cerr << "警告: 未知的分支类型 '" << types << "'，可选值为 compact/double" << std::endl;
+                }
+            }
+        }
+        else if (arg == "--branches") {
+            if (i + 1 < argc) {
+                outputOptions.parseBranchSelection(argv[++i]);
+                outputOptionsSet = true;
+            }
+        }
+        else if (arg == "--compression") {
+            if (i + 1 < argc) {
+                outputOptionsSet |= outputOptions.parseCompression(argv[++i]);
+            }
+        }
+        else if (arg == "--report-json") {
+            manager.setRunReportJSON(true);
+        }
+        else if (arg == "--check-crosstalk") {
+            int nTrials = 1000000;
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                nTrials = std::stoi(argv[++i]);
+            }
+            manager.checkCrosstalkSampler(nTrials);
+        }
+        else if (arg == "--check-samplers") {
+            int nDraws = 1000000;
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                nDraws = std::stoi(argv[++i]);
+            }
+            manager.checkCountingSamplers(nDraws);
+        }
         else if (arg == "--sampling-range") {
             if (i + 2 < argc) {
                 samplingMinEnergy = std::stod(argv[++i]);
                 samplingMaxEnergy = std::stod(argv[++i]);
             }
         }
+        else if (arg == "--hits") {
+            if (i + 1 < argc) {
+                hitInput.fileName = argv[++i];
+            }
+        }
+        else if (arg == "--hit-tree") {
+            if (i + 1 < argc) {
+                hitInput.treeName = argv[++i];
+            }
+        }
+        else if (arg == "--hit-branches") {
+            if (i + 1 < argc) {
+                hitInput.parseBranches(argv[++i]);
+            }
+        }
+        else if (arg == "--hit-energy-scale") {
+            if (i + 1 < argc) {
+                hitInput.energyScale = std::stod(argv[++i]);
+            }
+        }
+        else if (arg == "--hit-bulk-read") {
+            hitInput.bulkRead = true;
+        }
+        else if (arg == "--hit-file") {
+            if (i + 1 < argc) {
+                hitFile = argv[++i];
+            }
+        }
+        else if (arg == "--convert-hits") {
+            if (i + 1 < argc) {
+                convertHitsOutput = argv[++i];
+            }
+        }
+        else if (arg == "--convert-digi") {
+            if (i + 2 < argc) {
+                convertDigiInput = argv[++i];
+                convertDigiOutput = argv[++i];
+            }
+        }
+        else if (arg == "--channel-calib") {
+            if (i + 1 < argc) {
+                if (!manager.loadChannelCalibration(argv[++i])) {
+                    return 1;
+                }
+            }
+        }
+        else if (arg == "--response-table") {
+            responseTable = true;
+        }
+        else if (arg == "--table-grid") {
+            if (i + 3 < argc) {
+                tableMinEnergy = std::stod(argv[++i]);
+                tableMaxEnergy = std::stod(argv[++i]);
+                tableEnergies = std::stoi(argv[++i]);
+            }
+        }
     }
     
     // 设置均匀抽样选项
@@ -143,8 +329,37 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    // 设置事件级输出选项
+    if (outputOptionsSet) {
+        manager.setOutputOptions(outputOptions);
+    }
+    
     // 执行指定操作
-    if (runAll) {
+    if (analytic) {
+        // 解析模式不运行蒙特卡罗；已做过解析扫描时不再重复
+        if (!scanned) {
+            manager.runAnalytic(outputPrefix);
+        }
+    }
+    else if (convolution) {
+        manager.runConvolution(outputPrefix);
+    }
+    else if (!convertDigiInput.empty()) {
+        return manager.convertDigiToRoot(convertDigiInput, convertDigiOutput) ? 0 : 1;
+    }
+    else if (hitInput.enabled() && !convertHitsOutput.empty()) {
+        return manager.convertHitsToBinary(hitInput, convertHitsOutput) ? 0 : 1;
+    }
+    else if (!hitFile.empty()) {
+        manager.runHitFile(hitFile, digitizerType.empty() ? "Total" : digitizerType, outputPrefix);
+    }
+    else if (hitInput.enabled()) {
+        manager.runHits(hitInput, digitizerType.empty() ? "Total" : digitizerType, outputPrefix);
+    }
+    else if (responseTable) {
+        return manager.buildResponseTable(outputPrefix, tableMinEnergy, tableMaxEnergy, tableEnergies) ? 0 : 1;
+    }
+    else if (runAll) {
         manager.runAllDigitizers(outputPrefix);
     }
     else if (!digitizerType.empty()) {
@@ -0,0 +1,281 @@
+#include "AnalyticModel.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+double normalPdf(double x) {
+    return std::exp(-0.5 * x * x) / std::sqrt(2.0 * M_PI);
+}
+
+double normalCdf(double x) {
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+// 正态变量在上限 c 处截顶后的均值和方差（高增益档位以外的 ADC 饱和）
+void clampAbove(double& mean, double& variance, double c) {
+    const double sigma = std::sqrt(std::max(variance, 0.0));
+    if (sigma <= 0) {
+        mean = std::min(mean, c);
+        return;
+    }
+    
+    const double b = (c - mean) / sigma;
+    const double below = normalCdf(b);
+    const double density = normalPdf(b);
+    const double m1 = mean * below - sigma * density + c * (1 - below);
+    const double m2 = (mean * mean + variance) * below - sigma * (mean + c) * density + c * c * (1 - below);
+    mean = m1;
+    variance = std::max(m2 - m1 * m1, 0.0);
+}
+
+} // namespace
+
+const char* AnalyticModel::stageName(int stage) {
+    static const char* names[kNumStages] = {
+        "scintillation", "attenuation", "lyNonUniformity", "sipm",
+        "darkNoise", "gainFluctuation", "electronics"
+    };
+    return (stage >= 0 && stage < kNumStages) ? names[stage] : "unknown";
+}
+
+AnalyticModel::AnalyticModel(const DetectorParameters& params)
+    : params(params), par(params.createSnapshot()) {
+}
+
+double AnalyticModel::Moments::variance() const {
+    double sum = 0.0;
+    for (double v : var) sum += v;
+    return sum;
+}
+
+void AnalyticModel::Moments::scale(double a) {
+    mean *= a;
+    for (double& v : var) v *= a * a;
+}
+
+AnalyticModel::Truncated AnalyticModel::truncatedNormal(double mean, double sigma, double lo, double hi) {
+    Truncated t;
+    if (sigma <= 0) {
+        t.probability = (mean > lo && mean <= hi) ? 1.0 : 0.0;
+        t.mean = mean;
+        return t;
+    }
+    
+    // 无穷端点处密度和 x*密度 均取 0
+    const double a = (lo - mean) / sigma;
+    const double b = (hi - mean) / sigma;
+    const double cdfA = std::isinf(lo) ? 0.0 : normalCdf(a);
+    const double cdfB = std::isinf(hi) ? 1.0 : normalCdf(b);
+    const double pdfA = std::isinf(lo) ? 0.0 : normalPdf(a);
+    const double pdfB = std::isinf(hi) ? 0.0 : normalPdf(b);
+    const double apdfA = std::isinf(lo) ? 0.0 : a * pdfA;
+    const double bpdfB = std::isinf(hi) ? 0.0 : b * pdfB;
+    
+    t.probability = cdfB - cdfA;
+    if (t.probability < 1e-12) {
+        t.probability = 0.0;
+        return t;
+    }
+    
+    const double shift = (pdfA - pdfB) / t.probability;
+    t.mean = mean + sigma * shift;
+    t.variance = std::max(sigma * sigma * (1 + (apdfA - bpdfB) / t.probability - shift * shift), 0.0);
+    return t;
+}
+
+double AnalyticModel::invert(double y) const {
+    return params.invertSiPMResponse(y);
+}
+
+double AnalyticModel::invertSlope(double y) const {
+    const double h = std::max(1e-3 * std::abs(y), 1e-2);
+    return (invert(y + h) - invert(y - h)) / (2 * h);
+}
+
+AnalyticModel::Result AnalyticModel::evaluate(double energy) const {
+    Result result;
+    result.energy = energy;
+    
+    const SiPMResponseModel& model = params.getSiPMResponseModel();
+    Moments m;
+    
+    // 闪烁光子产额：Poisson，或 LOFlu 给出的高斯相对涨落
+    const double nScin = energy * par.EcalCryIntLY;
+    m.mean = nScin;
+    m.var[kScintillation] = par.EcalCryLOFlu == 0.0 ? nScin : std::pow(nScin * par.EcalCryLOFlu, 2);
+    
+    // 光衰减：二项抽样
+    const double att = par.EcalCryAtt;
+    m.scale(att);
+    m.var[kAttenuation] += nScin * att * (1 - att);
+    
+    // 光产额不均匀：Var(A*f) = Var(A)*(1+u^2) + <A>^2*u^2
+    const double u = par.EcalCryLYUn;
+    m.scale(std::sqrt(1 + u * u));
+    m.var[kLYNonUniformity] += m.mean * m.mean * u * u;
+    
+    // PDE 在逐事件链中为确定性缩放
+    m.scale(par.EcalSiPMPDE);
+    
+    // SiPM：线性区为 Poisson 光电子乘以 (1+CT)，饱和区在均值处线性化响应曲线
+    const double ct = par.EcalSiPMCT;
+    if (par.EcalSiPMDigiVerbose == 0 || m.mean < 100) {
+        m.var[kSiPM] += m.mean;
+        m.scale(1 + ct);
+    } else {
+        const double x = m.mean;
+        const double h = std::max(1e-3 * x, 1e-2);
+        const double y0 = model.response(x);
+        const double yUp = model.response(x + h);
+        const double yDown = model.response(x - h);
+        const double slope = (yUp - yDown) / (2 * h);
+        const double curvature = (yUp - 2 * y0 + yDown) / (h * h);
+        const double inputVariance = m.variance();
+        
+        m.scale(slope);
+        m.mean = y0 + 0.5 * curvature * inputVariance;
+        m.var[kSiPM] += std::pow(model.sigmaDet(y0), 2);
+    }
+    
+    // 暗计数：Poisson 个初级计数，各自的总计数服从 Borel 分布
+    // 均值 1/(1-CT)，方差 CT/(1-CT)^3，复合后方差为 lambda/(1-CT)^3；CT 与抽样器相同地截断
+    const double borelMean = 1.0 / (1 - par.borelCrosstalk);
+    m.mean += par.meanDarkCount * borelMean;
+    m.var[kDarkNoise] += par.meanDarkCount * std::pow(borelMean, 3);
+    
+    // 增益涨落：电荷宽度 sqrt(S)*gainSigmaAbs，换算回光电子数
+    const double relGainSigma = par.gainSigmaAbs / par.EcalSiPMGainMean;
+    m.var[kGainFluctuation] += std::max(m.mean, 0.0) * relGainSigma * relGainSigma;
+    
+    // 扣除暗噪声基线并乘以门宽比例
+    m.mean -= par.darkPedestal;
+    m.scale(par.EcalRatioTimeInterval);
+    
+    // ===== ADC 与增益档位切换 =====
+    // 高增益 ADC 值 A = X*G + ped + noise 的分布决定各档位的概率；
+    // 在每个档位内按 (X, A) 的二元正态条件分布求 X 的均值和方差
+    const double meanX = m.mean;
+    const double varX = m.variance();
+    const double gainMean = par.EcalSiPMGainMean;
+    const double pedestal = par.Pedestal;
+    const double invNorm = par.invPENorm;
+    const double meanA = meanX * gainMean + pedestal;
+    const double sigmaA = std::sqrt(varX * gainMean * gainMean + par.rangeADCSigma[0] * par.rangeADCSigma[0]);
+    const double regression = sigmaA > 0 ? varX * gainMean / (sigmaA * sigmaA) : 0.0;
+    const double residualX = std::max(varX - regression * regression * sigmaA * sigmaA, 0.0);
+    
+    // 档位边界：adc <= ADCSwitch 为高增益，int(adc/GainRatio_12) <= ADCSwitch 为中增益
+    const double adcSwitch = par.ADCSwitch;
+    const double inf = std::numeric_limits<double>::infinity();
+    const double edges[4] = {-inf, adcSwitch + 0.5,
+                             std::ceil((adcSwitch + 1) * par.GainRatio_12) - 0.5, inf};
+    const bool invertResponse = par.EcalSiPMDigiVerbose >= 2 && meanX >= 100;
+    
+    double sumP = 0.0, sumY = 0.0, sumY2 = 0.0, sumTransfer2 = 0.0;
+    for (int g = 0; g < 3; ++g) {
+        Truncated a = truncatedNormal(meanA, sigmaA, edges[g], edges[g + 1]);
+        if (a.probability <= 0) continue;
+        result.gainFraction[g] = a.probability;
+        
+        double adcMean = a.mean;
+        double adcVariance = a.variance;
+        if (g > 0) {
+            // 中、低增益档位用该档位的增益和噪声重新数字化
+            double xMean = meanX + regression * (a.mean - meanA);
+            double xVariance = regression * regression * a.variance + residualX;
+            adcMean = xMean * par.rangeGain[g] + pedestal;
+            adcVariance = xVariance * par.rangeGain[g] * par.rangeGain[g] +
+                          par.rangeADCSigma[g] * par.rangeADCSigma[g];
+            if (g == 2) clampAbove(adcMean, adcVariance, adcSwitch);
+        }
+        
+        // 转换回能量；transfer 为重建能量对 X 的导数，用于换算上游各级方差
+        double y = 0.0, yVariance = 0.0, transfer = invNorm;
+        if (invertResponse) {
+            double z = (adcMean - pedestal) / gainMean;
+            double slope = invertSlope(z);
+            y = (invert(z) - par.darkPedestal) * invNorm;
+            yVariance = slope * slope * adcVariance / (gainMean * gainMean) * invNorm * invNorm;
+            transfer = slope * par.rangeGain[g] / gainMean * invNorm;
+        } else {
+            y = (adcMean - par.rangePedestalMean[g]) / par.rangeGain[g] * invNorm;
+            yVariance = adcVariance / (par.rangeGain[g] * par.rangeGain[g]) * invNorm * invNorm;
+        }
+        
+        sumP += a.probability;
+        sumY += a.probability * y;
+        sumY2 += a.probability * (yVariance + y * y);
+        sumTransfer2 += a.probability * transfer * transfer;
+    }
+    if (sumP <= 0) return result;
+    
+    double mean = sumY / sumP;
+    double second = sumY2 / sumP;
+    
+    // 零压缩：低于阈值的能量置零（阈值为 0 时截掉负值），按正态近似
+    const double threshold = par.EcalMIP_Thre * par.EcalMIPEnergy;
+    const double sigmaY = std::sqrt(std::max(second - mean * mean, 0.0));
+    const double above = sigmaY > 0 ? 1 - normalCdf((threshold - mean) / sigmaY) : (mean < threshold ? 0.0 : 1.0);
+    if (above < 1e-12) {
+        mean = 0.0;
+        second = 0.0;
+    } else if (sigmaY > 0) {
+        double z = (threshold - mean) / sigmaY;
+        double density = normalPdf(z);
+        second = (mean * mean + sigmaY * sigmaY) * above + sigmaY * (mean + threshold) * density;
+        mean = mean * above + sigmaY * density;
+    }
+    const double variance = std::max(second - mean * mean, 0.0);
+    
+    // 上游各级方差按平均传递系数换算到能量，其余归入电子学
+    double upstream = 0.0;
+    for (int s = 0; s < kElectronics; ++s) {
+        result.stageVariance[s] = m.var[s] * sumTransfer2 / sumP;
+        upstream += result.stageVariance[s];
+    }
+    result.stageVariance[kElectronics] = variance - upstream;
+    
+    result.mean = mean;
+    result.sigma = std::sqrt(variance);
+    if (mean > 0) result.resolution = result.sigma / mean;
+    if (energy > 0) result.linearity = (mean - energy) / energy;
+    return result;
+}
+
+std::vector<AnalyticModel::Result> AnalyticModel::evaluate(const std::vector<double>& energies) const {
+    std::vector<Result> results;
+    results.reserve(energies.size());
+    for (double e : energies) {
+        results.push_back(evaluate(e));
+    }
+    return results;
+}
+
+void AnalyticModel::printTable(const std::vector<Result>& results) {
+    std::cout << std::setw(10) << std::left << "E [MeV]"
+              << std::setw(12) << "Mean"
+              << std::setw(12) << "Sigma"
+              << std::setw(12) << "Sigma/Mean";
+    for (int s = 0; s < kNumStages; ++s) {
+        std::cout << std::setw(17) << stageName(s);
+    }
+    std::cout << "Gain 1/2/3" << std::endl;
+    
+    // 各级方差以占总方差的百分比列出
+    for (const auto& r : results) {
+        const double total = r.sigma * r.sigma;
+        std::cout << std::setw(10) << std::left << r.energy
+                  << std::setw(12) << r.mean
+                  << std::setw(12) << r.sigma
+                  << std::setw(12) << r.resolution;
+        for (int s = 0; s < kNumStages; ++s) {
+            double percent = total > 0 ? 100.0 * r.stageVariance[s] / total : 0.0;
+            std::cout << std::setw(17) << percent;
+        }
+        std::cout << r.gainFraction[0] << "/" << r.gainFraction[1] << "/" << r.gainFraction[2] << std::endl;
+    }
+}
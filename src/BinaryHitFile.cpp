@@ -0,0 +1,160 @@
+#include "BinaryHitFile.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// 文件头标识
+const char kHitMagic[8] = {'E', 'C', 'A', 'L', 'H', 'I', 'T', 'S'};
+const char kDigiMagic[8] = {'E', 'C', 'A', 'L', 'D', 'I', 'G', 'I'};
+
+} // namespace
+
+BinaryHitFile::~BinaryHitFile() {
+    close();
+}
+
+size_t BinaryHitFile::recordSize(Kind kind, bool withTime) {
+    if (kind == kDigis) return sizeof(DigiRecord);
+    return withTime ? sizeof(TimedHitRecord) : sizeof(HitRecord);
+}
+
+BinaryHitHeader BinaryHitFile::makeHeader(Kind kind, uint64_t nRecords, uint32_t flags) {
+    BinaryHitHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kind == kDigis ? kDigiMagic : kHitMagic, sizeof(h.magic));
+    h.version = BinaryHitHeader::kVersion;
+    h.recordSize = static_cast<uint32_t>(recordSize(kind, flags & BinaryHitHeader::kHasTime));
+    h.flags = flags;
+    h.nRecords = nRecords;
+    return h;
+}
+
+bool BinaryHitFile::open(const std::string& filename) {
+    close();
+    name = filename;
+    fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        std::cerr << "错误：无法打开二进制击中文件 " << filename << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length < sizeof(BinaryHitHeader)) {
+        std::cerr << "错误：" << filename << " 不是二进制击中文件（长度不足文件头）" << std::endl;
+        close();
+        return false;
+    }
+    
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "错误：无法映射 " << filename << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    base = static_cast<unsigned char*>(mapped);
+    records = base + sizeof(BinaryHitHeader);
+    writable = false;
+    
+    // 检查文件头
+    const BinaryHitHeader& h = header();
+    if (std::memcmp(h.magic, kHitMagic, sizeof(h.magic)) == 0) {
+        fileKind = kHits;
+    } else if (std::memcmp(h.magic, kDigiMagic, sizeof(h.magic)) == 0) {
+        fileKind = kDigis;
+    } else {
+        std::cerr << "错误：" << filename << " 的文件头标识无效" << std::endl;
+        close();
+        return false;
+    }
+    const bool withTime = h.flags & BinaryHitHeader::kHasTime;
+    if (h.version != BinaryHitHeader::kVersion || h.recordSize != recordSize(fileKind, withTime)) {
+        std::cerr << "错误：" << filename << " 的格式版本 " << h.version << " 或记录长度 "
+                  << h.recordSize << " 不受支持" << std::endl;
+        close();
+        return false;
+    }
+    stride = h.recordSize;
+    if (h.nRecords > (length - sizeof(BinaryHitHeader)) / stride) {
+        std::cerr << "错误：" << filename << " 被截断（文件头记录 " << h.nRecords << " 条）" << std::endl;
+        close();
+        return false;
+    }
+    
+    // 顺序读取：内核提前预读
+    madvise(base, length, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool BinaryHitFile::create(const std::string& filename, Kind kind, uint64_t nRecords, uint32_t flags) {
+    close();
+    name = filename;
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "错误：无法创建输出文件 " << filename << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    stride = recordSize(kind, flags & BinaryHitHeader::kHasTime);
+    length = sizeof(BinaryHitHeader) + nRecords * stride;
+    if (ftruncate(fd, static_cast<off_t>(length)) != 0) {
+        std::cerr << "错误：无法为 " << filename << " 分配 " << length << " 字节: "
+                  << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    
+    void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "错误：无法映射 " << filename << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    base = static_cast<unsigned char*>(mapped);
+    records = base + sizeof(BinaryHitHeader);
+    writable = true;
+    fileKind = kind;
+    
+    const BinaryHitHeader h = makeHeader(kind, nRecords, flags);
+    std::memcpy(base, &h, sizeof(h));
+    madvise(base, length, MADV_SEQUENTIAL);
+    return true;
+}
+
+void BinaryHitFile::release(uint64_t first, uint64_t last) {
+    if (!base) return;
+    
+    // 只回收完整落在范围内的页面，末尾不完整的页面留到下次回收
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = (sizeof(BinaryHitHeader) + first * stride) / pageSize * pageSize;
+    const size_t end = (sizeof(BinaryHitHeader) + last * stride) / pageSize * pageSize;
+    if (end <= begin) return;
+    if (writable) {
+        msync(base + begin, end - begin, MS_ASYNC);
+    }
+    madvise(base + begin, end - begin, MADV_DONTNEED);
+}
+
+void BinaryHitFile::close() {
+    if (base) {
+        if (writable && msync(base, length, MS_SYNC) != 0) {
+            std::cerr << "警告：同步 " << name << " 失败: " << std::strerror(errno) << std::endl;
+        }
+        munmap(base, length);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    base = nullptr;
+    records = nullptr;
+    length = 0;
+    stride = 0;
+    writable = false;
+}
@@ -0,0 +1,183 @@
+#include "ChannelCalibration.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+const std::vector<std::string>& ChannelCalibration::fieldNames() {
+    static const std::vector<std::string> names = {
+        "EcalCryIntLY", "EcalCryAtt", "EcalSiPMPDE", "EcalSiPMDCR",
+        "EcalSiPMGainMean", "EcalSiPMGainSigma", "Pedestal",
+        "EcalFEENoiseSigma", "EcalASICNoiseSigma"
+    };
+    return names;
+}
+
+bool ChannelCalibration::load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "无法打开刻度文件: " << filename << std::endl;
+        return false;
+    }
+    
+    channelIds.clear();
+    fileFields.clear();
+    fileValues.clear();
+    
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        // 跳过空行和注释
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        
+        std::istringstream iss(line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (iss >> token) tokens.push_back(token);
+        
+        // 首行为列名
+        if (fileFields.empty()) {
+            if (tokens.size() < 2 || tokens[0] != "channel") {
+                std::cerr << "错误：刻度文件首行应为 \"channel <参数名> ...\": " << filename << std::endl;
+                return false;
+            }
+            for (size_t c = 1; c < tokens.size(); ++c) {
+                const auto& known = fieldNames();
+                if (std::find(known.begin(), known.end(), tokens[c]) == known.end()) {
+                    std::cerr << "错误：参数 " << tokens[c] << " 不能按通道设置" << std::endl;
+                    return false;
+                }
+                fileFields.push_back(tokens[c]);
+            }
+            fileValues.assign(fileFields.size(), {});
+            continue;
+        }
+        
+        if (tokens.size() != fileFields.size() + 1) {
+            std::cerr << "警告：刻度文件第 " << lineNumber << " 行的列数不正确，已跳过" << std::endl;
+            continue;
+        }
+        Int_t channel = 0;
+        std::vector<double> values(fileFields.size());
+        try {
+            channel = static_cast<Int_t>(std::stol(tokens[0]));
+            for (size_t c = 0; c < fileFields.size(); ++c) {
+                values[c] = tokens[c + 1] == "-" ? std::numeric_limits<double>::quiet_NaN()
+                                                 : std::stod(tokens[c + 1]);
+            }
+        } catch (const std::exception&) {
+            std::cerr << "警告：刻度文件第 " << lineNumber << " 行无法解析，已跳过" << std::endl;
+            continue;
+        }
+        channelIds.push_back(channel);
+        for (size_t c = 0; c < fileFields.size(); ++c) {
+            fileValues[c].push_back(values[c]);
+        }
+    }
+    
+    if (channelIds.empty()) {
+        std::cerr << "错误：刻度文件中没有通道: " << filename << std::endl;
+        return false;
+    }
+    
+    // 通道号 -> 行号
+    sortedRows.clear();
+    denseRows.clear();
+    for (size_t r = 0; r < channelIds.size(); ++r) {
+        sortedRows.emplace_back(channelIds[r], static_cast<int>(r + 1));
+    }
+    std::sort(sortedRows.begin(), sortedRows.end());
+    for (size_t r = 1; r < sortedRows.size(); ++r) {
+        if (sortedRows[r].first == sortedRows[r - 1].first) {
+            std::cerr << "警告：通道 " << sortedRows[r].first << " 重复，使用最后一行" << std::endl;
+        }
+    }
+    minChannel = sortedRows.front().first;
+    const long long span = static_cast<long long>(sortedRows.back().first) - minChannel + 1;
+    if (span <= 16 * static_cast<long long>(sortedRows.size()) + 65536) {
+        denseRows.assign(span, 0);
+        for (const auto& entry : sortedRows) {
+            denseRows[entry.first - minChannel] = std::max(denseRows[entry.first - minChannel], entry.second);
+        }
+        sortedRows.clear();
+    }
+    
+    std::cout << "已读取刻度文件 " << filename << ": " << channelIds.size() << " 个通道, "
+              << fileFields.size() << " 个参数" << std::endl;
+    return true;
+}
+
+void ChannelCalibration::build(const ParameterSnapshot& defaults) {
+    // 参数名 -> 快照字段
+    std::vector<ParameterSnapshot::Field> members;
+    for (const auto& name : fileFields) {
+        for (const auto& field : ParameterSnapshot::fields()) {
+            if (field.first == name) members.push_back(field.second);
+        }
+    }
+    
+    const size_t nRows = channelIds.size() + 1;
+    for (auto* column : {&cols.intLY, &cols.att, &cols.pde, &cols.meanDarkCount, &cols.darkPedestal,
+                         &cols.gainMean, &cols.gainSigmaAbs, &cols.pedestal, &cols.asicNoise,
+                         &cols.invPhotonNorm, &cols.invPENorm}) {
+        column->resize(nRows);
+    }
+    for (int g = 0; g < 3; ++g) {
+        cols.rangeGain[g].resize(nRows);
+        cols.rangeFEENoise[g].resize(nRows);
+        cols.rangeADCSigma[g].resize(nRows);
+        cols.rangePedestalMean[g].resize(nRows);
+    }
+    
+    // 每行以全局快照为基础覆盖该通道的参数，再计算派生量
+    for (size_t r = 0; r < nRows; ++r) {
+        ParameterSnapshot s = defaults;
+        if (r > 0) {
+            for (size_t c = 0; c < members.size(); ++c) {
+                double value = fileValues[c][r - 1];
+                if (!std::isnan(value)) s.*members[c] = value;
+            }
+            s.computeDerived();
+        }
+        
+        cols.intLY[r] = s.EcalCryIntLY;
+        cols.att[r] = s.EcalCryAtt;
+        cols.pde[r] = s.EcalSiPMPDE;
+        cols.meanDarkCount[r] = s.meanDarkCount;
+        cols.darkPedestal[r] = s.darkPedestal;
+        cols.gainMean[r] = s.EcalSiPMGainMean;
+        cols.gainSigmaAbs[r] = s.gainSigmaAbs;
+        cols.pedestal[r] = s.Pedestal;
+        cols.asicNoise[r] = s.EcalASICNoiseSigma;
+        cols.invPhotonNorm[r] = s.invPhotonNorm;
+        cols.invPENorm[r] = s.invPENorm;
+        for (int g = 0; g < 3; ++g) {
+            cols.rangeGain[g][r] = s.rangeGain[g];
+            cols.rangeFEENoise[g][r] = s.rangeFEENoise[g];
+            cols.rangeADCSigma[g][r] = s.rangeADCSigma[g];
+            cols.rangePedestalMean[g][r] = s.rangePedestalMean[g];
+        }
+    }
+}
+
+int ChannelCalibration::rowOf(Int_t channel) const {
+    if (!denseRows.empty()) {
+        const long long index = static_cast<long long>(channel) - minChannel;
+        return index >= 0 && index < static_cast<long long>(denseRows.size()) ? denseRows[index] : 0;
+    }
+    // 重复的通道号取最后一行
+    auto it = std::upper_bound(sortedRows.begin(), sortedRows.end(),
+                               std::make_pair(channel, std::numeric_limits<int>::max()));
+    if (it == sortedRows.begin() || (it - 1)->first != channel) return 0;
+    return (it - 1)->second;
+}
+
+void ChannelCalibration::rowsOf(const Int_t* channels, int* rows, size_t n) const {
+    for (size_t i = 0; i < n; ++i) {
+        rows[i] = rowOf(channels[i]);
+    }
+}
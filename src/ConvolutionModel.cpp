@@ -0,0 +1,790 @@
+#include "ConvolutionModel.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <limits>
+
+namespace {
+
+const double kInf = std::numeric_limits<double>::infinity();
+
+double normalCdf(double x) {
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+// 在 [max(mean-12sigma, 0), mean+12sigma] 上按精确 Poisson 概率沉积到 k*scale 处
+void addPoissonPmf(GridPdf& out, double mean, double mass, double scale, bool nearest) {
+    if (mean <= 0) {
+        out.addPoint(0.0, mass, nearest);
+        return;
+    }
+    const double width = 12 * std::sqrt(mean) + 5;
+    const int kMin = static_cast<int>(std::max(0.0, std::floor(mean - width)));
+    const int kMax = static_cast<int>(std::ceil(mean + width));
+    const double logMean = std::log(mean);
+    for (int k = kMin; k <= kMax; ++k) {
+        double prob = std::exp(k * logMean - mean - std::lgamma(k + 1.0));
+        out.addPoint(k * scale, mass * prob, nearest);
+    }
+}
+
+// 二项分布 B(n, a) 的精确概率
+void addBinomialPmf(GridPdf& out, int n, double a, double mass, bool nearest) {
+    if (a <= 0 || n <= 0) {
+        out.addPoint(0.0, mass, nearest);
+        return;
+    }
+    if (a >= 1) {
+        out.addPoint(n, mass, nearest);
+        return;
+    }
+    const double logA = std::log(a);
+    const double logB = std::log1p(-a);
+    for (int k = 0; k <= n; ++k) {
+        double logC = std::lgamma(n + 1.0) - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0);
+        out.addPoint(k, mass * std::exp(logC + k * logA + (n - k) * logB), nearest);
+    }
+}
+
+// 以 0 为中心、间距 dx 的正态核（各点区间上的积分）
+GridPdf gaussianKernel(double sigma, double dx) {
+    GridPdf kernel;
+    kernel.dx = dx;
+    const int half = sigma > 0 ? static_cast<int>(std::ceil(8 * sigma / dx)) : 0;
+    kernel.x0 = -half * dx;
+    kernel.p.assign(2 * half + 1, 0.0);
+    if (half == 0) {
+        kernel.p[0] = 1.0;
+        return kernel;
+    }
+    for (int j = 0; j <= 2 * half; ++j) {
+        double x = kernel.x(j);
+        kernel.p[j] = normalCdf((x + 0.5 * dx) / sigma) - normalCdf((x - 0.5 * dx) / sigma);
+    }
+    return kernel;
+}
+
+// 原位迭代基2 FFT，inverse 时不做 1/n 归一化
+void fft(std::vector<std::complex<double>>& data, bool inverse) {
+    const size_t n = data.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(data[i], data[j]);
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        const double angle = 2 * M_PI / len * (inverse ? 1 : -1);
+        const std::complex<double> step(std::cos(angle), std::sin(angle));
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<double> w(1.0, 0.0);
+            for (size_t k = 0; k < len / 2; ++k) {
+                std::complex<double> u = data[i + k];
+                std::complex<double> v = data[i + k + len / 2] * w;
+                data[i + k] = u + v;
+                data[i + k + len / 2] = u - v;
+                w *= step;
+            }
+        }
+    }
+}
+
+// 把 src 累加到 dst 上：网格相同且对齐时逐点相加，否则在覆盖两者的较粗网格上线性重新分配
+void accumulate(GridPdf& dst, const GridPdf& src) {
+    if (src.p.empty()) return;
+    if (dst.p.empty()) {
+        dst = src;
+        return;
+    }
+    
+    const double dx = std::max(dst.dx, src.dx);
+    const double shift = (src.x0 - dst.x0) / dst.dx;
+    const bool aligned = src.dx == dst.dx && std::abs(shift - std::round(shift)) < 1e-6;
+    const double lo = std::min(dst.x0, src.x0);
+    const double hi = std::max(dst.x(dst.size() - 1), src.x(src.size() - 1));
+    
+    GridPdf merged;
+    merged.dx = dx;
+    merged.x0 = lo;
+    merged.p.assign(static_cast<size_t>(std::llround((hi - lo) / dx)) + 1, 0.0);
+    for (const GridPdf* part : {static_cast<const GridPdf*>(&dst), &src}) {
+        for (size_t i = 0; i < part->size(); ++i) {
+            if (part->p[i] > 0) merged.addPoint(part->x(i), part->p[i], aligned);
+        }
+    }
+    dst = std::move(merged);
+}
+
+// 中心大于 limit 的点的概率全部移到 limit 所在的点（ADC饱和）
+void clampAbove(GridPdf& pdf, double limit) {
+    if (pdf.p.empty()) return;
+    const long j = std::lround((limit - pdf.x0) / pdf.dx);
+    if (j >= static_cast<long>(pdf.size()) - 1) return;
+    if (j < 0) {
+        double total = pdf.total();
+        pdf.x0 = limit;
+        pdf.p.assign(1, total);
+        return;
+    }
+    for (size_t i = j + 1; i < pdf.size(); ++i) pdf.p[j] += pdf.p[i];
+    pdf.p.resize(j + 1);
+}
+
+// 中心小于 0 的点的概率移到 0 附近的点（截断负信号）
+void clampBelowZero(GridPdf& pdf) {
+    if (pdf.p.empty() || pdf.x0 >= 0) return;
+    const long j = std::lround(-pdf.x0 / pdf.dx);
+    if (j >= static_cast<long>(pdf.size())) {
+        double total = pdf.total();
+        pdf.x0 = 0.0;
+        pdf.p.assign(1, total);
+        return;
+    }
+    for (long i = 0; i < j; ++i) pdf.p[j] += pdf.p[i];
+    pdf.p.erase(pdf.p.begin(), pdf.p.begin() + j);
+    pdf.x0 += j * pdf.dx;
+}
+
+} // namespace
+
+// ===== GridPdf =====
+
+double GridPdf::total() const {
+    double sum = 0.0;
+    for (double v : p) sum += v;
+    return sum;
+}
+
+double GridPdf::mean() const {
+    double sum = 0.0, sumX = 0.0;
+    for (size_t i = 0; i < p.size(); ++i) {
+        sum += p[i];
+        sumX += p[i] * x(i);
+    }
+    return sum > 0 ? sumX / sum : 0.0;
+}
+
+double GridPdf::variance() const {
+    const double m = mean();
+    double sum = 0.0, sumX2 = 0.0;
+    for (size_t i = 0; i < p.size(); ++i) {
+        sum += p[i];
+        sumX2 += p[i] * (x(i) - m) * (x(i) - m);
+    }
+    return sum > 0 ? sumX2 / sum : 0.0;
+}
+
+void GridPdf::addPoint(double value, double mass, bool nearest) {
+    if (p.empty() || mass <= 0) return;
+    const long last = static_cast<long>(p.size()) - 1;
+    const double t = (value - x0) / dx;
+    if (nearest) {
+        p[std::min(std::max(std::lround(t), 0L), last)] += mass;
+        return;
+    }
+    
+    const long i = static_cast<long>(std::floor(t));
+    if (i < 0) {
+        p[0] += mass;
+    } else if (i >= last) {
+        p[last] += mass;
+    } else {
+        const double f = t - i;
+        p[i] += mass * (1 - f);
+        p[i + 1] += mass * f;
+    }
+}
+
+void GridPdf::addGaussian(double mean, double sigma, double mass, double lo, double hi) {
+    if (p.empty() || mass <= 0) return;
+    if (sigma <= 0) {
+        if (mean >= lo && mean <= hi) addPoint(mean, mass, true);
+        return;
+    }
+    
+    // 只积分 ±8 sigma 与 [lo, hi] 的交集
+    const double a = std::max(mean - 8 * sigma, lo);
+    const double b = std::min(mean + 8 * sigma, hi);
+    if (a > b) return;
+    const long last = static_cast<long>(p.size()) - 1;
+    const long first = std::max(static_cast<long>(std::floor((a - x0) / dx + 0.5)), 0L);
+    const long end = std::min(static_cast<long>(std::floor((b - x0) / dx + 0.5)), last);
+    
+    double previous = normalCdf((std::max(x(first) - 0.5 * dx, a) - mean) / sigma);
+    for (long i = first; i <= end; ++i) {
+        double upper = normalCdf((std::min(x(i) + 0.5 * dx, b) - mean) / sigma);
+        p[i] += mass * (upper - previous);
+        previous = upper;
+    }
+}
+
+void GridPdf::trim(double eps) {
+    if (p.empty()) return;
+    size_t first = 0;
+    for (double cumulative = 0.0; first + 1 < p.size(); ++first) {
+        cumulative += p[first];
+        if (cumulative > eps) break;
+    }
+    size_t last = p.size() - 1;
+    for (double cumulative = 0.0; last > first; --last) {
+        cumulative += p[last];
+        if (cumulative > eps) break;
+    }
+    p = std::vector<double>(p.begin() + first, p.begin() + last + 1);
+    x0 += first * dx;
+}
+
+void GridPdf::coarsen(size_t maxPoints) {
+    if (maxPoints == 0 || p.size() <= maxPoints) return;
+    const size_t factor = (p.size() + maxPoints - 1) / maxPoints;
+    std::vector<double> merged((p.size() + factor - 1) / factor, 0.0);
+    for (size_t i = 0; i < p.size(); ++i) merged[i / factor] += p[i];
+    x0 += 0.5 * (factor - 1) * dx;
+    dx *= factor;
+    p.swap(merged);
+}
+
+// ===== ConvolutionModel =====
+
+ConvolutionModel::ConvolutionModel(const DetectorParameters& params, size_t maxPoints)
+    : params(params), par(params.createSnapshot()), maxPoints(std::max<size_t>(maxPoints, 64)) {
+}
+
+GridPdf ConvolutionModel::makeGrid(double lo, double hi, bool integerLattice) const {
+    GridPdf grid;
+    if (integerLattice && hi - lo + 1 <= maxPoints) {
+        grid.x0 = std::floor(lo);
+        grid.dx = 1.0;
+        grid.p.assign(static_cast<size_t>(std::ceil(hi) - grid.x0) + 1, 0.0);
+    } else if (hi > lo) {
+        grid.x0 = lo;
+        grid.dx = (hi - lo) / (maxPoints - 1);
+        grid.p.assign(maxPoints, 0.0);
+    } else {
+        // 单点分布：区间宽度取可忽略的值
+        grid.x0 = lo;
+        grid.dx = std::max(std::abs(lo), 1.0) * 1e-9;
+        grid.p.assign(1, 0.0);
+    }
+    return grid;
+}
+
+GridPdf ConvolutionModel::poisson(double mean) const {
+    if (mean <= 0) {
+        GridPdf grid;
+        grid.p.assign(1, 1.0);
+        return grid;
+    }
+    
+    const double sigma = std::sqrt(mean);
+    GridPdf grid = makeGrid(std::max(0.0, mean - 12 * sigma - 5), mean + 12 * sigma + 5, true);
+    if (grid.dx == 1.0) {
+        addPoissonPmf(grid, mean, 1.0, 1.0, true);
+    } else {
+        // 均值很大时偏度可以忽略
+        grid.addGaussian(mean, sigma, 1.0, -kInf, kInf);
+    }
+    grid.trim(kTailCut);
+    return grid;
+}
+
+GridPdf ConvolutionModel::darkCountPdf() const {
+    const double lambda = par.meanDarkCount;
+    const double ct = par.borelCrosstalk;
+    GridPdf pdf;
+    if (lambda <= 0) {
+        pdf.p.assign(1, 1.0);
+        return pdf;
+    }
+    
+    // 复合分布的均值 lambda/(1-CT)、方差 lambda/(1-CT)^3
+    const double mean = lambda / (1 - ct);
+    const double sigma = std::sqrt(lambda / std::pow(1 - ct, 3));
+    
+    const int sLimit = 16 * static_cast<int>(maxPoints);
+    if (mean + 15 * sigma + 20 > sLimit) {
+        pdf = makeGrid(std::max(0.0, mean - 12 * sigma), mean + 12 * sigma, true);
+        pdf.addGaussian(mean, sigma, 1.0, -kInf, kInf);
+        return pdf;
+    }
+    
+    // Borel 尾部按 exp(-(CT-1-ln CT)*s) 衰减，CT 接近 1 时远长于 15 倍标准差，
+    // 逐项求和时把支撑延长到尾部衰减长度的 30 倍（不超过网格上限）
+    const double decay = ct > 0 ? ct - 1 - std::log(ct) : kInf;
+    const int sMax = static_cast<int>(std::ceil(std::min(std::max(mean + 15 * sigma, 30 / decay) + 20,
+                                                         static_cast<double>(sLimit))));
+    
+    // n 个初级暗计数的总计数服从 Borel-Tanner 分布
+    //   P(s|n) = n/s * (CT*s)^(s-n) * exp(-CT*s) / (s-n)!
+    pdf.p.assign(sMax + 1, 0.0);
+    const int nMax = std::min(sMax, static_cast<int>(std::ceil(lambda + 12 * std::sqrt(lambda) + 10)));
+    for (int n = 0; n <= nMax; ++n) {
+        double pn = std::exp(n * std::log(lambda) - lambda - std::lgamma(n + 1.0));
+        if (n == 0 || ct <= 0) {
+            pdf.p[n] += pn;
+            continue;
+        }
+        for (int s = n; s <= sMax; ++s) {
+            double logP = std::log(static_cast<double>(n)) - std::log(static_cast<double>(s)) +
+                          (s - n) * std::log(ct * s) - ct * s - std::lgamma(s - n + 1.0);
+            pdf.p[s] += pn * std::exp(logP);
+        }
+    }
+    pdf.trim(kTailCut);
+    return pdf;
+}
+
+GridPdf ConvolutionModel::convolve(const GridPdf& a, const GridPdf& b) {
+    GridPdf result;
+    result.x0 = a.x0 + b.x0;
+    result.dx = a.dx;
+    if (a.p.empty() || b.p.empty()) return result;
+    
+    const size_t n = a.size() + b.size() - 1;
+    result.p.assign(n, 0.0);
+    if (a.size() * b.size() <= (1u << 20)) {
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a.p[i] == 0) continue;
+            for (size_t j = 0; j < b.size(); ++j) result.p[i + j] += a.p[i] * b.p[j];
+        }
+        return result;
+    }
+    
+    size_t size = 1;
+    while (size < n) size <<= 1;
+    std::vector<std::complex<double>> fa(size), fb(size);
+    std::copy(a.p.begin(), a.p.end(), fa.begin());
+    std::copy(b.p.begin(), b.p.end(), fb.begin());
+    fft(fa, false);
+    fft(fb, false);
+    for (size_t i = 0; i < size; ++i) fa[i] *= fb[i];
+    fft(fa, true);
+    // FFT 的舍入误差会产生极小的负值
+    for (size_t i = 0; i < n; ++i) result.p[i] = std::max(fa[i].real() / size, 0.0);
+    return result;
+}
+
+ConvolutionModel::ResponsePdf ConvolutionModel::evaluate(double energy) const {
+    const SiPMResponseModel& model = params.getSiPMResponseModel();
+    
+    // ===== 闪烁体：衰减后的光子数 =====
+    const double nScin = energy * par.EcalCryIntLY;
+    const double att = par.EcalCryAtt;
+    GridPdf photons;
+    if (par.EcalCryLOFlu == 0.0) {
+        // Poisson 光子数的二项稀疏仍为 Poisson
+        photons = poisson(nScin * att);
+    } else {
+        // 高斯光产额后逐点二项衰减；光子数多时二项分布用 Poisson 或正态近似，以控制网格上的计算量
+        const double sigmaScin = nScin * par.EcalCryLOFlu;
+        GridPdf generated = makeGrid(std::max(0.0, nScin - 10 * sigmaScin), nScin + 10 * sigmaScin + 1, true);
+        generated.addGaussian(nScin, sigmaScin, 1.0, -kInf, kInf);
+        generated.trim(kTailCut);
+        
+        const double hi = generated.x(generated.size() - 1) * att;
+        photons = makeGrid(0.0, hi + 12 * std::sqrt(hi) + 5, generated.dx == 1.0);
+        const bool nearest = photons.dx == 1.0;
+        for (size_t i = 0; i < generated.size(); ++i) {
+            double n = generated.x(i);
+            double mass = generated.p[i];
+            if (mass <= 0) continue;
+            if (nearest && n < 100) {
+                addBinomialPmf(photons, static_cast<int>(n), att, mass, true);
+            } else if (nearest && n * att < 20) {
+                addPoissonPmf(photons, n * att, mass, 1.0, true);
+            } else {
+                photons.addGaussian(n * att, std::sqrt(n * att * (1 - att)), mass, -kInf, kInf);
+            }
+        }
+        photons.trim(kTailCut);
+    }
+    
+    // 光产额不均匀：round(A * f)，f ~ N(1, LYUn)
+    const double u = par.EcalCryLYUn;
+    if (u > 0) {
+        const double hi = photons.x(photons.size() - 1);
+        GridPdf smeared = makeGrid(std::max(0.0, photons.x0 * (1 - 10 * u)), hi * (1 + 10 * u) + 1,
+                                   photons.dx == 1.0);
+        for (size_t i = 0; i < photons.size(); ++i) {
+            smeared.addGaussian(photons.x(i), photons.x(i) * u, photons.p[i], -kInf, kInf);
+        }
+        smeared.trim(kTailCut);
+        photons = std::move(smeared);
+    }
+    
+    // ===== SiPM =====
+    // 光电子数 round(B * PDE)
+    const double pde = par.EcalSiPMPDE;
+    GridPdf pe = makeGrid(photons.x0 * pde, photons.x(photons.size() - 1) * pde, photons.dx == 1.0);
+    const bool peInteger = pe.dx == 1.0;
+    for (size_t i = 0; i < photons.size(); ++i) {
+        pe.addPoint(photons.x(i) * pde, photons.p[i], peInteger);
+    }
+    pe.trim(kTailCut);
+    
+    // 饱和：线性区为 Poisson(pe)*(1+CT)，饱和区为 N(R(pe), sigmaDet(R(pe)))
+    const double ct = par.EcalSiPMCT;
+    const double verbose = par.EcalSiPMDigiVerbose;
+    auto saturation = [&](double x, double& mean, double& sigma) {
+        if (verbose == 0 || x < 100) {
+            mean = x * (1 + ct);
+            sigma = std::sqrt(x) * (1 + ct);
+            return true;
+        }
+        mean = model.response(x);
+        sigma = model.sigmaDet(mean);
+        return false;
+    };
+    
+    double lo = kInf, hi = -kInf;
+    for (size_t i = 0; i < pe.size(); ++i) {
+        double mean, sigma;
+        saturation(pe.x(i), mean, sigma);
+        lo = std::min(lo, mean - 12 * sigma - 2 * (1 + ct));
+        hi = std::max(hi, mean + 12 * sigma + 2 * (1 + ct));
+    }
+    GridPdf signal = makeGrid(std::max(lo, 0.0), hi, false);
+    for (size_t i = 0; i < pe.size(); ++i) {
+        double mean, sigma;
+        bool linear = saturation(pe.x(i), mean, sigma);
+        if (linear && peInteger && pe.x(i) < 100) {
+            addPoissonPmf(signal, pe.x(i), pe.p[i], 1 + ct, false);
+        } else {
+            signal.addGaussian(mean, sigma, pe.p[i], -kInf, kInf);
+        }
+    }
+    signal.trim(kTailCut);
+    
+    // 暗计数及串扰：整数分布线性重新分配到信号网格后卷积
+    GridPdf dark = darkCountPdf();
+    GridPdf darkOnGrid;
+    darkOnGrid.dx = signal.dx;
+    darkOnGrid.p.assign(static_cast<size_t>(std::ceil(dark.x(dark.size() - 1) / signal.dx)) + 2, 0.0);
+    for (size_t i = 0; i < dark.size(); ++i) {
+        darkOnGrid.addPoint(dark.x(i), dark.p[i], false);
+    }
+    signal = convolve(signal, darkOnGrid);
+    signal.trim(kTailCut);
+    signal.coarsen(maxPoints);
+    
+    // 增益涨落：N(S, S * (gainSigmaAbs/GainMean)^2)
+    const double relGainSigma = par.gainSigmaAbs / par.EcalSiPMGainMean;
+    if (relGainSigma > 0) {
+        const double top = signal.x(signal.size() - 1);
+        const double width = 10 * std::sqrt(std::max(top, 0.0)) * relGainSigma;
+        GridPdf charge = makeGrid(signal.x0 - width, top + width, false);
+        for (size_t i = 0; i < signal.size(); ++i) {
+            double x = std::max(signal.x(i), 0.0);
+            charge.addGaussian(x, std::sqrt(x) * relGainSigma, signal.p[i], -kInf, kInf);
+        }
+        charge.trim(kTailCut);
+        signal = std::move(charge);
+    }
+    
+    // 扣除暗噪声基线，截断负信号，乘以门宽比例
+    signal.x0 -= par.darkPedestal;
+    clampBelowZero(signal);
+    signal.x0 *= par.EcalRatioTimeInterval;
+    signal.dx *= par.EcalRatioTimeInterval;
+    
+    // ===== 电子学 =====
+    ResponsePdf response = reconstruct(signal, energy);
+    
+    // 归一化截掉的尾部
+    const double total = response.pdf.total() + response.zeroFraction;
+    if (total > 0) {
+        for (double& v : response.pdf.p) v /= total;
+        response.zeroFraction /= total;
+    }
+    return response;
+}
+
+ConvolutionModel::ResponsePdf ConvolutionModel::reconstruct(const GridPdf& signal, double energy) const {
+    ResponsePdf response;
+    response.energy = energy;
+    
+    const double invNorm = par.invPENorm;
+    const double gainMean = par.EcalSiPMGainMean;
+    const double pedestal = par.Pedestal;
+    const double adcSwitch = par.ADCSwitch;
+    
+    // 档位边界（高增益ADC值）：adc <= ADCSwitch 为高增益，int(adc/GainRatio_12) <= ADCSwitch 为中增益
+    const double bound[2] = {adcSwitch + 0.5, std::ceil((adcSwitch + 1) * par.GainRatio_12) - 0.5};
+    const double sigmaHigh = par.rangeADCSigma[0];
+    
+    // 给定 X 时各档位的概率
+    auto rangeWeights = [&](double x, double w[3]) {
+        double mean = x * gainMean + pedestal;
+        double c1 = sigmaHigh > 0 ? normalCdf((bound[0] - mean) / sigmaHigh) : (mean <= bound[0] ? 1.0 : 0.0);
+        double c2 = sigmaHigh > 0 ? normalCdf((bound[1] - mean) / sigmaHigh) : (mean <= bound[1] ? 1.0 : 0.0);
+        w[0] = c1;
+        w[1] = c2 - c1;
+        w[2] = 1 - c2;
+    };
+    
+    // 档位 g 的整数ADC值对应的重建能量；饱和修正后的ADC值与逐事件链相同地取整
+    const bool invertResponse = par.EcalSiPMDigiVerbose >= 2 && signal.x(signal.size() - 1) >= 100;
+    auto energyOf = [&](double adc, int g, double x) {
+        if (invertResponse && x >= 100) {
+            double corrected = params.invertSiPMResponse((adc - pedestal) / gainMean);
+            adc = std::max(std::floor(corrected * par.rangeGain[g] + pedestal), 0.0);
+        }
+        return (adc - par.rangePedestalMean[g]) / par.rangeGain[g] * invNorm;
+    };
+    
+    GridPdf& y = response.pdf;
+    if (!invertResponse) {
+        // 线性重建：档位 g 的能量为 (X - 暗噪声基线)*invNorm 加上该档位的ADC噪声，
+        // 即按档位概率加权的 X 分布映射到能量后与正态核卷积
+        // 高增益档的能量是高增益ADC值的线性函数，档位选择等价于在能量上截断
+        for (int g = 0; g < 3; ++g) {
+            GridPdf mapped;
+            mapped.x0 = (signal.x0 - par.darkPedestal) * invNorm;
+            mapped.dx = signal.dx * invNorm;
+            mapped.p.assign(signal.size(), 0.0);
+            double weight = 0.0;
+            for (size_t i = 0; i < signal.size(); ++i) {
+                double w[3] = {1.0, 0.0, 0.0};
+                if (g > 0) rangeWeights(signal.x(i), w);
+                mapped.p[i] = signal.p[i] * w[g];
+                weight += mapped.p[i];
+            }
+            if (weight < kTailCut) continue;
+            
+            // 噪声核远宽于网格时先合并网格，限制核的点数
+            const double sigma = par.rangeADCSigma[g] / par.rangeGain[g] * invNorm;
+            const double minDx = 8 * sigma / (2.0 * maxPoints);
+            if (mapped.dx < minDx) {
+                mapped.coarsen(std::max<size_t>(1, static_cast<size_t>(mapped.size() * mapped.dx / minDx)));
+            }
+            
+            GridPdf component = convolve(mapped, gaussianKernel(sigma, mapped.dx));
+            if (g == 0) {
+                const double yHigh = (bound[0] - par.rangePedestalMean[0]) / gainMean * invNorm;
+                for (size_t i = 0; i < component.size(); ++i) {
+                    if (component.x(i) > yHigh) component.p[i] = 0.0;
+                }
+            } else if (g == 2) {
+                // 低增益ADC在 ADCSwitch 处饱和
+                clampAbove(component, (adcSwitch - par.rangePedestalMean[2]) / par.rangeGain[2] * invNorm);
+            }
+            component.trim(kTailCut);
+            accumulate(y, component);
+        }
+    } else {
+        // 饱和修正区的重建能量是ADC值的非线性函数：逐点在ADC节点上积分后沉积
+        const int kNodes = 64;
+        auto forEachNode = [&](double x, double mass, const std::function<void(double, double)>& visit) {
+            double w[3];
+            rangeWeights(x, w);
+            for (int g = 0; g < 3; ++g) {
+                double weight = g == 0 ? 1.0 : w[g];
+                if (mass * weight < kTailCut) continue;
+                const double sigma = par.rangeADCSigma[g];
+                const double mean = x * par.rangeGain[g] + pedestal;
+                double a = mean - 7 * sigma;
+                double b = mean + 7 * sigma;
+                if (g == 0) b = std::min(b, bound[0]);
+                if (a >= b) continue;
+                const double step = (b - a) / kNodes;
+                for (int k = 0; k < kNodes; ++k) {
+                    double adc = std::max(std::round(a + (k + 0.5) * step), 0.0);
+                    double prob = sigma > 0 ? normalCdf((a + (k + 1) * step - mean) / sigma) -
+                                              normalCdf((a + k * step - mean) / sigma) : 1.0 / kNodes;
+                    if (g == 2) adc = std::min(adc, adcSwitch);
+                    visit(energyOf(adc, g, x), mass * weight * prob);
+                }
+            }
+        };
+        
+        double lo = kInf, hi = -kInf;
+        for (size_t i = 0; i < signal.size(); ++i) {
+            if (signal.p[i] <= 0) continue;
+            forEachNode(signal.x(i), signal.p[i], [&](double value, double) {
+                lo = std::min(lo, value);
+                hi = std::max(hi, value);
+            });
+        }
+        y = makeGrid(lo, hi, false);
+        for (size_t i = 0; i < signal.size(); ++i) {
+            if (signal.p[i] <= 0) continue;
+            forEachNode(signal.x(i), signal.p[i], [&](double value, double mass) {
+                y.addPoint(value, mass, false);
+            });
+        }
+    }
+    
+    // 零压缩：低于阈值的能量置零
+    const double threshold = par.EcalMIP_Thre * par.EcalMIPEnergy;
+    for (size_t i = 0; i < y.size(); ++i) {
+        if (y.x(i) < threshold) {
+            response.zeroFraction += y.p[i];
+            y.p[i] = 0.0;
+        }
+    }
+    y.trim(0.0);
+    y.coarsen(maxPoints);
+    return response;
+}
+
+void ConvolutionModel::fillHistogram(const ResponsePdf& response, TH1D* hist, double nEvents) {
+    if (!hist) return;
+    
+    const GridPdf& pdf = response.pdf;
+    const int nBins = hist->GetXaxis()->GetNbins();
+    const double xMin = hist->GetXaxis()->GetXmin();
+    const double xMax = hist->GetXaxis()->GetXmax();
+    const double width = (xMax - xMin) / nBins;
+    
+    // 按区间重叠长度把每个网格点的概率分配到直方图箱，0 和 nBins+1 为下溢和上溢
+    std::vector<double> content(nBins + 2, 0.0);
+    auto binOf = [&](double x) {
+        if (x < xMin) return 0;
+        if (x >= xMax) return nBins + 1;
+        return std::min(static_cast<int>((x - xMin) / width) + 1, nBins);
+    };
+    for (size_t i = 0; i < pdf.size(); ++i) {
+        if (pdf.p[i] <= 0) continue;
+        const double lower = pdf.x(i) - 0.5 * pdf.dx;
+        const double upper = pdf.x(i) + 0.5 * pdf.dx;
+        const double density = pdf.p[i] / pdf.dx;
+        for (int bin = binOf(lower); bin <= binOf(upper); ++bin) {
+            double binLow = bin == 0 ? -kInf : xMin + (bin - 1) * width;
+            double binHigh = bin == nBins + 1 ? kInf : xMin + bin * width;
+            double overlap = std::min(upper, binHigh) - std::max(lower, binLow);
+            if (overlap > 0) content[bin] += density * overlap;
+        }
+    }
+    content[binOf(0.0)] += response.zeroFraction;
+    
+    for (int bin = 0; bin <= nBins + 1; ++bin) {
+        hist->SetBinContent(bin, content[bin] * nEvents);
+    }
+    hist->SetEntries(nEvents);
+}
+
+ResponseSummary ConvolutionModel::summarize(const ResponsePdf& response, double rangeMin, double rangeMax,
+                                            int64_t entries) {
+    ResponseSummary s;
+    s.energy = response.energy;
+    s.entries = entries;
+    const GridPdf& pdf = response.pdf;
+    const double zero = response.zeroFraction;
+    const double total = pdf.total() + zero;
+    if (entries <= 0 || total <= 0) return s;
+    
+    // 矩（含零压缩置零的部分）
+    double sumX = 0.0, sumX2 = 0.0;
+    for (size_t i = 0; i < pdf.size(); ++i) {
+        sumX += pdf.p[i] * pdf.x(i);
+        sumX2 += pdf.p[i] * pdf.x(i) * pdf.x(i);
+    }
+    s.mean = sumX / total;
+    s.rms = std::sqrt(std::max(sumX2 / total - s.mean * s.mean, 0.0));
+    s.meanError = s.rms / std::sqrt(static_cast<double>(entries));
+    
+    // 分位数：零压缩部分位于最低处，网格点在各自区间内均匀分布
+    std::vector<double> edges(pdf.size() + 1), cdf(pdf.size() + 1);
+    cdf[0] = zero / total;
+    for (size_t i = 0; i < pdf.size(); ++i) {
+        edges[i] = pdf.x(i) - 0.5 * pdf.dx;
+        cdf[i + 1] = cdf[i] + pdf.p[i] / total;
+    }
+    edges[pdf.size()] = pdf.x(pdf.size() - 1) + 0.5 * pdf.dx;
+    auto quantile = [&](double q) {
+        if (q <= cdf[0]) return zero > 0 ? 0.0 : edges[0];
+        size_t i = std::upper_bound(cdf.begin(), cdf.end(), q) - cdf.begin();
+        if (i >= cdf.size()) return edges.back();
+        double f = (q - cdf[i - 1]) / std::max(cdf[i] - cdf[i - 1], 1e-300);
+        return edges[i - 1] + f * (edges[i] - edges[i - 1]);
+    };
+    
+    // 包含 68.27% 概率的最短区间
+    const double fraction = 0.6827;
+    double best = kInf;
+    const int kSteps = 2000;
+    for (int k = 0; k <= kSteps; ++k) {
+        double q = (1 - fraction) * k / kSteps;
+        best = std::min(best, quantile(q + fraction) - quantile(q));
+    }
+    s.sigmaEff = 0.5 * best;
+    
+    // 半高全宽：与 QuantileSketch::fwhm 相同，在 [Q(0.005), Q(0.995)] 上分 100 个箱
+    const int nBins = 100;
+    const double lo = quantile(0.005);
+    const double hi = quantile(0.995);
+    if (hi > lo) {
+        const double width = (hi - lo) / nBins;
+        std::vector<double> hist(nBins, 0.0);
+        for (size_t i = 0; i < pdf.size(); ++i) {
+            for (int b = std::max(static_cast<int>((edges[i] - lo) / width), 0);
+                 b < nBins && lo + b * width < edges[i + 1]; ++b) {
+                double overlap = std::min(edges[i + 1], lo + (b + 1) * width) - std::max(edges[i], lo + b * width);
+                if (overlap > 0) hist[b] += pdf.p[i] * overlap / pdf.dx;
+            }
+        }
+        const int peak = static_cast<int>(std::max_element(hist.begin(), hist.end()) - hist.begin());
+        const double half = 0.5 * hist[peak];
+        auto center = [&](int i) { return lo + (i + 0.5) * width; };
+        double left = lo;
+        for (int i = peak; i > 0; --i) {
+            if (hist[i - 1] < half) {
+                left = center(i - 1) + (half - hist[i - 1]) / (hist[i] - hist[i - 1]) * width;
+                break;
+            }
+        }
+        double right = hi;
+        for (int i = peak; i < nBins - 1; ++i) {
+            if (hist[i + 1] < half) {
+                right = center(i) + (hist[i] - half) / (hist[i] - hist[i + 1]) * width;
+                break;
+            }
+        }
+        s.fwhm = right - left;
+    }
+    
+    // 中间 90% 的 RMS
+    const double qLow = quantile(0.05);
+    const double qHigh = quantile(0.95);
+    double w = 0.0, wx = 0.0, wx2 = 0.0;
+    if (zero > 0 && qLow <= 0.0) {
+        double part = std::min(cdf[0], 0.95) - 0.05;
+        if (part > 0) w += part;
+    }
+    for (size_t i = 0; i < pdf.size(); ++i) {
+        double a = std::max(edges[i], qLow);
+        double b = std::min(edges[i + 1], qHigh);
+        if (b <= a) continue;
+        double mass = pdf.p[i] / total * (b - a) / pdf.dx;
+        double x = 0.5 * (a + b);
+        w += mass;
+        wx += mass * x;
+        wx2 += mass * x * x;
+    }
+    if (w > 0) {
+        double m = wx / w;
+        s.truncatedRMS = std::sqrt(std::max(wx2 / w - m * m, 0.0));
+    }
+    
+    // 直方图范围外的比例
+    double under = 0.0 < rangeMin ? zero : 0.0;
+    double over = 0.0 >= rangeMax ? zero : 0.0;
+    for (size_t i = 0; i < pdf.size(); ++i) {
+        double span = edges[i + 1] - edges[i];
+        under += pdf.p[i] * std::clamp((rangeMin - edges[i]) / span, 0.0, 1.0);
+        over += pdf.p[i] * std::clamp((edges[i + 1] - rangeMax) / span, 0.0, 1.0);
+    }
+    s.underflowFraction = under / total;
+    s.overflowFraction = over / total;
+    
+    const double n = static_cast<double>(entries);
+    if (s.mean > 0) {
+        s.resolution = s.rms / s.mean;
+        s.resolutionError = s.resolution * std::sqrt(1.0 / (2.0 * n) + s.resolution * s.resolution / n);
+    }
+    if (s.energy > 0) {
+        s.linearity = (s.mean - s.energy) / s.energy;
+    }
+    return s;
+}
@@ -0,0 +1,180 @@
+#include "CountingSamplers.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// log(k!) 与 Stirling 公式之差，k < 10 时查表
+double stirlingTail(double k) {
+    static const double kTailValues[10] = {
+        0.0810614667953272, 0.0413406959554092, 0.0276779256849983, 0.02079067210376509,
+        0.0166446911898211, 0.0138761288230707, 0.0118967099458917, 0.0104112652619720,
+        0.00925546218271273, 0.00833056343336287
+    };
+    if (k < 10) return kTailValues[static_cast<int>(k)];
+    const double kp1sq = (k + 1) * (k + 1);
+    return (1.0 / 12 - (1.0 / 360 - 1.0 / 1260 / kp1sq) / kp1sq) / (k + 1);
+}
+
+// 抽样 nDraws 次，与精确概率 exp(logPmf(k)) 做卡方检验。均值 ±(10σ+10) 以外的概率
+// 并入两端的格，期望数不足 5 的相邻格合并
+bool chiSquareAgainstPmf(const std::string& name, double mean, double variance, int kMax, int nDraws,
+                         const std::function<int()>& draw, const std::function<double(int)>& logPmf) {
+    const double width = 10 * std::sqrt(variance) + 10;
+    const int kLo = std::max(0, static_cast<int>(std::floor(mean - width)));
+    const int kHi = std::min(kMax, static_cast<int>(std::ceil(mean + width)));
+    
+    std::vector<double> observed(kHi - kLo + 1, 0.0);
+    double sum = 0.0, sum2 = 0.0;
+    for (int d = 0; d < nDraws; ++d) {
+        const int k = draw();
+        sum += k;
+        sum2 += static_cast<double>(k) * k;
+        observed[std::clamp(k, kLo, kHi) - kLo] += 1;
+    }
+    
+    std::vector<double> expected(observed.size());
+    double total = 0.0;
+    for (int k = kLo; k <= kHi; ++k) {
+        expected[k - kLo] = nDraws * std::exp(logPmf(k));
+        total += expected[k - kLo];
+    }
+    expected.back() += std::max(0.0, nDraws - total);
+    
+    std::vector<std::pair<double, double>> bins;   // (观测数, 期望数)
+    double o = 0.0, e = 0.0;
+    for (size_t b = 0; b < observed.size(); ++b) {
+        o += observed[b];
+        e += expected[b];
+        if (e >= 5) {
+            bins.emplace_back(o, e);
+            o = e = 0.0;
+        }
+    }
+    if (bins.empty()) {
+        bins.emplace_back(o, e);
+    } else {
+        bins.back().first += o;
+        bins.back().second += e;
+    }
+    
+    double chi2 = 0.0;
+    for (const auto& bin : bins) {
+        chi2 += (bin.first - bin.second) * (bin.first - bin.second) / bin.second;
+    }
+    const int ndf = static_cast<int>(bins.size()) - 1;
+    const double sampleMean = sum / nDraws;
+    
+    std::cout << std::setw(26) << std::left << name << std::right
+              << " 均值 = " << sampleMean << " (" << mean << ")"
+              << ", 方差 = " << sum2 / nDraws - sampleMean * sampleMean << " (" << variance << ")"
+              << ", chi2/ndf = " << chi2 << "/" << ndf;
+    
+    // 多组参数同时检验，取约 4 倍标准差的阈值
+    const bool passed = ndf <= 0 || chi2 <= ndf + 4 * std::sqrt(2.0 * ndf);
+    if (!passed) std::cout << " (不一致)";
+    std::cout << std::endl;
+    return passed;
+}
+
+} // namespace
+
+void PoissonSampler::setup(double mean) {
+    if (mean == mu) return;
+    mu = mean;
+    inversion = mu < kInversionLimit;
+    if (inversion) {
+        expMinusMu = std::exp(-mu);
+        return;
+    }
+    
+    const double smu = std::sqrt(mu);
+    logMu = std::log(mu);
+    b = 0.931 + 2.53 * smu;
+    a = -0.059 + 0.02483 * b;
+    logInvAlpha = std::log(1.1239 + 1.1328 / (b - 3.4));
+    vr = 0.9277 - 3.6224 / (b - 2);
+}
+
+bool PoissonSampler::accept(double k, double us, double V) const {
+    return std::log(V) + logInvAlpha - std::log(a / (us * us) + b) <= -mu + k * logMu - std::lgamma(k + 1);
+}
+
+void BinomialSampler::setup(int n, double probability) {
+    if (n == trials && probability == prob) return;
+    trials = n;
+    prob = probability;
+    flipped = prob > 0.5;
+    p = flipped ? 1 - prob : prob;
+    q = 1 - p;
+    inversion = n * p < kInversionLimit;
+    if (p <= 0 || n <= 0) return;
+    ratio = p / q;
+    if (inversion) {
+        probZero = std::pow(q, n);
+        return;
+    }
+    
+    const double spq = std::sqrt(n * p * q);
+    b = 1.15 + 2.53 * spq;
+    a = -0.0873 + 0.0248 * b + 0.01 * p;
+    c = n * p + 0.5;
+    alpha = (2.83 + 5.1 / b) * spq;
+    vr = 0.92 - 4.2 / b;
+    mode = std::floor((n + 1) * p);
+}
+
+bool BinomialSampler::accept(double k, double us, double V) const {
+    const double n = trials;
+    const double m = mode;
+    const double logV = std::log(V * alpha / (a / (us * us) + b));
+    const double bound = (m + 0.5) * std::log((m + 1) / (ratio * (n - m + 1)))
+                       + (n + 1) * std::log((n - m + 1) / (n - k + 1))
+                       + (k + 0.5) * std::log(ratio * (n - k + 1) / (k + 1))
+                       + stirlingTail(m) + stirlingTail(n - m)
+                       - stirlingTail(k) - stirlingTail(n - k);
+    return logV <= bound;
+}
+
+bool checkCountingSamplers(int nDraws, PhiloxRandom& rng) {
+    std::cout << "=== 计数抽样器检验 (" << nDraws << " 次/组) ===" << std::endl;
+    std::cout << "括号内为理论值" << std::endl;
+    bool passed = true;
+    
+    for (double mean : {0.3, 3.0, 9.5, 10.0, 25.0, 100.0, 1e3, 1e5}) {
+        PoissonSampler sampler;
+        sampler.setup(mean);
+        const double logMean = std::log(mean);
+        passed &= chiSquareAgainstPmf("Poisson(" + std::to_string(mean) + ")", mean, mean, 
+            std::numeric_limits<int>::max(), nDraws,
+            [&]() { return sampler.sample(rng); },
+            [&](int k) { return -mean + k * logMean - std::lgamma(k + 1.0); });
+    }
+    
+    const std::pair<int, double> binomials[] = {
+        {10, 0.3}, {40, 0.2}, {200, 0.5}, {1000, 0.05}, {1000, 0.25}, {1000, 0.8},
+        {100000, 0.02}, {1000000, 0.25}, {1000000, 0.9}
+    };
+    for (const auto& [n, p] : binomials) {
+        BinomialSampler sampler;
+        sampler.setup(n, p);
+        const double logNorm = std::lgamma(n + 1.0);
+        passed &= chiSquareAgainstPmf("Binomial(" + std::to_string(n) + ", " + std::to_string(p) + ")",
+            n * p, n * p * (1 - p), n, nDraws,
+            [&]() { return sampler.sample(rng); },
+            [&](int k) {
+                return logNorm - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0)
+                     + k * std::log(p) + (n - k) * std::log1p(-p);
+            });
+    }
+    
+    std::cout << (passed ? "检验通过" : "检验失败") << std::endl;
+    return passed;
+}
@@ -0,0 +1,214 @@
+#include "CrosstalkSampler.h"
+#include "ParameterSnapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+// 建表的最大项数，防止 CT 接近 1 时尾部过长
+const int kMaxTableSize = 1000000;
+
+// 与原 TF1 f_DarkNoise 公式相同的 Borel 概率，用于参考循环
+double borelProbability(double ct, int k) {
+    return std::pow(ct * k, k - 1) * std::exp(-ct * k) / std::tgamma(k + 1.0);
+}
+
+} // namespace
+
+void CrosstalkSampler::CdfTable::buildGuide() {
+    const size_t size = cdf.size();
+    guide.assign(size, 0);
+    size_t index = 0;
+    for (size_t j = 0; j < size; ++j) {
+        double threshold = static_cast<double>(j) / size;
+        while (index + 1 < size && cdf[index] < threshold) ++index;
+        guide[j] = static_cast<int>(index);
+    }
+}
+
+int CrosstalkSampler::CdfTable::sample(double u) const {
+    const size_t size = cdf.size();
+    size_t index = guide[std::min(static_cast<size_t>(u * size), size - 1)];
+    while (cdf[index] < u) ++index;
+    return offset + static_cast<int>(index);
+}
+
+void CrosstalkSampler::configure(double crosstalk, Mode newMode) {
+    mode = newMode;
+    
+    // 与截断后的值比较，CT >= 1 时只在第一次配置时警告和建表
+    const double clamped = ParameterSnapshot::clampCrosstalk(crosstalk);
+    if (clamped == ct) return;
+    
+    if (crosstalk >= 1.0) {
+        std::cerr << "警告: 串扰概率 " << crosstalk << " >= 1，Borel 分布不收敛，截断为 "
+                  << clamped << std::endl;
+    }
+    ct = clamped;
+    tanner.clear();
+    tannerEntries = 0;
+    
+    // 构建 Borel 累积分布表
+    borel.offset = 1;
+    borel.cdf.clear();
+    double cumulative = 0.0;
+    for (int k = 1; k <= kMaxTableSize; ++k) {
+        double p = ct > 0 ? std::exp((k - 1) * std::log(ct * k) - ct * k - std::lgamma(k + 1.0)) 
+                          : (k == 1 ? 1.0 : 0.0);
+        cumulative += p;
+        borel.cdf.push_back(cumulative);
+        if (cumulative >= 1.0 - kTailCut) break;
+    }
+    // 剩余尾部概率并入最后一项，保证抽样总能结束
+    borel.cdf.back() = 1.0;
+    borel.buildGuide();
+}
+
+const CrosstalkSampler::CdfTable* CrosstalkSampler::tannerTable(int darkCount) {
+    if (static_cast<size_t>(darkCount) >= tanner.size()) {
+        tanner.resize(darkCount + 1);
+    }
+    
+    CdfTable& table = tanner[darkCount];
+    if (!table.cdf.empty()) return &table;
+    if (tannerEntries >= kMaxTannerEntries) return nullptr;
+    
+    table.offset = darkCount;
+    double cumulative = 0.0;
+    const double logN = std::log(static_cast<double>(darkCount));
+    for (int s = darkCount; s < darkCount + kMaxTableSize; ++s) {
+        int extra = s - darkCount;
+        double p = std::exp(logN - std::log(static_cast<double>(s)) + extra * std::log(ct * s) 
+                            - ct * s - std::lgamma(extra + 1.0));
+        cumulative += p;
+        table.cdf.push_back(cumulative);
+        if (cumulative >= 1.0 - kTailCut) break;
+    }
+    table.cdf.back() = 1.0;
+    table.buildGuide();
+    tannerEntries += table.cdf.size();
+    return &table;
+}
+
+int CrosstalkSampler::sampleCompound(int darkCount, TRandom& rng) {
+    if (const CdfTable* table = tannerTable(darkCount)) {
+        return table->sample(rng.Rndm());
+    }
+    int total = 0;
+    for (int i = 0; i < darkCount; ++i) {
+        total += sampleSingle(rng);
+    }
+    return total;
+}
+
+int CrosstalkSampler::sampleSingle(TRandom& rng) const {
+    return borel.sample(rng.Rndm());
+}
+
+int CrosstalkSampler::sampleTotal(int darkCount, TRandom& rng) {
+    if (darkCount <= 0) return 0;
+    if (ct <= 0) return darkCount;
+    
+    if (mode == kCompound) {
+        // n = m + r 个初级暗计数的总计数是 m 个和 r 个的总计数之和，大的暗计数拆成
+        // kMaxTannerDarkCount 一份分别查表，缓存的表不超过 kMaxTannerDarkCount 个
+        int total = 0;
+        for (; darkCount > kMaxTannerDarkCount; darkCount -= kMaxTannerDarkCount) {
+            total += sampleCompound(kMaxTannerDarkCount, rng);
+        }
+        return total + sampleCompound(darkCount, rng);
+    }
+    
+    int total = 0;
+    for (int i = 0; i < darkCount; ++i) {
+        total += sampleSingle(rng);
+    }
+    return total;
+}
+
+bool CrosstalkSampler::compareWithReference(double crosstalk, double meanDarkCount, 
+                                            int nTrials, TRandom& rng) {
+    CrosstalkSampler perCount;
+    CrosstalkSampler compound;
+    perCount.configure(crosstalk, kPerCount);
+    compound.configure(crosstalk, kCompound);
+    
+    // 原实现：逐个暗计数累加 Borel 概率直到超过均匀随机数
+    auto referenceTotal = [&](int darkCount) {
+        int total = 0;
+        for (int i = 0; i < darkCount; i++) {
+            double dark_rdm = rng.Uniform(0, 1);
+            int sum_dc = 1;
+            double prob = borelProbability(crosstalk, sum_dc);
+            while (dark_rdm > prob) {
+                sum_dc++;
+                prob += borelProbability(crosstalk, sum_dc);
+            }
+            total += sum_dc;
+        }
+        return total;
+    };
+    
+    std::vector<std::vector<long>> counts(3);
+    std::vector<double> sum(3, 0.0), sum2(3, 0.0);
+    
+    for (int trial = 0; trial < nTrials; ++trial) {
+        int result[3];
+        result[0] = referenceTotal(rng.Poisson(meanDarkCount));
+        result[1] = perCount.sampleTotal(rng.Poisson(meanDarkCount), rng);
+        result[2] = compound.sampleTotal(rng.Poisson(meanDarkCount), rng);
+        
+        for (int m = 0; m < 3; ++m) {
+            if (static_cast<size_t>(result[m]) >= counts[m].size()) {
+                counts[m].resize(result[m] + 1, 0);
+            }
+            counts[m][result[m]]++;
+            sum[m] += result[m];
+            sum2[m] += static_cast<double>(result[m]) * result[m];
+        }
+    }
+    
+    const char* names[3] = {"参考循环(TF1)", "逐计数查表", "复合分布"};
+    double expectedMean = meanDarkCount / (1 - crosstalk);
+    double expectedVar = meanDarkCount / std::pow(1 - crosstalk, 3);
+    
+    std::cout << "=== 串扰抽样检验 (CT = " << crosstalk << ", 平均暗计数 = " << meanDarkCount 
+              << ", " << nTrials << " 次) ===" << std::endl;
+    std::cout << "理论值: 均值 = " << expectedMean << ", 方差 = " << expectedVar << std::endl;
+    
+    bool passed = true;
+    for (int m = 0; m < 3; ++m) {
+        double mean = sum[m] / nTrials;
+        double var = sum2[m] / nTrials - mean * mean;
+        std::cout << std::setw(16) << std::left << names[m] 
+                  << " 均值 = " << mean << ", 方差 = " << var;
+        
+        if (m > 0) {
+            // 与参考循环比较的双样本卡方
+            size_t nBins = std::max(counts[0].size(), counts[m].size());
+            double chi2 = 0.0;
+            int ndf = -1;
+            for (size_t b = 0; b < nBins; ++b) {
+                double a = b < counts[0].size() ? counts[0][b] : 0;
+                double c = b < counts[m].size() ? counts[m][b] : 0;
+                if (a + c > 0) {
+                    chi2 += (a - c) * (a - c) / (a + c);
+                    ndf++;
+                }
+            }
+            std::cout << ", chi2/ndf = " << chi2 << "/" << ndf;
+            
+            // 约 3 倍标准差的阈值
+            if (ndf > 0 && chi2 > ndf + 3 * std::sqrt(2.0 * ndf)) {
+                passed = false;
+                std::cout << " (不一致)";
+            }
+        }
+        std::cout << std::endl;
+    }
+    
+    std::cout << (passed ? "检验通过" : "检验失败") << std::endl;
+    return passed;
+}
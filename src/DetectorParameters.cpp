@@ -28,10 +28,12 @@ void DetectorParameters::initializeDefaultParameters() {
     parameters["EcalSiPMPDEFlu"] = 0.10;
     parameters["EcalSiPMDCR"] = 2500000; // Hz
     parameters["EcalSiPMCT"] = 0.12;
+    parameters["EcalSiPMCTMode"] = 0;  // 0: 逐暗计数查表, 1: 复合分布
     parameters["EcalSiPMNeuFluence"] = 1000000;
     parameters["EcalSiPMGainMean"] = 5;
     parameters["EcalSiPMGainSigma"] = 0.08;
     parameters["EcalSiPMGainMeanFlu"] = 0.15;
+    parameters["EcalSiPMInvTolerance"] = 1e-6;  // 响应逆查找表的相对误差上限
 
     // 触发参数
     parameters["EcalTriggerThreshold"] = 0;
@@ -81,8 +83,8 @@ void DetectorParameters::setParameter(const std::string& name, double value) {
         parameters["GainRatio_23"] = parameters["TotalGain"] / value;
     }
     
-    // 如果修改了SiPM CT参数，更新响应函数
-    if (name == "EcalSiPMCT") {
+    // 如果修改了SiPM CT参数或逆查找表容差，更新响应函数
+    if (name == "EcalSiPMCT" || name == "EcalSiPMInvTolerance") {
         updateSiPMResponseParameters();
     }
 }
@@ -112,6 +114,7 @@ bool DetectorParameters::loadFromFile(const std::string& filename) {
         double value;
         
         if (iss >> name >> value) {
+            checkParameterName(name);
             setParameter(name, value);
         }
     }
@@ -250,6 +253,7 @@ bool DetectorParameters::loadFromConfigFile(const std::string& filename) {
             // 常规参数
             double value;
             if (iss >> value) {
+                checkParameterName(name);
                 setParameter(name, value);
                 std::cout << "设置参数: " << name << " = " << value << std::endl;
             } else {
@@ -280,63 +284,105 @@ std::vector<std::string> DetectorParameters::getAllParameterNames() const {
     return names;
 }
 
-void DetectorParameters::initializeSiPMFunctions() {
-    // 初始化SiPM响应函数
-    f_SiPMResponse = std::make_unique<TF1>("f_SiPMResponse", 
-        "((1-[1])*[0]*(1-exp(-x/[0]))+[1]*x)*([2]+1)/([2]+x/([0]*(1-exp(-x/[0]))))*(1+[3]*exp(-x/[0]))", 
-        0, 1e+9);
-    
-    // 设置默认参数
-    // f_SiPMResponse->SetParameters(6.19783e+06, 5.08847e-01, 1.27705e+01, parameters["EcalSiPMCT"]);
-    f_SiPMResponse->SetParameters(1.47821e+05, 2.81116e-01, 1.55157e+01, parameters["EcalSiPMCT"]);
+void DetectorParameters::checkParameterName(const std::string& name) const {
+    if (!ParameterSnapshot::isKnownParameter(name) && reportedUnknownParameters.insert(name).second) {
+        std::cerr << "警告: 未知参数 '" << name << "'，数字化器不会使用该参数" << std::endl;
+    }
+}
 
-    // 初始化SiPM探测器分辨率函数
-    f_SiPMSigmaDet = std::make_unique<TF1>("f_SiPMSigmaDet", "8.90971e-01*sqrt(x+5.47081e-01)", 0, 1e+9);
+ParameterSnapshot DetectorParameters::createSnapshot() const {
+    ParameterSnapshot snapshot;
     
-    // 初始化SiPM响应上下限函数
-    f_SiPMSigmaRecp = std::make_unique<TF1>("f_SiPMSigmaRecp", "f_SiPMResponse+f_SiPMSigmaDet", 0, 1e+9);
-    f_SiPMSigmaRecm = std::make_unique<TF1>("f_SiPMSigmaRecm", "f_SiPMResponse-f_SiPMSigmaDet", 0, 1e+9);
+    for (const auto& [name, field] : ParameterSnapshot::fields()) {
+        auto it = parameters.find(name);
+        if (it != parameters.end()) {
+            snapshot.*field = it->second;
+        } else {
+            std::cerr << "警告: 参数 '" << name << "' 未设置，快照中使用 0" << std::endl;
+        }
+    }
     
-    // 初始化非对称高斯函数
-    f_AsymGauss = std::make_unique<TF1>("AsymGauss", 
-        [](double *x, double *par) -> double {
-            double val = x[0];
-            double mean = par[0];
-            double sigma_left = par[1];
-            double sigma_right = par[2];
+    snapshot.computeDerived();
+    return snapshot;
+}
 
-            if (val < mean) {
-                return exp(-0.5 * pow((val - mean) / sigma_left, 2));
-            } else {
-                return exp(-0.5 * pow((val - mean) / sigma_right, 2));
-            }
-        }, 
-        -10, 10, 3);
+void DetectorParameters::initializeSiPMFunctions() {
+    // 初始化SiPM响应模型
+    // 旧参数: 6.19783e+06, 5.08847e-01, 1.27705e+01
+    responseModel.response.par[0] = 1.47821e+05;
+    responseModel.response.par[1] = 2.81116e-01;
+    responseModel.response.par[2] = 1.55157e+01;
+    responseModel.response.par[3] = parameters["EcalSiPMCT"];
+    
+    // SiPM探测器分辨率
+    responseModel.sigmaDet.par[0] = 8.90971e-01;
+    responseModel.sigmaDet.par[1] = 5.47081e-01;
+    
+    // 建立响应函数的逆查找表
+    buildResponseInverse();
 }
 
 TF1* DetectorParameters::getSiPMResponseFunction() {
+    if (!f_SiPMResponse) {
+        f_SiPMResponse = responseModel.response.makeTF1("f_SiPMResponse");
+    }
     return f_SiPMResponse.get();
 }
 
 TF1* DetectorParameters::getSiPMSigmaDetFunction() {
+    if (!f_SiPMSigmaDet) {
+        f_SiPMSigmaDet = responseModel.sigmaDet.makeTF1("f_SiPMSigmaDet");
+    }
     return f_SiPMSigmaDet.get();
 }
 
 TF1* DetectorParameters::getSiPMSigmaRecpFunction() {
+    if (!f_SiPMSigmaRecp) {
+        const SiPMResponseModel* model = &responseModel;
+        f_SiPMSigmaRecp = std::make_unique<TF1>("f_SiPMSigmaRecp", 
+            [model](double* x, double*) { return model->sigmaUpper(x[0]); }, 
+            0, 1e+9, 0, 1, TF1::EAddToList::kNo);
+    }
     return f_SiPMSigmaRecp.get();
 }
 
 TF1* DetectorParameters::getSiPMSigmaRecmFunction() {
+    if (!f_SiPMSigmaRecm) {
+        const SiPMResponseModel* model = &responseModel;
+        f_SiPMSigmaRecm = std::make_unique<TF1>("f_SiPMSigmaRecm", 
+            [model](double* x, double*) { return model->sigmaLower(x[0]); }, 
+            0, 1e+9, 0, 1, TF1::EAddToList::kNo);
+    }
     return f_SiPMSigmaRecm.get();
 }
 
 TF1* DetectorParameters::getAsymGaussFunction() {
+    if (!f_AsymGauss) {
+        f_AsymGauss = AsymGaussCurve().makeTF1("AsymGauss");
+    }
     return f_AsymGauss.get();
 }
 
 void DetectorParameters::updateSiPMResponseParameters() {
     // 更新SiPM响应函数的参数
+    responseModel.response.par[3] = parameters["EcalSiPMCT"];
     if (f_SiPMResponse) {
         f_SiPMResponse->SetParameter(3, parameters["EcalSiPMCT"]);
     }
-} 
\ No newline at end of file
+    buildResponseInverse();
+}
+
+void DetectorParameters::buildResponseInverse() {
+    double tolerance = parameters["EcalSiPMInvTolerance"];
+    const SiPMResponseCurve& response = responseModel.response;
+    if (responseInverseBuilt && response.par[3] == responseInverseCT 
+        && tolerance == responseInverseTolerance) {
+        return;
+    }
+    responseInverseBuilt = true;
+    responseInverseCT = response.par[3];
+    responseInverseTolerance = tolerance;
+    
+    responseInverse.build([&response](double x) { return response(x); }, 
+                          1e-3, 1e+9, tolerance);
+}
@@ -1,12 +1,34 @@
 #include "DigitizationBase.h"
+#include "HitReader.h"
+#include "BinaryHitFile.h"
 #include <iostream>
 #include <cmath>
 #include <TTreeReader.h>
 #include <TTreeReaderValue.h>
 #include <TFitResult.h>
+#include <TBranch.h>
+#include <TObjArray.h>
+#include <TROOT.h>
+#include <Compression.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// 将 src 中的全部条目追加到结构相同的 dst 树中：src 的分支改为读入 dst 的缓冲区，
+// 复制时不读写生成 src 的工作实例的成员，该实例可同时继续处理下一个任务
+void appendTreeEntries(TTree* dst, TTree* src) {
+    dst->CopyAddresses(src);
+    dst->CopyEntries(src);
+}
+
+} // namespace
 
 DigitizationBase::DigitizationBase(const std::string& name) 
-    : moduleName(name), params(DetectorParameters::getInstance()), rand(0) {
+    : moduleName(name), params(DetectorParameters::getInstance()), rand(0, PhiloxRandom::streamIdFromName(name)) {
     
     // 初始化能量点
     energies = params.getEnergyPoints();
@@ -15,21 +37,30 @@ DigitizationBase::DigitizationBase(const std::string& name)
         energies = {0.5*0.89, 0.89, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 30000};
     }
     
-    // 初始化直方图和函数
-    initializeHistograms();
-    initializeFunctions();
+    // 生成参数快照
+    refreshParameters();
+    
+    // 直方图和事件树在每次运行开始时创建，构造时不预先分配
     
     // 初始化数据树
     initializeDataTrees();
 }
 
 DigitizationBase::~DigitizationBase() {
-    // 智能指针会自动清理资源
+    // 智能指针会自动清理资源，事件树挂载在输出文件上时先关闭文件
+    closeOutput();
+}
+
+void DigitizationBase::refreshParameters() {
+    par = params.createSnapshot();
+    crosstalk.configure(par.EcalSiPMCT, 
+                        static_cast<CrosstalkSampler::Mode>(static_cast<int>(par.EcalSiPMCTMode)));
 }
 
 void DigitizationBase::initializeHistograms() {
     // 释放旧直方图防止内存泄漏
     h_Energies.clear();
+    energyStats.clear();
     
     // 使用模块名称前缀确保直方图名称唯一
     std::string prefix = moduleName + "_";
@@ -63,72 +94,14 @@ void DigitizationBase::initializeHistograms() {
             histName.c_str(), histTitle.c_str(), 
             nBins, histMin, histMax
         ));
+        
+        // 流式统计量，记录落在直方图范围外的比例
+        energyStats.emplace_back();
+        energyStats.back().rangeMin = histMin;
+        energyStats.back().rangeMax = histMax;
     }
     
     std::cout << "已初始化 " << h_Energies.size() << " 个能量直方图" << std::endl;
-    
-    // 初始化数据Tree
-    initializeTree();
-}
-
-void DigitizationBase::initializeFunctions() {
-    // SiPM响应函数
-    f_SiPMResponse = std::make_unique<TF1>(
-        "f_SiPMResponse", 
-        "((1-[1])*[0]*(1-exp(-x/[0]))+[1]*x)*([2]+1)/([2]+x/([0]*(1-exp(-x/[0]))))*(1+[3]*exp(-x/[0]))", 
-        0, 1e+9
-    );
-    f_SiPMResponse->SetParameters(
-        6.19783e+06, 
-        5.08847e-01, 
-        1.27705e+01, 
-        params.getParameter("EcalSiPMCT")
-    );
-    
-    // SiPM sigma探测函数
-    f_SiPMSigmaDet = std::make_unique<TF1>(
-        "f_SiPMSigmaDet", 
-        "8.336e-01*sqrt(x+0.2379)", 
-        0, 1e+9
-    );
-    
-    // SiPM sigma响应函数
-    f_SiPMSigmaRecp = std::make_unique<TF1>(
-        "f_SiPMSigmaRecp", 
-        "f_SiPMResponse+f_SiPMSigmaDet", 
-        0, 1e+9
-    );
-    
-    f_SiPMSigmaRecm = std::make_unique<TF1>(
-        "f_SiPMSigmaRecm", 
-        "f_SiPMResponse-f_SiPMSigmaDet", 
-        0, 1e+9
-    );
-    
-    // 非对称高斯函数
-    f_AsymGauss = std::make_unique<TF1>(
-        "AsymGauss", 
-        [](double *x, double *par) -> double {
-            double val = x[0];
-            double mean = par[0];
-            double sigma_left = par[1];
-            double sigma_right = par[2];
-
-            if (val < mean) {
-                return exp(-0.5 * pow((val - mean) / sigma_left, 2));
-            } else {
-                return exp(-0.5 * pow((val - mean) / sigma_right, 2));
-            }
-        }, 
-        -10, 10, 3
-    );
-    
-    // 暗噪声函数
-    f_DarkNoise = std::make_unique<TF1>(
-        "f_DarkNoise", 
-        "pow([0]*x, x-1) * exp(-[0]*x) / TMath::Factorial(x)"
-    );
-    f_DarkNoise->SetParameter(0, params.getParameter("EcalSiPMCT"));
 }
 
 void DigitizationBase::initializeTree() {
@@ -155,123 +128,528 @@ void DigitizationBase::initializeDataTrees() {
 }
 
 double DigitizationBase::calculateMeanCT() {
-    double mean_CT = 0;
-    for (int i = 1; i < 10; i++) {
-        mean_CT += (i-1) * f_DarkNoise->Eval(i);
-    }
-    return mean_CT;
+    // Borel 分布的均值为 1/(1-CT)，减去初级计数本身
+    double ct = crosstalk.getCrosstalk();
+    return ct > 0 ? ct / (1 - ct) : 0.0;
 }
 
 void DigitizationBase::run(int nEvents) {
-    // 确保直方图已初始化
+    // 参数在整个运行期间保持不变
+    refreshParameters();
+    instrumentation.reset();
+    const auto start = std::chrono::steady_clock::now();
+    
+    // 每次运行创建一次直方图和事件树
     initializeHistograms();
-    initializeFunctions();
-    initializeTree();
+    prepareTrees();
+    
+    std::cout << "运行 " << moduleName << " 数字化 (" << nEvents << " 事件, " 
+              << nThreads << " 线程)..." << std::endl;
+    
+    eventsPerPoint.assign(energies.size(), 0);
+    
+    if (targetPrecision > 0) {
+        // 自适应模式：nEvents 为每个能量点的事件数上限
+        runAdaptive(nEvents);
+    } else {
+        // 按能量点和事件区间切分任务
+        std::vector<RunTask> tasks;
+        for (size_t i = 0; i < energies.size(); ++i) {
+            // 安全检查：确保直方图存在
+            if (i >= h_Energies.size() || !h_Energies[i]) {
+                std::cerr << "错误：能量点 " << energies[i] << " MeV 的直方图未初始化" << std::endl;
+                continue;  // 跳过这个能量点
+            }
+            appendTasks(tasks, static_cast<int>(i), 0, nEvents);
+            eventsPerPoint[i] = nEvents;
+        }
+        
+        // 处理固定能量点
+        runTasks(tasks, nullptr);
+    }
+    
+    // 计算能量分辨率
+    calculateResolution();
     
-    std::cout << "运行 " << moduleName << " 数字化 (" << nEvents << " 事件)..." << std::endl;
+    uint64_t totalEvents = 0;
+    for (int n : eventsPerPoint) {
+        totalEvents += n;
+    }
     
-    // 处理固定能量点
+    // 如果启用了均匀抽样，单独处理
+    if (uniformSampling) {
+        // 确保抽样范围有效
+        if (samplingMinEnergy <= 0 || samplingMaxEnergy <= 0 || samplingMinEnergy >= samplingMaxEnergy) {
+            std::cerr << "错误：无效的抽样范围 [" << samplingMinEnergy << ", " << samplingMaxEnergy << "]" << std::endl;
+        } else {
+            runUniformSampling(nEvents);
+            totalEvents += nEvents;
+        }
+    }
+    
+    finishRunReport("run", totalEvents, start);
+}
+
+void DigitizationBase::finishRunReport(const char* mode, uint64_t events,
+                                       std::chrono::steady_clock::time_point start,
+                                       double inputSeconds, double digitizeSeconds) {
+    runReport.digitizer = moduleName;
+    runReport.mode = mode;
+    runReport.threads = nThreads;
+    runReport.events = events;
+    runReport.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    runReport.peakRSSMB = RunReport::peakRSS();
+    runReport.inputSeconds = inputSeconds;
+    runReport.digitizeSeconds = digitizeSeconds;
+    runReport.stats = instrumentation;
+    runReport.stats.apportionStageTimes();
+    runReport.print(std::cout);
+    if (!runReportFile.empty()) {
+        runReport.writeJSON(runReportFile);
+    }
+}
+
+void DigitizationBase::appendTasks(std::vector<RunTask>& tasks, int energyIndex, 
+                                   int firstEvent, int nEvents) const {
+    const int end = firstEvent + nEvents;
+    for (int first = firstEvent; first < end; first += kEventsPerTask) {
+        tasks.push_back({energyIndex, first, std::min(kEventsPerTask, end - first)});
+    }
+}
+
+void DigitizationBase::runAdaptive(int maxEvents) {
+    std::cout << "自适应事件数: 目标精度 " << targetPrecision 
+              << "，每个能量点最多 " << maxEvents << " 事件" << std::endl;
+    
+    // 每轮为未收敛的能量点追加事件，事件序号接续上一轮，随机数流与固定事件数运行相同
+    std::vector<int> target(energies.size(), 0);
     for (size_t i = 0; i < energies.size(); ++i) {
-        double energy = energies[i];
-        std::cout << "处理能量点: " << energy << " MeV" << std::endl;
+        if (i < h_Energies.size() && h_Energies[i]) {
+            target[i] = std::min(kEventsPerTask, maxEvents);
+        }
+    }
+    
+    for (int round = 1; ; ++round) {
+        std::vector<RunTask> tasks;
+        for (size_t i = 0; i < energies.size(); ++i) {
+            if (target[i] > eventsPerPoint[i]) {
+                appendTasks(tasks, static_cast<int>(i), eventsPerPoint[i], target[i] - eventsPerPoint[i]);
+                eventsPerPoint[i] = target[i];
+            }
+        }
+        if (tasks.empty()) break;
         
-        // 安全检查：确保直方图存在
-        if (i >= h_Energies.size() || !h_Energies[i]) {
-            std::cerr << "错误：能量点 " << energy << " MeV 的直方图未初始化" << std::endl;
-            continue;  // 跳过这个能量点
+        runTasks(tasks, nullptr);
+        
+        // 检查收敛：均值的相对误差和分辨率 sigma/mean 的绝对误差都不超过目标精度
+        int nPending = 0;
+        for (size_t i = 0; i < energies.size(); ++i) {
+            if (eventsPerPoint[i] == 0 || eventsPerPoint[i] >= maxEvents) continue;
+            
+            ResponseSummary summary = ResponseSummary::compute(energies[i], energyStats[i]);
+            double meanPrecision = summary.mean != 0 ? summary.meanError / std::abs(summary.mean) : 1.0;
+            double precision = std::max(meanPrecision, summary.resolutionError);
+            if (precision <= targetPrecision) continue;
+            
+            // 误差按 1/sqrt(n) 下降，外推所需事件数并留 10% 余量，至少追加一个任务
+            double scale = precision / targetPrecision;
+            double needed = 1.1 * eventsPerPoint[i] * scale * scale;
+            int next = static_cast<int>(std::min<double>(needed, maxEvents));
+            next = std::max(next, eventsPerPoint[i] + kEventsPerTask);
+            next = (next + kEventsPerTask - 1) / kEventsPerTask * kEventsPerTask;
+            target[i] = std::min(next, maxEvents);
+            ++nPending;
         }
         
-        // 获取对应的直方图
-        TH1D* hist = h_Energies[i].get();
+        std::cout << "自适应第 " << round << " 轮完成，" << nPending << " 个能量点尚未达到目标精度" << std::endl;
+    }
+    
+    for (size_t i = 0; i < energies.size(); ++i) {
+        std::cout << "能量点 " << energies[i] << " MeV 使用 " << eventsPerPoint[i] << " 事件" << std::endl;
+    }
+}
+
+void DigitizationBase::processTask(const RunTask& task, TH2D* h2Sampling) {
+    std::vector<double> inputs(kBatchSize);
+    std::vector<double> outputs(kBatchSize);
+    
+    // 随机数流按（能量点, 事件序号）定位，任务结束后恢复直接调用的流位置
+    const UInt_t savedSlot = streamEnergySlot;
+    const UInt_t savedNextEvent = streamNextEvent;
+    streamEnergySlot = static_cast<UInt_t>(task.energyIndex + 1);
+    
+    // 本任务的流式统计量，任务结束后按任务顺序合并
+    taskStats = EnergyPointStats();
+    if (task.energyIndex >= 0 && task.energyIndex < static_cast<int>(energyStats.size())) {
+        taskStats.rangeMin = energyStats[task.energyIndex].rangeMin;
+        taskStats.rangeMax = energyStats[task.energyIndex].rangeMax;
+    }
+    filterMoments.assign(task.energyIndex >= 0 ? 1 : kFilterEnergyBins, RunningMoments());
+    
+    for (int done = 0; done < task.nEvents; done += kBatchSize) {
+        const int n = std::min(kBatchSize, task.nEvents - done);
+        streamNextEvent = static_cast<UInt_t>(task.firstEvent + done);
         
-        // 模拟nEvents个事件
-        for (int j = 0; j < nEvents; ++j) {
-            // 设置当前处理的能量点
-            inputEnergy = energy;
+        if (task.energyIndex >= 0) {
+            double energy = energies[task.energyIndex];
+            std::fill(inputs.begin(), inputs.begin() + n, energy);
             
-            // 数字化
-            double outputEnergy = digitize(energy);
+            // 批量数字化
+            {
+                ScopedRunTimer timer(instrumentation, kTimerDigitize);
+                digitizeBatch(inputs.data(), outputs.data(), n);
+            }
             
             // 填充直方图
-            hist->Fill(outputEnergy);
-            
-            // 安全检查：确保2D直方图存在
+            ScopedRunTimer timer(instrumentation, kTimerHistogramFill);
+            h_Energies[task.energyIndex]->FillN(n, outputs.data(), nullptr);
+            taskStats.fill(outputs.data(), n);
             if (h2_dynamic) {
-                h2_dynamic->Fill(energy, outputEnergy);
+                h2_dynamic->FillN(n, inputs.data(), outputs.data(), nullptr);
+            }
+            continue;
+        }
+        
+        // 均匀抽样输入能量并进行数字化
+        try {
+            // 输入能量流中第 k 个数属于第 k 个事件，可直接跳到任务起点整块生成
+            rand.setStream(0, streamEnergySlot, kStageInputEnergy);
+            rand.skipTo(streamNextEvent);
+            rand.RndmArray(n, inputs.data());
+            const double range = samplingMaxEnergy - samplingMinEnergy;
+            for (int i = 0; i < n; ++i) {
+                inputs[i] = samplingMinEnergy + range * inputs[i];
             }
             
-            // 每处理10000个事件打印一次进度
-            if ((j+1) % 10000 == 0 || j == nEvents - 1) {
-                std::cout << "已处理 " << j+1 << "/" << nEvents << " 事件" << std::endl;
+            fillSamplingTree = true;
+            {
+                ScopedRunTimer timer(instrumentation, kTimerDigitize);
+                digitizeBatch(inputs.data(), outputs.data(), n);
+            }
+            fillSamplingTree = false;
+            
+            // 填充2D直方图
+            if (h2Sampling) {
+                ScopedRunTimer timer(instrumentation, kTimerHistogramFill);
+                h2Sampling->FillN(n, inputs.data(), outputs.data(), nullptr);
+            }
+        } catch (const std::exception& e) {
+            fillSamplingTree = false;
+            std::cerr << "处理均匀抽样时发生异常: " << e.what() << std::endl;
+        } catch (...) {
+            fillSamplingTree = false;
+            std::cerr << "处理均匀抽样时发生未知异常" << std::endl;
+        }
+    }
+    
+    streamEnergySlot = savedSlot;
+    streamNextEvent = savedNextEvent;
+}
+
+void DigitizationBase::digitizeBatch(const double* energies, double* outputs, size_t n,
+                                     const BatchIntermediates* /*aux*/) {
+    // 默认实现：逐事件调用 digitize
+    for (size_t i = 0; i < n; ++i) {
+        outputs[i] = digitize(energies[i]);
+    }
+}
+
+void DigitizationBase::fillTreesFromBatch(const double* inputs, const double* outputs, size_t n) {
+    TTree* sampling = fillSamplingTree ? samplingTree.get() : nullptr;
+    if (!dataTree && !sampling) return;
+    ScopedRunTimer timer(instrumentation, kTimerTreeFill);
+    
+    // 选择写入的事件
+    outputSelection.assign(n, output.level != OutputOptions::kFiltered);
+    if (output.level == OutputOptions::kPrescaled && output.prescale > 1) {
+        // 按全局事件序号预缩放，与线程数和批划分无关
+        for (size_t i = 0; i < n; ++i) {
+            outputSelection[i] = (streamFirstEvent + i) % output.prescale == 0;
+        }
+    } else if (output.level == OutputOptions::kFiltered) {
+        if (output.filterGainTransition) {
+            for (size_t i = 0; i < n; ++i) {
+                if (isGainTransition(i)) outputSelection[i] = 1;
+            }
+        }
+        
+        // 以相对偏差 (输出-输入)/输入 在同一能量点（均匀抽样时为同一输入能量区间）
+        // 已处理事件上的均值和标准差为参考，先累计本批再判断，参考量与批大小无关
+        if (output.filterSigma > 0) {
+            if (filterMoments.empty()) filterMoments.resize(1);
+            // 抽样下限为正时按对数分区间，使每个区间内 sigma(E)/E 的变化相近
+            const int nBins = static_cast<int>(filterMoments.size());
+            const bool logBins = samplingMinEnergy > 0 && samplingMaxEnergy > samplingMinEnergy;
+            const double lower = logBins ? std::log(samplingMinEnergy) : samplingMinEnergy;
+            const double range = (logBins ? std::log(samplingMaxEnergy) : samplingMaxEnergy) - lower;
+            std::vector<double> residual(n, 0.0);
+            std::vector<int> bin(n, 0);
+            for (size_t i = 0; i < n; ++i) {
+                residual[i] = inputs[i] > 0 ? (outputs[i] - inputs[i]) / inputs[i] : 0.0;
+                if (nBins > 1 && range > 0 && (!logBins || inputs[i] > 0)) {
+                    double x = logBins ? std::log(inputs[i]) : inputs[i];
+                    int b = static_cast<int>((x - lower) / range * nBins);
+                    bin[i] = std::min(std::max(b, 0), nBins - 1);
+                }
+                filterMoments[bin[i]].add(residual[i]);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const RunningMoments& reference = filterMoments[bin[i]];
+                if (reference.count() < 2) continue;
+                double cut = output.filterSigma * std::sqrt(reference.variance());
+                if (std::abs(residual[i] - reference.mean()) > cut) outputSelection[i] = 1;
             }
         }
     }
     
-    // 计算能量分辨率
-    calculateResolution();
+    for (size_t i = 0; i < n; ++i) {
+        if (!outputSelection[i]) continue;
+        loadBatchEvent(i);
+        storeBranches();
+        if (dataTree) dataTree->Fill();
+        if (sampling) sampling->Fill();
+    }
+}
+
+void DigitizationBase::runTasks(const std::vector<RunTask>& tasks, TH2D* h2Sampling) {
+    if (tasks.empty()) return;
     
-    // 如果启用了均匀抽样，单独处理
-    if (uniformSampling) {
-        // 确保抽样范围有效
-        if (samplingMinEnergy <= 0 || samplingMaxEnergy <= 0 || samplingMinEnergy >= samplingMaxEnergy) {
-            std::cerr << "错误：无效的抽样范围 [" << samplingMinEnergy << ", " << samplingMaxEnergy << "]" << std::endl;
-            return;
+    // 每个能量点（下标0为均匀抽样）的总事件数和已完成事件数，用于打印进度
+    std::vector<int> totalEvents(energies.size() + 1, 0);
+    std::vector<int> doneEvents(energies.size() + 1, 0);
+    for (const auto& task : tasks) {
+        totalEvents[task.energyIndex + 1] += task.nEvents;
+    }
+    
+    auto reportProgress = [&](const RunTask& task) {
+        int slot = task.energyIndex + 1;
+        doneEvents[slot] += task.nEvents;
+        if (task.energyIndex >= 0) {
+            std::cout << "能量点 " << energies[task.energyIndex] << " MeV: ";
+        } else {
+            std::cout << "均匀抽样: ";
         }
+        std::cout << "已处理 " << doneEvents[slot] << "/" << totalEvents[slot] << " 事件" << std::endl;
+    };
+    
+    int nWorkers = std::min<int>(nThreads, static_cast<int>(tasks.size()));
+    
+    // 串行运行：直接在当前实例上依次执行任务
+    if (nWorkers <= 1) {
+        for (const auto& task : tasks) {
+            processTask(task, h2Sampling);
+            if (task.energyIndex >= 0) {
+                energyStats[task.energyIndex].merge(taskStats);
+            }
+            reportProgress(task);
+        }
+        return;
+    }
+    
+    ROOT::EnableThreadSafety();
+    
+    // 在主线程中创建工作实例，每个实例拥有独立的直方图、树和随机数流
+    std::vector<std::unique_ptr<DigitizationBase>> workers;
+    std::vector<std::unique_ptr<TH2D>> workerSampling;
+    {
+        bool addDirectory = TH1::AddDirectoryStatus();
+        TH1::AddDirectory(kFALSE);
+        for (int w = 0; w < nWorkers; ++w) {
+            auto worker = createWorker();
+            worker->energies = energies;
+            worker->uniformSampling = uniformSampling;
+            worker->samplingMinEnergy = samplingMinEnergy;
+            worker->samplingMaxEnergy = samplingMaxEnergy;
+            worker->setRandomSeed(randomSeed);
+            worker->output = output;
+            worker->par = par;
+            worker->crosstalk = crosstalk;
+            worker->initializeHistograms();
+            workers.push_back(std::move(worker));
+            
+            if (h2Sampling) {
+                workerSampling.emplace_back(static_cast<TH2D*>(h2Sampling->Clone()));
+                workerSampling.back()->Reset();
+            }
+        }
+        TH1::AddDirectory(addDirectory);
+    }
+    
+    // 每个任务产生的事件树，按任务顺序追加到输出树，保证与串行运行一致
+    // 工作线程在锁内只交出完成的任务树；主线程按任务顺序等待就绪的任务，在锁外追加到输出树，
+    // 树的读写不阻塞其他工作线程交付任务，内存中只保留乱序完成的少数任务树
+    std::vector<std::unique_ptr<TTree>> taskTrees(tasks.size());
+    std::vector<std::unique_ptr<TTree>> taskSamplingTrees(tasks.size());
+    std::vector<EnergyPointStats> taskStatsList(tasks.size());
+    std::vector<char> taskDone(tasks.size(), 0);
+    
+    std::atomic<size_t> nextTask(0);
+    std::mutex progressMutex;
+    std::condition_variable taskReady;
+    
+    // 工作线程：从共享任务队列中动态领取任务
+    auto work = [&](int w) {
+        // 工作实例的树不挂载到任何目录
+        TDirectory::TContext context(nullptr);
+        DigitizationBase* worker = workers[w].get();
+        TH2D* h2 = workerSampling.empty() ? nullptr : workerSampling[w].get();
         
-        runUniformSampling(nEvents);
+        for (size_t t = nextTask++; t < tasks.size(); t = nextTask++) {
+            const RunTask& task = tasks[t];
+            try {
+                worker->prepareTrees();
+                if (task.energyIndex < 0) {
+                    worker->prepareSamplingTree();
+                }
+                worker->processTask(task, h2);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                std::cerr << "并行任务发生异常: " << e.what() << std::endl;
+            }
+            {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                taskTrees[t] = std::move(worker->dataTree);
+                taskSamplingTrees[t] = std::move(worker->samplingTree);
+                taskStatsList[t] = std::move(worker->taskStats);
+                taskDone[t] = 1;
+            }
+            taskReady.notify_one();
+        }
+    };
+    
+    std::vector<std::thread> threads;
+    for (int w = 0; w < nWorkers; ++w) {
+        threads.emplace_back(work, w);
+    }
+    
+    // 主线程写出：依次取出就绪的任务，追加事件树、合并统计量并打印进度
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        std::unique_ptr<TTree> taskTree, taskSamplingTree;
+        EnergyPointStats stats;
+        {
+            std::unique_lock<std::mutex> lock(progressMutex);
+            taskReady.wait(lock, [&] { return taskDone[t] != 0; });
+            taskTree = std::move(taskTrees[t]);
+            taskSamplingTree = std::move(taskSamplingTrees[t]);
+            stats = std::move(taskStatsList[t]);
+        }
+        if (dataTree && taskTree) {
+            appendTreeEntries(dataTree.get(), taskTree.get());
+        }
+        if (samplingTree && taskSamplingTree) {
+            appendTreeEntries(samplingTree.get(), taskSamplingTree.get());
+        }
+        if (tasks[t].energyIndex >= 0) {
+            energyStats[tasks[t].energyIndex].merge(stats);
+        }
+        reportProgress(tasks[t]);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    // 合并直方图和计时、计数
+    for (int w = 0; w < nWorkers; ++w) {
+        instrumentation.merge(workers[w]->instrumentation);
+        for (size_t i = 0; i < h_Energies.size() && i < workers[w]->h_Energies.size(); ++i) {
+            h_Energies[i]->Add(workers[w]->h_Energies[i].get());
+        }
+        if (h2_dynamic && workers[w]->h2_dynamic) {
+            h2_dynamic->Add(workers[w]->h2_dynamic.get());
+        }
+        if (h2Sampling) {
+            h2Sampling->Add(workerSampling[w].get());
+        }
     }
 }
 
-void DigitizationBase::calculateResolution() {
-    // 我们不再计算分辨率，只记录能量点信息
-    // 分辨率计算会在绘图脚本中进行
+void DigitizationBase::clearResponseSummaries() {
     resolutionData.energy.clear();
     resolutionData.resolution.clear();
     resolutionData.resError.clear();
+    linearityData.inputEnergy.clear();
+    linearityData.responseDiff.clear();
+    responseSummaries.clear();
+}
+
+void DigitizationBase::calculateResolution() {
+    // 由事件循环中累积的流式统计量计算分辨率和线性，不依赖直方图范围
+    clearResponseSummaries();
     
-    // 仅收集直方图基本统计信息用于日志
-    for (size_t i = 0; i < energies.size(); ++i) {
-        // 检查直方图是否有数据
-        if (h_Energies[i]->GetEntries() < 1) {
+    for (size_t i = 0; i < energies.size() && i < energyStats.size(); ++i) {
+        ResponseSummary summary = ResponseSummary::compute(energies[i], energyStats[i]);
+        if (summary.entries < 1) {
             std::cout << "警告：能量 " << energies[i] 
-                      << " MeV 的直方图没有数据" << std::endl;
+                      << " MeV 没有数据" << std::endl;
             continue;
         }
-        
-        // 只记录能量点
-        resolutionData.energy.push_back(energies[i]);
-        
-        // 输出基本统计信息
-        double mean = h_Energies[i]->GetMean();
-        double rms = h_Energies[i]->GetRMS();
-        std::cout << "Energy: " << energies[i] 
-                  << " MeV, Mean: " << mean 
-                  << ", RMS: " << rms << std::endl;
+        recordResponseSummary(summary);
     }
+}
+
+void DigitizationBase::recordResponseSummary(const ResponseSummary& summary) {
+    responseSummaries.push_back(summary);
     
-    std::cout << "注意：分辨率计算将在绘图脚本中进行" << std::endl;
+    resolutionData.energy.push_back(summary.energy);
+    resolutionData.resolution.push_back(summary.resolution);
+    resolutionData.resError.push_back(summary.resolutionError);
+    
+    linearityData.inputEnergy.push_back(summary.energy);
+    linearityData.responseDiff.push_back(summary.linearity);
+    
+    // 输出基本统计信息
+    std::cout << "Energy: " << summary.energy 
+              << " MeV, Mean: " << summary.mean 
+              << ", RMS: " << summary.rms
+              << ", sigma_eff: " << summary.sigmaEff
+              << ", FWHM: " << summary.fwhm
+              << ", RMS90: " << summary.truncatedRMS;
+    if (summary.underflowFraction > 0 || summary.overflowFraction > 0) {
+        std::cout << ", 直方图范围外: " << summary.underflowFraction * 100 << "% / " 
+                  << summary.overflowFraction * 100 << "%";
+    }
+    std::cout << std::endl;
 }
 
 void DigitizationBase::saveResults(const std::string& outputFile) {
+    // 运行前已通过 openOutput 打开文件时，事件树已写入该文件，直接在其中补充其余结果
+    const bool streaming = static_cast<bool>(outFile);
+    if (streaming && outputFile != outFileName) {
+        std::cerr << "警告：事件树已写入 " << outFileName << "，结果将保存到该文件而不是 " 
+                  << outputFile << std::endl;
+    }
+    
     // 创建输出文件
     TFile* file = nullptr;
     try {
-        file = TFile::Open(outputFile.c_str(), "RECREATE");
+        if (streaming) {
+            file = outFile.get();
+        } else {
+            file = TFile::Open(outputFile.c_str(), "RECREATE", "",
+                               output.compressionSettings >= 0 ? output.compressionSettings
+                                   : ROOT::RCompressionSetting::EDefaults::kUseGeneralPurpose);
+        }
         if (!file || file->IsZombie()) {
             std::cerr << "无法创建输出文件: " << outputFile << std::endl;
             return;
         }
+        file->cd();
         
         // 保存能量直方图
-        for (const auto& hist : h_Energies) {
-            if (hist) hist->Write();
+        if (output.writesHistograms()) {
+            for (const auto& hist : h_Energies) {
+                if (hist) hist->Write();
+            }
         }
         
-        // 保存事件树
-        if (dataTree) dataTree->Write();
+        // 保存每个能量点的响应汇总、分辨率和线性图
+        writeResponseSummary();
+        
+        // 保存事件树（流式写入时覆盖自动保存的树头）
+        if (dataTree) dataTree->Write("", TObject::kOverwrite);
         
         // 保存均匀抽样树
-        if (samplingTree) samplingTree->Write();
+        if (samplingTree) samplingTree->Write("", TObject::kOverwrite);
         
         // 添加参数保存
         try {
@@ -289,6 +667,20 @@ void DigitizationBase::saveResults(const std::string& outputFile) {
                                                    uniformSampling ? "true" : "false");
                 samplingEnabled->Write();
                 
+                // 保存事件级输出级别、分支类型和压缩设置
+                TNamed* outputLevel = new TNamed("outputLevel", output.describe().c_str());
+                outputLevel->Write();
+                
+                TNamed* branchTypes = new TNamed("branchTypes", 
+                                                 output.compactBranches ? "compact" : "double");
+                branchTypes->Write();
+                
+                TNamed* branchList = new TNamed("branches", describeBranches().c_str());
+                branchList->Write();
+                
+                TNamed* compression = new TNamed("compression", output.compressionName.c_str());
+                compression->Write();
+                
                 if (uniformSampling) {
                     char minEnergyStr[50], maxEnergyStr[50];
                     snprintf(minEnergyStr, 50, "%.6f", samplingMinEnergy);
@@ -344,17 +736,31 @@ void DigitizationBase::saveResults(const std::string& outputFile) {
                 // 保存能量点树
                 TTree* energyTree = new TTree("energyPoints", "Energy Points");
                 double energy;
+                int nEventsUsed;
                 energyTree->Branch("energy", &energy, "energy/D");
+                energyTree->Branch("nEvents", &nEventsUsed, "nEvents/I");
                 
-                for (double e : energies) {
-                    energy = e;
+                for (size_t i = 0; i < energies.size(); ++i) {
+                    energy = energies[i];
+                    nEventsUsed = i < eventsPerPoint.size() ? eventsPerPoint[i] : 0;
                     energyTree->Fill();
                 }
                 
+                // 保存自适应事件数的目标精度
+                if (targetPrecision > 0) {
+                    char precisionStr[50];
+                    snprintf(precisionStr, 50, "%g", targetPrecision);
+                    TNamed* precision = new TNamed("targetPrecision", precisionStr);
+                    precision->Write();
+                }
+                
                 // 写入树
                 paramTree->Write();
                 energyTree->Write();
                 
+                // 运行报告：耗时分布、计数器、事件率和峰值内存
+                runReport.write(paramDir);
+                
                 // 返回到主目录
                 file->cd();
             }
@@ -362,64 +768,82 @@ void DigitizationBase::saveResults(const std::string& outputFile) {
             std::cerr << "保存参数时发生异常，但将继续保存其他数据" << std::endl;
         }
         
-        // 注释掉分辨率图的创建
-        // try {
-        //     calculateResolution();
-        //     
-        //     if (!resolutionData.energy.empty()) {
-        //         int nPoints = resolutionData.energy.size();
-        //         double* x = new double[nPoints];
-        //         double* y = new double[nPoints];
-        //         double* ex = new double[nPoints]; // x误差
-        //         double* ey = new double[nPoints]; // y误差
-        //         
-        //         for (int i = 0; i < nPoints; i++) {
-        //             x[i] = resolutionData.energy[i];
-        //             y[i] = resolutionData.resolution[i];
-        //             ex[i] = 0.0; // 无x误差
-        //             ey[i] = resolutionData.resError[i];
-        //         }
-        //         
-        //         // 创建图形
-        //         TGraphErrors* g_Resolution = new TGraphErrors(nPoints, x, y, ex, ey);
-        //         g_Resolution->SetName("g_Resolution");
-        //         g_Resolution->SetTitle("Energy Resolution;Energy [MeV];#sigma/<E_{rec}> [%]");
-        //         
-        //         // 写入图形
-        //         g_Resolution->Write();
-        //         
-        //         // 清理内存
-        //         delete[] x;
-        //         delete[] y;
-        //         delete[] ex;
-        //         delete[] ey;
-        //     }
-        // } catch (...) {
-        //     std::cerr << "保存分辨率图时发生异常，但将继续保存其他数据" << std::endl;
-        // }
-        
         // 关闭文件
-        file->Close();
-        delete file;
-        
-        std::cout << "结果已保存到: " << outputFile << std::endl;
+        std::cout << "结果已保存到: " << (streaming ? outFileName : outputFile) << std::endl;
+        if (streaming) {
+            closeOutput();
+        } else {
+            file->Close();
+            delete file;
+        }
     }
     catch (const std::exception& e) {
         std::cerr << "保存结果时发生异常: " << e.what() << std::endl;
-        if (file) {
+        if (streaming) {
+            closeOutput();
+        } else if (file) {
             file->Close();
             delete file;
         }
     }
     catch (...) {
         std::cerr << "保存结果时发生未知异常" << std::endl;
-        if (file) {
+        if (streaming) {
+            closeOutput();
+        } else if (file) {
             file->Close();
             delete file;
         }
     }
 }
 
+void DigitizationBase::writeResponseSummary() {
+    // 响应汇总树，每个能量点一个条目
+    TTree* summaryTree = new TTree("summary", "Energy Point Response Summary");
+    ResponseSummary s;
+    Long64_t entries = 0;
+    summaryTree->Branch("energy", &s.energy, "energy/D");
+    summaryTree->Branch("entries", &entries, "entries/L");
+    summaryTree->Branch("mean", &s.mean, "mean/D");
+    summaryTree->Branch("meanError", &s.meanError, "meanError/D");
+    summaryTree->Branch("rms", &s.rms, "rms/D");
+    summaryTree->Branch("sigmaEff", &s.sigmaEff, "sigmaEff/D");
+    summaryTree->Branch("fwhm", &s.fwhm, "fwhm/D");
+    summaryTree->Branch("truncatedRMS", &s.truncatedRMS, "truncatedRMS/D");
+    summaryTree->Branch("underflowFraction", &s.underflowFraction, "underflowFraction/D");
+    summaryTree->Branch("overflowFraction", &s.overflowFraction, "overflowFraction/D");
+    summaryTree->Branch("resolution", &s.resolution, "resolution/D");
+    summaryTree->Branch("resolutionError", &s.resolutionError, "resolutionError/D");
+    summaryTree->Branch("linearity", &s.linearity, "linearity/D");
+    for (const auto& summary : responseSummaries) {
+        s = summary;
+        entries = summary.entries;
+        summaryTree->Fill();
+    }
+    summaryTree->Write();
+    
+    if (resolutionData.energy.empty()) return;
+    
+    // 分辨率图
+    const int nPoints = resolutionData.energy.size();
+    std::vector<double> ex(nPoints, 0.0);
+    TGraphErrors* g_Resolution = new TGraphErrors(nPoints, resolutionData.energy.data(), 
+                                                  resolutionData.resolution.data(), 
+                                                  ex.data(), resolutionData.resError.data());
+    g_Resolution->SetName("g_Resolution");
+    g_Resolution->SetTitle("Energy Resolution;Energy [MeV];#sigma/<E_{rec}>");
+    g_Resolution->Write();
+    delete g_Resolution;
+    
+    // 线性图
+    TGraph* g_Linearity = new TGraph(nPoints, linearityData.inputEnergy.data(), 
+                                     linearityData.responseDiff.data());
+    g_Linearity->SetName("g_Linearity");
+    g_Linearity->SetTitle("Linearity;Energy [MeV];(<E_{rec}>-E)/E");
+    g_Linearity->Write();
+    delete g_Linearity;
+}
+
 void DigitizationBase::saveParametersToFile(TFile* file) {
     // 这个方法暂时不会被调用
     if (!file || file->IsZombie()) return;
@@ -457,19 +881,454 @@ TGraphErrors* DigitizationBase::getResolutionGraph() const {
     return nullptr;
 }
 
+void DigitizationBase::setOutputOptions(const OutputOptions& options) {
+    output = options;
+    
+    // 分支在构造时声明，此时即可检查分支列表中的名称
+    for (const auto& name : output.branchSelection) {
+        auto declared = std::find_if(treeBranches.begin(), treeBranches.end(),
+                                     [&](const TreeBranch& branch) { return branch.name == name; });
+        if (declared != treeBranches.end()) continue;
+        std::cerr << "警告：" << moduleName << " 的事件树没有分支 '" << name << "'，可选分支为 ";
+        for (size_t i = 0; i < treeBranches.size(); ++i) {
+            std::cerr << (i > 0 ? "," : "") << treeBranches[i].name;
+        }
+        std::cerr << std::endl;
+    }
+}
+
+void DigitizationBase::declareBranch(const char* name, const double* source, BranchStorage storage) {
+    TreeBranch branch;
+    branch.name = name;
+    branch.source = source;
+    branch.storage = storage;
+    branch.written = storage;
+    branch.active = true;
+    branch.buffer.d = 0.0;
+    treeBranches.push_back(branch);
+}
+
+void DigitizationBase::createBranches(TTree* tree) {
+    if (!tree) return;
+    
+    int nActive = 0;
+    for (auto& branch : treeBranches) {
+        branch.active = output.isBranchSelected(branch.name);
+        if (!branch.active) continue;
+        ++nActive;
+        
+        branch.written = output.compactBranches ? branch.storage : BranchStorage::kDouble;
+        const char* name = branch.name.c_str();
+        switch (branch.written) {
+            case BranchStorage::kDouble:
+                tree->Branch(name, &branch.buffer.d, (branch.name + "/D").c_str());
+                break;
+            case BranchStorage::kFloat:
+                tree->Branch(name, &branch.buffer.f, (branch.name + "/F").c_str());
+                break;
+            case BranchStorage::kInt:
+                tree->Branch(name, &branch.buffer.i, (branch.name + "/I").c_str());
+                break;
+            case BranchStorage::kShort:
+                tree->Branch(name, &branch.buffer.s, (branch.name + "/S").c_str());
+                break;
+        }
+    }
+    
+    if (!treeBranches.empty() && nActive == 0) {
+        std::cerr << "警告：" << moduleName << " 的事件树没有选中任何分支" << std::endl;
+    }
+}
+
+void DigitizationBase::storeBranches() {
+    for (auto& branch : treeBranches) {
+        if (!branch.active) continue;
+        double value = *branch.source;
+        switch (branch.written) {
+            case BranchStorage::kDouble: branch.buffer.d = value; break;
+            case BranchStorage::kFloat:  branch.buffer.f = static_cast<Float_t>(value); break;
+            case BranchStorage::kInt:    branch.buffer.i = static_cast<Int_t>(std::lround(value)); break;
+            case BranchStorage::kShort:  branch.buffer.s = static_cast<Short_t>(std::lround(value)); break;
+        }
+    }
+}
+
+std::string DigitizationBase::describeBranches() const {
+    static const char* typeCodes[] = {"D", "F", "I", "S"};
+    std::string result;
+    for (const auto& branch : treeBranches) {
+        if (!output.isBranchSelected(branch.name)) continue;
+        BranchStorage type = output.compactBranches ? branch.storage : BranchStorage::kDouble;
+        if (!result.empty()) result += ",";
+        result += branch.name + "/" + typeCodes[static_cast<int>(type)];
+    }
+    return result;
+}
+
+bool DigitizationBase::openOutput(const std::string& outputFile) {
+    closeOutput();
+    
+    // 打开文件不改变当前目录，直方图仍由数字化器自己管理
+    TDirectory::TContext context;
+    outFile.reset(TFile::Open(outputFile.c_str(), "RECREATE"));
+    if (!outFile || outFile->IsZombie()) {
+        std::cerr << "无法创建输出文件: " << outputFile << std::endl;
+        outFile.reset();
+        return false;
+    }
+    if (output.compressionSettings >= 0) {
+        outFile->SetCompressionSettings(output.compressionSettings);
+    }
+    outFileName = outputFile;
+    return true;
+}
+
+void DigitizationBase::closeOutput() {
+    if (!outFile) return;
+    
+    // 事件树归文件目录所有，先删除再关闭文件
+    dataTree.reset();
+    samplingTree.reset();
+    outFile->Close();
+    outFile.reset();
+    outFileName.clear();
+}
+
+void DigitizationBase::configureTreeFlush(TTree* tree) const {
+    if (!tree || !outFile) return;
+    
+    // 基块累积到 autoFlushBytes 时写盘，同时保存树头，中断的文件仍可读取
+    tree->SetAutoFlush(-output.autoFlushBytes);
+    tree->SetAutoSave(-output.autoFlushBytes);
+}
+
+void DigitizationBase::prepareTrees() {
+    if (!output.writesTrees()) {
+        dataTree.reset();
+        samplingTree.reset();
+        return;
+    }
+    
+    if (outFile) {
+        // 事件树直接挂载到输出文件
+        TDirectory::TContext context(outFile.get());
+        initializeTree();
+    } else {
+        initializeTree();
+    }
+    configureTreeFlush(dataTree.get());
+    configureTreeFlush(samplingTree.get());
+}
+
+void DigitizationBase::prepareSamplingTree() {
+    if (!output.writesTrees()) {
+        samplingTree.reset();
+        return;
+    }
+    
+    if (outFile) {
+        TDirectory::TContext context(outFile.get());
+        initializeSamplingTree();
+    } else {
+        initializeSamplingTree();
+    }
+    configureTreeFlush(samplingTree.get());
+}
+
 // 添加默认的initializeSamplingTree实现
 void DigitizationBase::initializeSamplingTree() {
     // 创建一个通用的抽样树
     samplingTree = std::make_unique<TTree>("sampling", "Uniform Sampling Events");
 }
 
+void DigitizationBase::beginHits(HitContext& context) {
+    // 并行时每个线程一个工作实例，每批按击中序号均分
+    context.workers.clear();
+    if (nThreads > 1) {
+        ROOT::EnableThreadSafety();
+        TDirectory::TContext directory(nullptr);
+        for (int w = 0; w < nThreads; ++w) {
+            auto worker = createWorker();
+            worker->setRandomSeed(randomSeed);
+            worker->par = par;
+            worker->crosstalk = crosstalk;
+            worker->calibration = calibration;
+            worker->dataTree.reset();
+            worker->samplingTree.reset();
+            context.workers.push_back(std::move(worker));
+        }
+    }
+    
+    std::cout << "运行 " << moduleName << " 击中数字化 (" << nThreads << " 线程)..." << std::endl;
+    if (calibration) {
+        std::cout << "使用逐通道刻度表 (" << calibration->channelCount() << " 个通道)" << std::endl;
+    }
+    
+    instrumentation.reset();
+    context.nextHit = 0;
+    context.savedSlot = streamEnergySlot;
+    context.savedNextEvent = streamNextEvent;
+    context.start = std::chrono::steady_clock::now();
+}
+
+void DigitizationBase::digitizeHits(HitContext& context, const double* edep, const Int_t* channels, size_t n) {
+    const auto start = std::chrono::steady_clock::now();
+    const bool withADC = hasADCStage();
+    context.outputs.resize(n);
+    context.adc.resize(n);
+    context.gainMode.resize(n);
+    
+    // 通道号一次换算为刻度表行号，数字化时按行号读取各参数数组
+    if (calibration) {
+        context.rows.resize(n);
+        calibration->rowsOf(channels, context.rows.data(), n);
+    }
+    
+    // 随机数流由击中在输入中的全局序号定位，与线程数和读入时的分批方式无关，
+    // --hits 和转换后的 --hit-file 中同一击中使用同一随机数流
+    const ULong64_t firstHit = static_cast<ULong64_t>(context.nextHit);
+    context.nextHit += static_cast<Long64_t>(n);
+    auto digitizeRange = [&](DigitizationBase* digitizer, size_t first, size_t count) {
+        for (size_t done = 0; done < count;) {
+            const size_t offset = first + done;
+            const ULong64_t hit = firstHit + offset;
+            
+            // 每 2^32 个击中换一个槽位，一次批量数字化不跨越槽位边界
+            const ULong64_t slotRemaining = (1ULL << 32) - (hit & 0xFFFFFFFFULL);
+            const size_t m = static_cast<size_t>(std::min<ULong64_t>(std::min<size_t>(kBatchSize, count - done), slotRemaining));
+            digitizer->streamEnergySlot = kHitStreamSlot - static_cast<UInt_t>(hit >> 32);
+            digitizer->streamNextEvent = static_cast<UInt_t>(hit);
+            digitizer->batchRows = calibration ? context.rows.data() + offset : nullptr;
+            BatchIntermediates aux;
+            aux.adc = context.adc.data() + offset;
+            aux.gainMode = context.gainMode.data() + offset;
+            ScopedRunTimer timer(digitizer->instrumentation, kTimerDigitize);
+            digitizer->digitizeBatch(edep + offset, context.outputs.data() + offset, m,
+                                     withADC ? &aux : nullptr);
+            done += m;
+        }
+        digitizer->batchRows = nullptr;
+    };
+    
+    if (context.workers.empty()) {
+        digitizeRange(this, 0, n);
+    } else {
+        const size_t chunk = (n + context.workers.size() - 1) / context.workers.size();
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < context.workers.size() && w * chunk < n; ++w) {
+            threads.emplace_back(digitizeRange, context.workers[w].get(), w * chunk,
+                                 std::min(chunk, n - w * chunk));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    context.digitizeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void DigitizationBase::endHits(HitContext& context, const char* mode, Long64_t nHits,
+                               const RunningMoments& moments) {
+    streamEnergySlot = context.savedSlot;
+    streamNextEvent = context.savedNextEvent;
+    for (const auto& worker : context.workers) {
+        instrumentation.merge(worker->instrumentation);
+    }
+    context.workers.clear();
+    
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - context.start).count();
+    std::cout << "击中数字化完成: " << nHits << " 个击中, " << elapsed << " s";
+    if (elapsed > 0) {
+        std::cout << " (" << nHits / elapsed << " 击中/s)";
+    }
+    std::cout << ", 输出能量均值 " << moments.mean() << " MeV" << std::endl;
+    finishRunReport(mode, static_cast<uint64_t>(nHits), context.start,
+                    context.inputSeconds, context.digitizeSeconds);
+}
+
+void DigitizationBase::runHits(HitReader& reader, const std::string& outputFile) {
+    refreshParameters();
+    
+    // 击中模式不使用能量点的事件树
+    dataTree.reset();
+    samplingTree.reset();
+    
+    std::unique_ptr<TFile> file(TFile::Open(outputFile.c_str(), "RECREATE", "",
+                                            output.compressionSettings >= 0 ? output.compressionSettings
+                                                : ROOT::RCompressionSetting::EDefaults::kUseGeneralPurpose));
+    if (!file || file->IsZombie()) {
+        std::cerr << "无法创建输出文件: " << outputFile << std::endl;
+        return;
+    }
+    file->cd();
+    
+    // 每个击中一个条目，按输入顺序写出
+    const bool withADC = hasADCStage();
+    const bool withTime = reader.hasTime();
+    const bool compact = output.compactBranches;
+    TTree* hitTree = new TTree("digiHits", "Digitized Hits");
+    Long64_t event = 0;
+    Int_t channel = 0;
+    Int_t adc = 0;
+    Int_t gain = 0;
+    Double_t edep = 0.0, energy = 0.0;
+    Float_t edepF = 0.0f, energyF = 0.0f, time = 0.0f;
+    hitTree->Branch("event", &event, "event/L");
+    hitTree->Branch("channel", &channel, "channel/I");
+    if (compact) {
+        hitTree->Branch("edep", &edepF, "edep/F");
+        hitTree->Branch("energy", &energyF, "energy/F");
+    } else {
+        hitTree->Branch("edep", &edep, "edep/D");
+        hitTree->Branch("energy", &energy, "energy/D");
+    }
+    if (withADC) {
+        hitTree->Branch("adc", &adc, "adc/I");
+        hitTree->Branch("gain", &gain, "gain/I");
+    }
+    if (withTime) {
+        hitTree->Branch("time", &time, "time/F");
+    }
+    hitTree->SetAutoFlush(-output.autoFlushBytes);
+    hitTree->SetAutoSave(-output.autoFlushBytes);
+    
+    HitContext context;
+    beginHits(context);
+    
+    HitBatch hits;
+    Long64_t nHits = 0;
+    RunningMoments moments;
+    // 读取和数字化分别计时，运行报告中比较两者的吞吐量
+    auto readNext = [&]() {
+        const auto start = std::chrono::steady_clock::now();
+        const bool more = reader.next(hits, kHitBatchSize);
+        context.inputSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return more;
+    };
+    while (readNext()) {
+        const size_t n = hits.size();
+        digitizeHits(context, hits.edep.data(), hits.channel.data(), n);
+        
+        for (size_t i = 0; i < n; ++i) {
+            event = hits.event[i];
+            channel = hits.channel[i];
+            edep = hits.edep[i];
+            energy = context.outputs[i];
+            edepF = static_cast<Float_t>(edep);
+            energyF = static_cast<Float_t>(energy);
+            if (withADC) {
+                adc = static_cast<Int_t>(context.adc[i]);
+                gain = static_cast<Int_t>(context.gainMode[i]);
+            }
+            if (withTime) {
+                time = static_cast<Float_t>(hits.time[i]);
+            }
+            hitTree->Fill();
+            moments.add(energy);
+        }
+        nHits += static_cast<Long64_t>(n);
+        
+        std::cout << "已处理 " << reader.entriesRead() << "/" << reader.entries() 
+                  << " 条目, " << nHits << " 个击中" << std::endl;
+    }
+    
+    endHits(context, "hits", nHits, moments);
+    
+    file->cd();
+    hitTree->Write("", TObject::kOverwrite);
+    TDirectory* paramDir = file->mkdir("Parameters");
+    if (paramDir) {
+        paramDir->cd();
+        TNamed* digitizerType = new TNamed("digitizerType", moduleName.c_str());
+        digitizerType->Write();
+        TNamed* branchTypes = new TNamed("branchTypes", compact ? "compact" : "double");
+        branchTypes->Write();
+        TNamed* compression = new TNamed("compression", output.compressionName.c_str());
+        compression->Write();
+        runReport.write(paramDir);
+    }
+    file->Close();
+    std::cout << "击中结果已保存到 " << outputFile << std::endl;
+}
+
+void DigitizationBase::runHitFile(const std::string& inputFile, const std::string& outputFile) {
+    refreshParameters();
+    dataTree.reset();
+    samplingTree.reset();
+    
+    BinaryHitFile input;
+    if (!input.open(inputFile)) {
+        return;
+    }
+    if (input.kind() != BinaryHitFile::kHits) {
+        std::cerr << "错误：" << inputFile << " 不是输入击中文件" << std::endl;
+        return;
+    }
+    const bool withADC = hasADCStage();
+    const bool withTime = input.hasTime();
+    const uint64_t nRecords = input.size();
+    std::cout << "二进制击中输入: " << inputFile << ", " << nRecords << " 个击中"
+              << (withTime ? "（含时间）" : "") << std::endl;
+    
+    BinaryHitFile result;
+    const uint32_t flags = (withTime ? BinaryHitHeader::kHasTime : 0) | (withADC ? BinaryHitHeader::kHasADC : 0);
+    if (!result.create(outputFile, BinaryHitFile::kDigis, nRecords, flags)) {
+        return;
+    }
+    
+    HitContext context;
+    beginHits(context);
+    
+    // 记录按批直接从映射中读取，批内只把能量转换为 double 供数字化使用
+    std::vector<double> edep(kHitBatchSize);
+    std::vector<Int_t> channels(kHitBatchSize);
+    RunningMoments moments;
+    const uint64_t reportInterval = 64 * kHitBatchSize;
+    for (uint64_t first = 0; first < nRecords; first += kHitBatchSize) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(kHitBatchSize, nRecords - first));
+        const auto readStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            const HitRecord& hit = input.hit(first + i);
+            edep[i] = hit.edep;
+            channels[i] = hit.channel;
+        }
+        context.inputSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - readStart).count();
+        
+        digitizeHits(context, edep.data(), channels.data(), n);
+        
+        for (size_t i = 0; i < n; ++i) {
+            const HitRecord& hit = input.hit(first + i);
+            DigiRecord& digi = result.digi(first + i);
+            digi.event = hit.event;
+            digi.channel = hit.channel;
+            digi.edep = hit.edep;
+            digi.energy = static_cast<float>(context.outputs[i]);
+            digi.adc = withADC ? static_cast<int32_t>(context.adc[i]) : -1;
+            digi.gain = withADC ? static_cast<int32_t>(context.gainMode[i]) : -1;
+            digi.time = input.time(first + i);
+            moments.add(context.outputs[i]);
+        }
+        
+        // 已处理的部分不再访问，及时回收页面，文件大小不受内存限制
+        const uint64_t done = first + n;
+        input.release(first, done);
+        result.release(first, done);
+        if (done % reportInterval == 0 || done == nRecords) {
+            std::cout << "已处理 " << done << "/" << nRecords << " 个击中" << std::endl;
+        }
+    }
+    
+    endHits(context, "hitFile", static_cast<Long64_t>(nRecords), moments);
+    result.close();
+    std::cout << "击中结果已保存到 " << outputFile << std::endl;
+}
+
 // 执行均匀能量抽样
 void DigitizationBase::runUniformSampling(int nEvents) {
     std::cout << "执行均匀能量抽样 (" << nEvents << " 事件)..." << std::endl;
     std::cout << "能量范围: [" << samplingMinEnergy << ", " << samplingMaxEnergy << "] MeV" << std::endl;
     
     // 初始化均匀抽样树
-    initializeSamplingTree();
+    prepareSamplingTree();
     
     // 创建2D直方图记录输入和输出能量
     TH2D* h2_sampling = new TH2D("h2_sampling", "Uniform Sampling;Input Energy [MeV];Output Energy [MeV]",
@@ -477,45 +1336,9 @@ void DigitizationBase::runUniformSampling(int nEvents) {
                                 100, 0, samplingMaxEnergy * 1.5);
     
     // 均匀抽样能量点并进行数字化
-    for (int i = 0; i < nEvents; i++) {
-        try {
-            // 均匀抽样输入能量
-            double samplingInputEnergy = rand.Uniform(samplingMinEnergy, samplingMaxEnergy);
-            
-            // 保存原始输入能量
-            double originalInputEnergy = inputEnergy;
-            
-            // 设置新的输入能量
-            inputEnergy = samplingInputEnergy;
-            
-            // 数字化
-            double samplingOutputEnergy = digitize(samplingInputEnergy);
-            
-            // 恢复原始输入能量
-            inputEnergy = originalInputEnergy;
-            
-            // 填充2D直方图
-            if (h2_sampling) {
-                h2_sampling->Fill(samplingInputEnergy, samplingOutputEnergy);
-            }
-            
-            // 填充均匀抽样树
-            if (samplingTree) {
-                samplingTree->Fill();
-            }
-            
-            // 每处理10000个事件打印一次进度
-            if ((i+1) % 10000 == 0 || i == nEvents - 1) {
-                std::cout << "已处理 " << i+1 << "/" << nEvents << " 事件" << std::endl;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "处理均匀抽样时发生异常: " << e.what() << std::endl;
-            continue;  // 跳过这个事件
-        } catch (...) {
-            std::cerr << "处理均匀抽样时发生未知异常" << std::endl;
-            continue;  // 跳过这个事件
-        }
-    }
+    std::vector<RunTask> tasks;
+    appendTasks(tasks, -1, 0, nEvents);
+    runTasks(tasks, h2_sampling);
     
     // 保存2D直方图
     if (h2_sampling) {
@@ -524,4 +1347,4 @@ void DigitizationBase::runUniformSampling(int nEvents) {
     }
     
     std::cout << "均匀能量抽样完成" << std::endl;
-} 
\ No newline at end of file
+}
@@ -1,5 +1,10 @@
 #include "DigitizationManager.h"
 #include "DetectorParameters.h"
+#include "AnalyticModel.h"
+#include "ResponseTable.h"
+#include "BinaryHitFile.h"
+#include "CountingSamplers.h"
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
@@ -7,7 +12,10 @@
 #include <sys/stat.h>
 #include <TFile.h>
 #include <TTree.h>
+#include <TGraph.h>
 #include <TROOT.h>
+#include <TNamed.h>
+#include <Compression.h>
 #include <cstring>
 #include <chrono>
 
@@ -15,22 +23,43 @@ DigitizationManager::DigitizationManager() : nEvents(100000) {
     // 清除ROOT内部缓存的对象
     gROOT->Reset();
     
-    // 初始化数字化器
-    scinDigitizer = std::make_unique<ScintillationDigitizer>();
-    sipmDigitizer = std::make_unique<SiPMDigitizer>();
-    adcDigitizer = std::make_unique<ADCDigitizer>();
-    totalDigitizer = std::make_unique<TotalDigitizer>();
+    // 数字化器在首次使用时创建，只运行其中一个时不构造其余的
     
     // 设置随机数种子
     unsigned int seed = std::chrono::system_clock::now().time_since_epoch().count();
     setRandomSeed(seed);
 }
 
+void DigitizationManager::configureDigitizer(DigitizationBase& digitizer) const {
+    digitizer.setRandomSeed(randomSeed);
+    digitizer.setNumberOfThreads(nThreads);
+    digitizer.setTargetPrecision(targetPrecision);
+    digitizer.setOutputOptions(outputOptions);
+    digitizer.setUniformSampling(uniformSampling);
+    digitizer.setSamplingRange(samplingMinEnergy, samplingMaxEnergy);
+}
+
 void DigitizationManager::setRandomSeed(unsigned int seed) {
-    scinDigitizer->setRandomSeed(seed);
-    sipmDigitizer->setRandomSeed(seed);
-    adcDigitizer->setRandomSeed(seed);
-    totalDigitizer->setRandomSeed(seed);
+    randomSeed = seed;
+    forEachDigitizer([seed](DigitizationBase& d) { d.setRandomSeed(seed); });
+}
+
+void DigitizationManager::setNumberOfThreads(int threads) {
+    nThreads = threads > 0 ? threads : 1;
+    forEachDigitizer([this](DigitizationBase& d) { d.setNumberOfThreads(nThreads); });
+}
+
+void DigitizationManager::setTargetPrecision(double precision) {
+    targetPrecision = precision;
+    forEachDigitizer([precision](DigitizationBase& d) { d.setTargetPrecision(precision); });
+}
+
+void DigitizationManager::setOutputOptions(const OutputOptions& options) {
+    outputOptions = options;
+    forEachDigitizer([&options](DigitizationBase& d) { d.setOutputOptions(options); });
+    std::cout << "事件级输出: " << options.describe() 
+              << ", 分支类型: " << (options.compactBranches ? "compact" : "double")
+              << ", 压缩: " << options.compressionName << std::endl;
 }
 
 bool DigitizationManager::loadParameters(const std::string& filename) {
@@ -46,7 +75,10 @@ double DigitizationManager::getParameter(const std::string& name) {
 }
 
 void DigitizationManager::setParameter(const std::string& name, double value) {
-    DetectorParameters::getInstance().setParameter(name, value);
+    // 命令行 -p 和 --scan 的参数名与配置文件中的一样检查
+    auto& params = DetectorParameters::getInstance();
+    params.checkParameterName(name);
+    params.setParameter(name, value);
 }
 
 void DigitizationManager::printParameters() {
@@ -60,36 +92,19 @@ void DigitizationManager::setEnergyPoints(const std::vector<double>& energies) {
     // 设置参数
     params.setEnergyPoints(energies);
     
-    // 设置到所有数字化器
-    if (scinDigitizer) {
-        scinDigitizer->clearEnergyPoints();
-        for (double e : energies) {
-            scinDigitizer->addEnergyPoint(e);
-        }
-    }
-    
-    if (sipmDigitizer) {
-        sipmDigitizer->clearEnergyPoints();
-        for (double e : energies) {
-            sipmDigitizer->addEnergyPoint(e);
-        }
-    }
+    // 设置到已创建的数字化器
+    applyEnergyPoints(energies);
     
-    if (adcDigitizer) {
-        adcDigitizer->clearEnergyPoints();
-        for (double e : energies) {
-            adcDigitizer->addEnergyPoint(e);
-        }
-    }
-    
-    if (totalDigitizer) {
-        totalDigitizer->clearEnergyPoints();
+    std::cout << "设置了 " << energies.size() << " 个能量点" << std::endl;
+}
+
+void DigitizationManager::applyEnergyPoints(const std::vector<double>& energies) {
+    forEachDigitizer([&energies](DigitizationBase& d) {
+        d.clearEnergyPoints();
         for (double e : energies) {
-            totalDigitizer->addEnergyPoint(e);
+            d.addEnergyPoint(e);
         }
-    }
-    
-    std::cout << "设置了 " << energies.size() << " 个能量点" << std::endl;
+    });
 }
 
 bool DigitizationManager::loadEnergyPointsFromFile(const std::string& filename) {
@@ -103,34 +118,8 @@ bool DigitizationManager::loadEnergyPointsFromFile(const std::string& filename)
         // 获取加载的能量点
         const std::vector<double>& energies = params.getEnergyPoints();
         
-        // 设置到所有数字化器
-        if (scinDigitizer) {
-            scinDigitizer->clearEnergyPoints();
-            for (double e : energies) {
-                scinDigitizer->addEnergyPoint(e);
-            }
-        }
-        
-        if (sipmDigitizer) {
-            sipmDigitizer->clearEnergyPoints();
-            for (double e : energies) {
-                sipmDigitizer->addEnergyPoint(e);
-            }
-        }
-        
-        if (adcDigitizer) {
-            adcDigitizer->clearEnergyPoints();
-            for (double e : energies) {
-                adcDigitizer->addEnergyPoint(e);
-            }
-        }
-        
-        if (totalDigitizer) {
-            totalDigitizer->clearEnergyPoints();
-            for (double e : energies) {
-                totalDigitizer->addEnergyPoint(e);
-            }
-        }
+        // 设置到已创建的数字化器
+        applyEnergyPoints(energies);
         
         std::cout << "成功从文件加载了 " << energies.size() << " 个能量点" << std::endl;
     } else {
@@ -163,27 +152,212 @@ bool DigitizationManager::loadFromConfigFile(const std::string& filename) {
     return success;
 }
 
+DigitizationBase* DigitizationManager::findDigitizer(const std::string& type) {
+    if (type == "Scintillation") {
+        return obtain(scinDigitizer);
+    } else if (type == "SiPM") {
+        return obtain(sipmDigitizer);
+    } else if (type == "ADC") {
+        return obtain(adcDigitizer);
+    } else if (type == "Total") {
+        return obtain(totalDigitizer);
+    }
+    std::cerr << "未知的数字化器类型: " << type << std::endl;
+    return nullptr;
+}
+
 void DigitizationManager::runSingleDigitizer(const std::string& type, const std::string& outputPrefix) {
     std::string outputFile = "digi_out_" + type + ".root";
     if (!outputPrefix.empty()) {
         outputFile = outputPrefix + "_" + type + ".root";
     }
     
-    if (type == "Scintillation") {
-        scinDigitizer->run(nEvents);
-        scinDigitizer->saveResults(outputFile);
-    } else if (type == "SiPM") {
-        sipmDigitizer->run(nEvents);
-        sipmDigitizer->saveResults(outputFile);
-    } else if (type == "ADC") {
-        adcDigitizer->run(nEvents);
-        adcDigitizer->saveResults(outputFile);
-    } else if (type == "Total") {
-        totalDigitizer->run(nEvents);
-        totalDigitizer->saveResults(outputFile);
-    } else {
-        std::cerr << "未知的数字化器类型: " << type << std::endl;
+    DigitizationBase* digitizer = findDigitizer(type);
+    if (!digitizer) {
+        return;
+    }
+    
+    // 先打开输出文件，事件树在运行中直接写盘
+    if (!digitizer->openOutput(outputFile)) {
+        return;
+    }
+    applyRunReportFile(digitizer, outputFile);
+    digitizer->run(nEvents);
+    digitizer->saveResults(outputFile);
+}
+
+void DigitizationManager::runHits(const HitInputOptions& input, const std::string& type,
+                                  const std::string& outputPrefix) {
+    std::string outputFile = "digi_out_" + type + "_hits.root";
+    if (!outputPrefix.empty()) {
+        outputFile = outputPrefix + "_" + type + "_hits.root";
+    }
+    
+    DigitizationBase* digitizer = findDigitizer(type);
+    if (!digitizer) {
+        return;
+    }
+    
+    HitReader reader(input);
+    if (!reader.open()) {
+        return;
     }
+    
+    applyChannelCalibration(digitizer);
+    applyRunReportFile(digitizer, outputFile);
+    digitizer->runHits(reader, outputFile);
+    digitizer->setChannelCalibration(nullptr);
+}
+
+void DigitizationManager::runHitFile(const std::string& inputFile, const std::string& type,
+                                     const std::string& outputPrefix) {
+    std::string outputFile = "digi_out_" + type + "_hits.bin";
+    if (!outputPrefix.empty()) {
+        outputFile = outputPrefix + "_" + type + "_hits.bin";
+    }
+    
+    DigitizationBase* digitizer = findDigitizer(type);
+    if (!digitizer) {
+        return;
+    }
+    
+    applyChannelCalibration(digitizer);
+    applyRunReportFile(digitizer, outputFile);
+    digitizer->runHitFile(inputFile, outputFile);
+    digitizer->setChannelCalibration(nullptr);
+}
+
+void DigitizationManager::applyRunReportFile(DigitizationBase* digitizer, const std::string& outputFile) {
+    if (!runReportJSON) {
+        digitizer->setRunReportFile("");
+        return;
+    }
+    // 去掉扩展名：<prefix>_<type>.root -> <prefix>_<type>_report.json
+    const size_t dot = outputFile.find_last_of('.');
+    const size_t slash = outputFile.find_last_of('/');
+    const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    digitizer->setRunReportFile((hasExtension ? outputFile.substr(0, dot) : outputFile) + "_report.json");
+}
+
+void DigitizationManager::applyChannelCalibration(DigitizationBase* digitizer) {
+    if (calibration.empty()) {
+        return;
+    }
+    
+    // 刻度表的派生量按当前全局参数计算
+    calibration.build(DetectorParameters::getInstance().createSnapshot());
+    digitizer->setChannelCalibration(&calibration);
+}
+
+bool DigitizationManager::convertHitsToBinary(const HitInputOptions& input, const std::string& outputFile) {
+    HitReader reader(input);
+    if (!reader.open()) {
+        return false;
+    }
+    
+    std::ofstream out(outputFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "错误：无法创建输出文件 " << outputFile << std::endl;
+        return false;
+    }
+    
+    // 先写入记录数为 0 的文件头，写完记录后回填
+    const uint32_t flags = reader.hasTime() ? BinaryHitHeader::kHasTime : 0;
+    const size_t recordSize = BinaryHitFile::recordSize(BinaryHitFile::kHits, reader.hasTime());
+    BinaryHitHeader header = BinaryHitFile::makeHeader(BinaryHitFile::kHits, 0, flags);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    // 每批至少读入的击中数
+    const size_t batchHits = 65536;
+    HitBatch hits;
+    std::vector<char> buffer;
+    uint64_t nRecords = 0;
+    while (reader.next(hits, batchHits)) {
+        buffer.assign(hits.size() * recordSize, 0);
+        for (size_t i = 0; i < hits.size(); ++i) {
+            TimedHitRecord record = {};
+            record.event = hits.event[i];
+            record.channel = hits.channel[i];
+            record.edep = static_cast<float>(hits.edep[i]);
+            if (reader.hasTime()) record.time = static_cast<float>(hits.time[i]);
+            std::memcpy(&buffer[i * recordSize], &record, recordSize);
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        nRecords += hits.size();
+    }
+    
+    header.nRecords = nRecords;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out) {
+        std::cerr << "错误：写入 " << outputFile << " 失败" << std::endl;
+        return false;
+    }
+    std::cout << "已转换 " << nRecords << " 个击中到 " << outputFile << std::endl;
+    return true;
+}
+
+bool DigitizationManager::convertDigiToRoot(const std::string& inputFile, const std::string& outputFile) {
+    BinaryHitFile input;
+    if (!input.open(inputFile)) {
+        return false;
+    }
+    if (input.kind() != BinaryHitFile::kDigis) {
+        std::cerr << "错误：" << inputFile << " 不是数字化结果文件" << std::endl;
+        return false;
+    }
+    
+    const OutputOptions& options = outputOptions;
+    std::unique_ptr<TFile> file(TFile::Open(outputFile.c_str(), "RECREATE", "",
+                                            options.compressionSettings >= 0 ? options.compressionSettings
+                                                : ROOT::RCompressionSetting::EDefaults::kUseGeneralPurpose));
+    if (!file || file->IsZombie()) {
+        std::cerr << "无法创建输出文件: " << outputFile << std::endl;
+        return false;
+    }
+    file->cd();
+    
+    // 分支与击中模式的 digiHits 树相同；二进制记录的能量为单精度，这里按 compact 写出
+    const bool withADC = input.hasADC();
+    const bool withTime = input.hasTime();
+    TTree* hitTree = new TTree("digiHits", "Digitized Hits");
+    DigiRecord record;
+    hitTree->Branch("event", &record.event, "event/L");
+    hitTree->Branch("channel", &record.channel, "channel/I");
+    hitTree->Branch("edep", &record.edep, "edep/F");
+    hitTree->Branch("energy", &record.energy, "energy/F");
+    if (withADC) {
+        hitTree->Branch("adc", &record.adc, "adc/I");
+        hitTree->Branch("gain", &record.gain, "gain/I");
+    }
+    if (withTime) {
+        hitTree->Branch("time", &record.time, "time/F");
+    }
+    hitTree->SetAutoFlush(-options.autoFlushBytes);
+    hitTree->SetAutoSave(-options.autoFlushBytes);
+    
+    for (uint64_t i = 0; i < input.size(); ++i) {
+        record = input.digi(i);
+        hitTree->Fill();
+    }
+    hitTree->Write("", TObject::kOverwrite);
+    
+    TDirectory* paramDir = file->mkdir("Parameters");
+    if (paramDir) {
+        paramDir->cd();
+        TNamed* branchTypes = new TNamed("branchTypes", "compact");
+        branchTypes->Write();
+        TNamed* source = new TNamed("source", inputFile.c_str());
+        source->Write();
+    }
+    file->Close();
+    std::cout << "已转换 " << input.size() << " 个数字化击中到 " << outputFile << std::endl;
+    return true;
+}
+
+bool DigitizationManager::loadChannelCalibration(const std::string& filename) {
+    return calibration.load(filename);
 }
 
 void DigitizationManager::runAllDigitizers(const std::string& outputPrefix) {
@@ -204,9 +378,195 @@ void DigitizationManager::runAllDigitizers(const std::string& outputPrefix) {
     std::cout << "-o " << outputPrefix << "_comparison" << std::endl;
 }
 
+void DigitizationManager::runConvolution(const std::string& outputPrefix) {
+    // 单独的文件名，不覆盖同一前缀下蒙特卡罗 Total 运行的结果
+    std::string outputFile = "digi_out_Convolution.root";
+    if (!outputPrefix.empty()) {
+        outputFile = outputPrefix + "_Convolution.root";
+    }
+    
+    TotalDigitizer* total = obtain(totalDigitizer);
+    auto start = std::chrono::steady_clock::now();
+    total->runConvolution(nEvents);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "数值卷积完成 (" << elapsed << " s)" << std::endl;
+    
+    total->saveResults(outputFile);
+}
+
+bool DigitizationManager::buildResponseTable(const std::string& outputPrefix, double eMin,
+                                             double eMax, int nEnergies) {
+    std::string outputFile = "digi_out_ResponseTable.root";
+    if (!outputPrefix.empty()) {
+        outputFile = outputPrefix + "_ResponseTable.root";
+    }
+    
+    // 表和验证都由 Total 直接数字化；验证事件在随机数流中紧接生成表的事件，两者独立
+    auto& params = DetectorParameters::getInstance();
+    TotalDigitizer* total = obtain(totalDigitizer);
+    total->refreshParameters();
+    auto start = std::chrono::steady_clock::now();
+    ResponseTable table;
+    if (!table.build(*total, params, eMin, eMax, nEnergies, kResponseTableSamples)) {
+        return false;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "查找表生成用时 " << elapsed << " s" << std::endl;
+    if (!table.save(outputFile)) {
+        return false;
+    }
+    
+    // 验证：在网格范围内的每个配置能量点和增益档位切换能量附近（切换能量本身和两侧不在网格上的点），
+    // 比较直接数字化和查表抽样的 nEvents 个输出
+    std::vector<double> validationEnergies = params.getEnergyPoints();
+    for (double transition : table.transitionEnergies()) {
+        for (double factor : {0.99, 0.996, 1.0, 1.004, 1.01}) {
+            validationEnergies.push_back(transition * factor);
+        }
+    }
+    std::sort(validationEnergies.begin(), validationEnergies.end());
+    std::cout << "验证查找表 (每个能量点 " << nEvents << " 事件):" << std::endl;
+    PhiloxRandom rng(randomSeed, PhiloxRandom::streamIdFromName("ResponseTable"));
+    std::vector<ResponseTable::Comparison> results;
+    std::vector<double> inputs(nEvents), direct(nEvents), sampled(nEvents), uniforms(nEvents);
+    double directTime = 0.0, tableTime = 0.0;
+    for (double energy : validationEnergies) {
+        if (energy < table.minEnergy() || energy > table.maxEnergy()) {
+            std::cout << "能量点 " << energy << " MeV 在查找表范围外，跳过验证" << std::endl;
+            continue;
+        }
+        
+        std::fill(inputs.begin(), inputs.end(), energy);
+        auto t0 = std::chrono::steady_clock::now();
+        total->digitizeBatch(inputs.data(), direct.data(), inputs.size());
+        auto t1 = std::chrono::steady_clock::now();
+        rng.RndmArray(nEvents, uniforms.data());
+        for (int i = 0; i < nEvents; ++i) {
+            sampled[i] = table.sample(energy, uniforms[i]);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        directTime += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        tableTime += std::chrono::duration<double, std::nano>(t2 - t1).count();
+        
+        results.push_back(ResponseTable::compare(energy, direct, sampled));
+    }
+    if (results.empty()) return true;
+    
+    ResponseTable::printComparison(results);
+    const double hits = static_cast<double>(results.size()) * nEvents;
+    std::cout << "每个事件用时: 直接数字化 " << directTime / hits << " ns, 查表 " 
+              << tableTime / hits << " ns" << std::endl;
+    
+    // KS 距离的容许值：两组验证样本和生成表的样本在 99.9% 置信水平下的统计涨落，
+    // 加上能量和分位水平插值的误差
+    const double ksLimit = 1.95 * std::sqrt(2.0 / nEvents + 1.0 / kResponseTableSamples) + kResponseTableKSInterpolation;
+    bool passed = true;
+    for (const auto& r : results) {
+        if (r.ks > ksLimit) {
+            std::cerr << "警告：能量点 " << r.energy << " MeV 的 KS 距离 " << r.ks
+                      << " 超过容许值 " << ksLimit << std::endl;
+            passed = false;
+        }
+    }
+    std::cout << "查找表验证" << (passed ? "通过" : "未通过") << " (KS 容许值 " << ksLimit << ")" << std::endl;
+    
+    // 验证结果追加到查找表文件，[0] 为直接数字化，[1] 为查表
+    std::unique_ptr<TFile> file(TFile::Open(outputFile.c_str(), "UPDATE"));
+    if (!file || file->IsZombie()) {
+        std::cerr << "错误: 无法打开 " << outputFile << " 写入验证结果" << std::endl;
+        return false;
+    }
+    TTree* tree = new TTree("validation", "Response Table Validation");
+    ResponseTable::Comparison c;
+    tree->Branch("energy", &c.energy, "energy/D");
+    tree->Branch("mean", c.mean, "mean[2]/D");
+    tree->Branch("rms", c.rms, "rms[2]/D");
+    tree->Branch("zeroFraction", c.zeroFraction, "zeroFraction[2]/D");
+    tree->Branch("q01", c.q01, "q01[2]/D");
+    tree->Branch("q50", c.q50, "q50[2]/D");
+    tree->Branch("q99", c.q99, "q99[2]/D");
+    tree->Branch("ks", &c.ks, "ks/D");
+    double limit = ksLimit;
+    tree->Branch("ksLimit", &limit, "ksLimit/D");
+    for (const auto& r : results) {
+        c = r;
+        tree->Fill();
+    }
+    tree->Write();
+    file->Close();
+    return passed;
+}
+
+void DigitizationManager::runAnalytic(const std::string& outputPrefix) {
+    std::string outputFile = "digi_out_Analytic.root";
+    if (!outputPrefix.empty()) {
+        outputFile = outputPrefix + "_Analytic.root";
+    }
+    
+    // 逐级传播均值和方差
+    auto& params = DetectorParameters::getInstance();
+    auto start = std::chrono::steady_clock::now();
+    AnalyticModel model(params);
+    std::vector<AnalyticModel::Result> results = model.evaluate(params.getEnergyPoints());
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    
+    std::cout << "解析矩传播 (" << results.size() << " 个能量点, " << elapsed << " us):" << std::endl;
+    AnalyticModel::printTable(results);
+    
+    TFile* file = TFile::Open(outputFile.c_str(), "RECREATE");
+    if (!file || file->IsZombie()) {
+        std::cerr << "错误: 无法创建输出文件 " << outputFile << std::endl;
+        delete file;
+        return;
+    }
+    
+    // 每个能量点一个条目，各级方差以 var_<级名> 分支保存 (MeV^2)
+    TTree* tree = new TTree("analytic", "Analytic Moment Propagation");
+    AnalyticModel::Result r;
+    tree->Branch("energy", &r.energy, "energy/D");
+    tree->Branch("mean", &r.mean, "mean/D");
+    tree->Branch("sigma", &r.sigma, "sigma/D");
+    tree->Branch("resolution", &r.resolution, "resolution/D");
+    tree->Branch("linearity", &r.linearity, "linearity/D");
+    for (int s = 0; s < AnalyticModel::kNumStages; ++s) {
+        std::string name = std::string("var_") + AnalyticModel::stageName(s);
+        tree->Branch(name.c_str(), &r.stageVariance[s], (name + "/D").c_str());
+    }
+    tree->Branch("gainFraction", r.gainFraction, "gainFraction[3]/D");
+    
+    std::vector<double> energies, resolution, linearity;
+    for (const auto& result : results) {
+        r = result;
+        tree->Fill();
+        energies.push_back(result.energy);
+        resolution.push_back(result.resolution);
+        linearity.push_back(result.linearity);
+    }
+    tree->Write();
+    
+    if (!results.empty()) {
+        TGraph* g_Resolution = new TGraph(results.size(), energies.data(), resolution.data());
+        g_Resolution->SetName("g_Resolution");
+        g_Resolution->SetTitle("Analytic Energy Resolution;Energy [MeV];#sigma/<E_{rec}>");
+        g_Resolution->Write();
+        delete g_Resolution;
+        
+        TGraph* g_Linearity = new TGraph(results.size(), energies.data(), linearity.data());
+        g_Linearity->SetName("g_Linearity");
+        g_Linearity->SetTitle("Analytic Linearity;Energy [MeV];(<E_{rec}>-E)/E");
+        g_Linearity->Write();
+        delete g_Linearity;
+    }
+    
+    file->Close();
+    delete file;
+    std::cout << "解析结果保存到 " << outputFile << std::endl;
+}
+
 void DigitizationManager::scanParameter(const std::string& paramName, 
                                        const std::vector<double>& values,
-                                       const std::string& outputDir) {
+                                       const std::string& outputDir,
+                                       bool analytic) {
     // 创建输出目录
     std::filesystem::create_directories(outputDir);
     
@@ -246,6 +606,42 @@ void DigitizationManager::scanParameter(const std::string& paramName,
     
     energyTree->Write();
     
+    // 解析预扫描：每个参数值只做矩传播，结果写入同一文件，用于在运行蒙特卡罗前缩小扫描范围
+    if (analytic) {
+        TTree* analyticTree = new TTree("analyticScan", "Analytic Parameter Scan");
+        AnalyticModel::Result r;
+        analyticTree->Branch("paramValue", &paramValue, "paramValue/D");
+        analyticTree->Branch("energy", &r.energy, "energy/D");
+        analyticTree->Branch("mean", &r.mean, "mean/D");
+        analyticTree->Branch("sigma", &r.sigma, "sigma/D");
+        analyticTree->Branch("resolution", &r.resolution, "resolution/D");
+        analyticTree->Branch("linearity", &r.linearity, "linearity/D");
+        
+        for (double value : values) {
+            setParameter(paramName, value);
+            paramValue = value;
+            
+            AnalyticModel model(DetectorParameters::getInstance());
+            std::vector<AnalyticModel::Result> results = model.evaluate(energyPoints);
+            std::cout << "解析扫描 " << paramName << " = " << value << std::endl;
+            AnalyticModel::printTable(results);
+            
+            for (const auto& result : results) {
+                r = result;
+                analyticTree->Fill();
+            }
+        }
+        analyticTree->Write();
+        
+        scanFile->Close();
+        delete scanFile;
+        setParameter(paramName, originalValue);
+        
+        std::cout << "解析参数扫描完成。结果保存到 " << outputDir << "/scan_" << paramName 
+                  << ".root 的 analyticScan 树" << std::endl;
+        return;
+    }
+    
     // 为每个参数值运行所有数字化器
     for (double value : values) {
         std::cout << "扫描 " << paramName << " = " << value << std::endl;
@@ -275,18 +671,15 @@ void DigitizationManager::scanParameter(const std::string& paramName,
 
 // 添加启用均匀抽样的方法
 void DigitizationManager::enableUniformSampling(bool enable) {
-    scinDigitizer->setUniformSampling(enable);
-    sipmDigitizer->setUniformSampling(enable);
-    adcDigitizer->setUniformSampling(enable);
-    totalDigitizer->setUniformSampling(enable);
+    uniformSampling = enable;
+    forEachDigitizer([enable](DigitizationBase& d) { d.setUniformSampling(enable); });
 }
 
 // 添加设置抽样范围的方法
 void DigitizationManager::setSamplingRange(double minEnergy, double maxEnergy) {
-    scinDigitizer->setSamplingRange(minEnergy, maxEnergy);
-    sipmDigitizer->setSamplingRange(minEnergy, maxEnergy);
-    adcDigitizer->setSamplingRange(minEnergy, maxEnergy);
-    totalDigitizer->setSamplingRange(minEnergy, maxEnergy);
+    samplingMinEnergy = minEnergy;
+    samplingMaxEnergy = maxEnergy;
+    forEachDigitizer([=](DigitizationBase& d) { d.setSamplingRange(minEnergy, maxEnergy); });
 }
 
 // 更新所有数字化器的参数
@@ -315,4 +708,16 @@ void DigitizationManager::updateDigitizersParameters() {
     }
     
     std::cout << "已更新所有数字化器的参数" << std::endl;
-} 
\ No newline at end of file
+}
+
+bool DigitizationManager::checkCrosstalkSampler(int nTrials) {
+    ParameterSnapshot snapshot = DetectorParameters::getInstance().createSnapshot();
+    PhiloxRandom rng(randomSeed, PhiloxRandom::streamIdFromName("CrosstalkCheck"));
+    return CrosstalkSampler::compareWithReference(snapshot.borelCrosstalk, snapshot.meanDarkCount, 
+                                                  nTrials, rng);
+}
+
+bool DigitizationManager::checkCountingSamplers(int nDraws) {
+    PhiloxRandom rng(randomSeed, PhiloxRandom::streamIdFromName("SamplerCheck"));
+    return ::checkCountingSamplers(nDraws, rng);
+}
@@ -0,0 +1,304 @@
+#include "HitReader.h"
+#include <TBufferFile.h>
+#include <Bytes.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// 支持整篮读取的叶类型，前两种为浮点类型
+const char* const kBulkTypes[] = {
+    "Double_t", "Float_t", "Long64_t", "ULong64_t", "Int_t", "UInt_t", "Short_t", "UShort_t"
+};
+constexpr int kFloatingBulkTypes = 2;
+
+int bulkTypeIndex(const std::string& typeName) {
+    for (int t = 0; t < static_cast<int>(sizeof(kBulkTypes) / sizeof(kBulkTypes[0])); ++t) {
+        if (typeName == kBulkTypes[t]) return t;
+    }
+    return -1;
+}
+
+// 篮子中按大端序列化的 n 个 T 解码到 out
+template <class T, class Out>
+void decodeBasket(char* buffer, Out* out, Int_t n) {
+    for (Int_t k = 0; k < n; ++k) {
+        T x;
+        frombuf(buffer, &x);
+        out[k] = static_cast<Out>(x);
+    }
+}
+
+} // namespace
+
+bool HitInputOptions::parseBranches(const std::string& spec) {
+    std::vector<std::string> names;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        names.push_back(item);
+    }
+    if ((names.size() != 3 && names.size() != 4) || names[1].empty() || names[2].empty()) {
+        std::cerr << "错误：击中分支应为 event,channel,edep[,time]（事件号可为空）: " << spec << std::endl;
+        return false;
+    }
+    eventBranch = names[0];
+    channelBranch = names[1];
+    edepBranch = names[2];
+    timeBranch = names.size() == 4 ? names[3] : "";
+    return true;
+}
+
+bool HitReader::Column::bind(TTree* tree, const std::string& branchName) {
+    name = branchName;
+    branch = tree->GetBranch(branchName.c_str());
+    if (!branch) {
+        std::cerr << "错误：击中树中没有分支 " << branchName << std::endl;
+        return false;
+    }
+    tree->SetBranchStatus(branchName.c_str(), true);
+    tree->AddBranchToCache(branchName.c_str(), true);
+    
+    // std::vector 分支按元素类型绑定，其余按标量叶读取
+    const std::string className = branch->GetClassName();
+    if (className == "vector<double>") {
+        tree->SetBranchAddress(branchName.c_str(), &vecDouble);
+    } else if (className == "vector<float>") {
+        tree->SetBranchAddress(branchName.c_str(), &vecFloat);
+    } else if (className == "vector<int>") {
+        tree->SetBranchAddress(branchName.c_str(), &vecInt);
+    } else if (className == "vector<Long64_t>" || className == "vector<long>") {
+        tree->SetBranchAddress(branchName.c_str(), &vecLong64);
+    } else if (className.empty()) {
+        leaf = tree->GetLeaf(branchName.c_str());
+        if (!leaf) {
+            std::cerr << "错误：无法读取分支 " << branchName << " 的叶" << std::endl;
+            return false;
+        }
+        // 单个基本类型的标量叶可以整篮读取
+        if (leaf->GetLen() == 1 && !leaf->GetLeafCount() && branch->SupportsBulkRead()) {
+            bulkType = bulkTypeIndex(leaf->GetTypeName());
+            if (bulk()) buffer = std::make_unique<TBufferFile>(TBuffer::kWrite, 32 * 1024);
+        }
+    } else {
+        std::cerr << "错误：不支持的分支类型 " << className << " (" << branchName << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void HitReader::Column::release() {
+    delete vecDouble;
+    delete vecFloat;
+    delete vecInt;
+    delete vecLong64;
+    vecDouble = nullptr;
+    vecFloat = nullptr;
+    vecInt = nullptr;
+    vecLong64 = nullptr;
+    branch = nullptr;
+    leaf = nullptr;
+    bulkType = -1;
+    buffer.reset();
+    basketFirst = basketEnd = 0;
+    values.clear();
+    integers.clear();
+}
+
+size_t HitReader::Column::length() const {
+    if (vecDouble) return vecDouble->size();
+    if (vecFloat) return vecFloat->size();
+    if (vecInt) return vecInt->size();
+    if (vecLong64) return vecLong64->size();
+    return leaf ? static_cast<size_t>(leaf->GetLen()) : 0;
+}
+
+double HitReader::Column::value(size_t i) const {
+    if (vecDouble) return (*vecDouble)[i];
+    if (vecFloat) return (*vecFloat)[i];
+    if (vecInt) return (*vecInt)[i];
+    if (vecLong64) return static_cast<double>((*vecLong64)[i]);
+    return leaf->GetValue(static_cast<int>(i));
+}
+
+// 整数列（事件号、通道号）不经过 double，超过 2^53 的事件号不丢失精度
+Long64_t HitReader::Column::integer(size_t i) const {
+    if (vecLong64) return (*vecLong64)[i];
+    if (vecInt) return (*vecInt)[i];
+    if (vecDouble) return static_cast<Long64_t>((*vecDouble)[i]);
+    if (vecFloat) return static_cast<Long64_t>((*vecFloat)[i]);
+    return leaf->GetValueLong64(static_cast<int>(i));
+}
+
+bool HitReader::Column::integral() const {
+    return bulkType >= kFloatingBulkTypes;
+}
+
+bool HitReader::Column::readBasket(Long64_t entry) {
+    // GetEntriesSerialized 返回 entry 所在的整个篮子，entry 不是篮子的第一个条目时
+    // 解码出的值会与条目号错位（簇边界与篮子边界不一致时），此时放弃整篮读取
+    const Long64_t* basketEntries = branch->GetBasketEntry();
+    const Int_t nBaskets = branch->GetWriteBasket() + 1;
+    const Long64_t* basket = std::upper_bound(basketEntries, basketEntries + nBaskets, entry) - 1;
+    if (basket < basketEntries || *basket != entry) {
+        std::cerr << "警告：分支 " << name << " 的条目 " << entry << " 不在篮子起点" << std::endl;
+        return false;
+    }
+    
+    const Int_t n = branch->GetBulkRead().GetEntriesSerialized(entry, *buffer);
+    if (n <= 0) return false;
+    basketFirst = entry;
+    basketEnd = entry + n;
+    
+    char* data = buffer->GetCurrent();
+    if (integral()) {
+        integers.resize(n);
+        Long64_t* out = integers.data();
+        switch (bulkType) {
+            case 2: decodeBasket<Long64_t>(data, out, n); break;
+            case 3: decodeBasket<ULong64_t>(data, out, n); break;
+            case 4: decodeBasket<Int_t>(data, out, n); break;
+            case 5: decodeBasket<UInt_t>(data, out, n); break;
+            case 6: decodeBasket<Short_t>(data, out, n); break;
+            default: decodeBasket<UShort_t>(data, out, n); break;
+        }
+    } else {
+        values.resize(n);
+        if (bulkType == 0) {
+            decodeBasket<Double_t>(data, values.data(), n);
+        } else {
+            decodeBasket<Float_t>(data, values.data(), n);
+        }
+    }
+    return true;
+}
+
+HitReader::HitReader(const HitInputOptions& options) : options(options) {
+}
+
+HitReader::~HitReader() {
+    close();
+}
+
+bool HitReader::open() {
+    close();
+    file.reset(TFile::Open(options.fileName.c_str(), "READ"));
+    if (!file || file->IsZombie()) {
+        std::cerr << "错误：无法打开击中文件 " << options.fileName << std::endl;
+        file.reset();
+        return false;
+    }
+    tree = file->Get<TTree>(options.treeName.c_str());
+    if (!tree) {
+        std::cerr << "错误：" << options.fileName << " 中没有树 " << options.treeName << std::endl;
+        close();
+        return false;
+    }
+    
+    // 只读取输入分支，整簇的篮子通过缓存一次读入
+    tree->SetBranchStatus("*", false);
+    tree->SetCacheSize(kCacheSize);
+    hasEventColumn = !options.eventBranch.empty();
+    hasTimeColumn = !options.timeBranch.empty();
+    if ((hasEventColumn && !eventColumn.bind(tree, options.eventBranch)) ||
+        !channelColumn.bind(tree, options.channelBranch) ||
+        !edepColumn.bind(tree, options.edepBranch) ||
+        (hasTimeColumn && !timeColumn.bind(tree, options.timeBranch))) {
+        close();
+        return false;
+    }
+    bulkMode = options.bulkRead && channelColumn.bulk() && edepColumn.bulk() &&
+               (!hasEventColumn || eventColumn.bulk()) && (!hasTimeColumn || timeColumn.bulk());
+    
+    nEntries = tree->GetEntries();
+    nextEntry = 0;
+    clusterStarts.clear();
+    nextCluster = 0;
+    TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+    for (Long64_t start = clusters.Next(); start < nEntries; start = clusters.Next()) {
+        clusterStarts.push_back(start);
+    }
+    clusterStarts.push_back(nEntries);
+    
+    std::cout << "击中输入: " << options.fileName << ":" << options.treeName << ", "
+              << nEntries << " 个条目, " << clusterStarts.size() - 1 << " 个簇"
+              << (bulkMode ? ", 整篮读取" : "") << std::endl;
+    return true;
+}
+
+void HitReader::close() {
+    // 先关闭文件（删除树），再释放分支绑定的对象
+    tree = nullptr;
+    if (file) {
+        file->Close();
+        file.reset();
+    }
+    eventColumn.release();
+    channelColumn.release();
+    edepColumn.release();
+    timeColumn.release();
+}
+
+bool HitReader::next(HitBatch& batch, size_t minHits) {
+    batch.clear();
+    if (!tree || nextCluster + 1 >= clusterStarts.size()) return false;
+    
+    while (nextCluster + 1 < clusterStarts.size() && batch.size() < minHits) {
+        const Long64_t end = clusterStarts[++nextCluster];
+        Long64_t entry = nextEntry;
+        if (bulkMode) {
+            entry = readBulk(batch, entry, end);
+            if (entry < end) {
+                std::cerr << "警告：条目 " << entry << " 处整篮读取失败，改为逐条目读取" << std::endl;
+                bulkMode = false;
+            }
+        }
+        if (!bulkMode) readEntries(batch, entry, end);
+        nextEntry = end;
+    }
+    return true;
+}
+
+Long64_t HitReader::readBulk(HitBatch& batch, Long64_t first, Long64_t end) {
+    // 各分支的篮子边界不同，分别在读完当前篮子时读入下一个；
+    // 先定位到簇的起点，使 TTreeCache 按簇预读
+    tree->LoadTree(first);
+    Column* columns[4] = {&channelColumn, &edepColumn, hasEventColumn ? &eventColumn : nullptr,
+                          hasTimeColumn ? &timeColumn : nullptr};
+    for (Long64_t entry = first; entry < end; ++entry) {
+        for (Column* column : columns) {
+            if (column && entry >= column->basketEnd && !column->readBasket(entry)) return entry;
+        }
+        batch.event.push_back(hasEventColumn ? eventColumn.bulkInteger(entry) : entry);
+        batch.channel.push_back(static_cast<Int_t>(channelColumn.bulkInteger(entry)));
+        batch.edep.push_back(edepColumn.bulkValue(entry) * options.energyScale);
+        if (hasTimeColumn) batch.time.push_back(timeColumn.bulkValue(entry));
+    }
+    return end;
+}
+
+void HitReader::readEntries(HitBatch& batch, Long64_t first, Long64_t end) {
+    for (Long64_t entry = first; entry < end; ++entry) {
+        tree->LoadTree(entry);
+        if (hasEventColumn) eventColumn.branch->GetEntry(entry);
+        channelColumn.branch->GetEntry(entry);
+        edepColumn.branch->GetEntry(entry);
+        if (hasTimeColumn) timeColumn.branch->GetEntry(entry);
+        
+        const size_t n = edepColumn.length();
+        const size_t nEvent = hasEventColumn ? eventColumn.length() : 1;
+        if (channelColumn.length() != n || (nEvent != 1 && nEvent != n) ||
+            (hasTimeColumn && timeColumn.length() != n)) {
+            std::cerr << "警告：条目 " << entry << " 的击中分支长度不一致，已跳过" << std::endl;
+            continue;
+        }
+        
+        for (size_t i = 0; i < n; ++i) {
+            batch.event.push_back(hasEventColumn ? eventColumn.integer(nEvent == 1 ? 0 : i) : entry);
+            batch.channel.push_back(static_cast<Int_t>(channelColumn.integer(i)));
+            batch.edep.push_back(edepColumn.value(i) * options.energyScale);
+            if (hasTimeColumn) batch.time.push_back(timeColumn.value(i));
+        }
+    }
+}
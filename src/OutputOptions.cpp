@@ -0,0 +1,138 @@
+#include "OutputOptions.h"
+#include <Compression.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+const char* OutputOptions::levelName(Level level) {
+    switch (level) {
+        case kSummary:    return "summary";
+        case kHistograms: return "histograms";
+        case kFullTree:   return "full";
+        case kPrescaled:  return "prescaled";
+        case kFiltered:   return "filtered";
+    }
+    return "unknown";
+}
+
+bool OutputOptions::parseLevel(const std::string& name, Level& level) {
+    for (int i = kSummary; i <= kFiltered; ++i) {
+        if (name == levelName(static_cast<Level>(i))) {
+            level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    std::cerr << "警告: 未知的输出级别 '" << name 
+              << "'，可选值为 summary/histograms/full/prescaled/filtered" << std::endl;
+    return false;
+}
+
+bool OutputOptions::parseFilter(const std::string& spec) {
+    bool gain = false;
+    bool sigma = false;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item == "gain") {
+            gain = true;
+        } else if (item == "sigma") {
+            sigma = true;
+        } else {
+            std::cerr << "警告: 未知的筛选条件 '" << item << "'，可选值为 gain/sigma" << std::endl;
+            return false;
+        }
+    }
+    
+    filterGainTransition = gain;
+    if (!sigma) {
+        filterSigma = 0.0;
+    } else if (filterSigma <= 0) {
+        filterSigma = 3.0;
+    }
+    return true;
+}
+
+bool OutputOptions::parseCompression(const std::string& spec) {
+    std::string algorithm = spec;
+    int level = -1;
+    size_t colon = spec.find(':');
+    if (colon != std::string::npos) {
+        algorithm = spec.substr(0, colon);
+        
+        // 级别必须是整数，例如 "zstd:fast" 视为无效设置
+        const std::string levelText = spec.substr(colon + 1);
+        size_t parsed = 0;
+        try {
+            level = std::stoi(levelText, &parsed);
+        } catch (const std::exception&) {
+            parsed = 0;
+        }
+        if (levelText.empty() || parsed != levelText.size()) {
+            std::cerr << "警告: 无效的压缩级别 '" << levelText << "'，应为 1-9 的整数" << std::endl;
+            return false;
+        }
+    }
+    
+    // 各算法的默认级别
+    ROOT::RCompressionSetting::EAlgorithm::EValues value;
+    if (algorithm == "none") {
+        compressionSettings = 0;
+        compressionName = "none";
+        return true;
+    } else if (algorithm == "zlib") {
+        value = ROOT::RCompressionSetting::EAlgorithm::kZLIB;
+        if (level < 0) level = 1;
+    } else if (algorithm == "lzma") {
+        value = ROOT::RCompressionSetting::EAlgorithm::kLZMA;
+        if (level < 0) level = 8;
+    } else if (algorithm == "lz4") {
+        value = ROOT::RCompressionSetting::EAlgorithm::kLZ4;
+        if (level < 0) level = 4;
+    } else if (algorithm == "zstd") {
+        value = ROOT::RCompressionSetting::EAlgorithm::kZSTD;
+        if (level < 0) level = 5;
+    } else {
+        std::cerr << "警告: 未知的压缩算法 '" << algorithm 
+                  << "'，可选值为 none/zlib/lzma/lz4/zstd" << std::endl;
+        return false;
+    }
+    
+    // 超出范围的级别不截断到 1-9，否则 "zstd:15" 会以 zstd:9 静默运行
+    if (level < 1 || level > 9) {
+        std::cerr << "警告: 无效的压缩级别 " << level << "，应为 1-9 的整数" << std::endl;
+        return false;
+    }
+    compressionSettings = ROOT::CompressionSettings(value, level);
+    compressionName = algorithm + ":" + std::to_string(level);
+    return true;
+}
+
+void OutputOptions::parseBranchSelection(const std::string& spec) {
+    branchSelection.clear();
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) branchSelection.push_back(item);
+    }
+}
+
+bool OutputOptions::isBranchSelected(const std::string& name) const {
+    return branchSelection.empty() || 
+           std::find(branchSelection.begin(), branchSelection.end(), name) != branchSelection.end();
+}
+
+std::string OutputOptions::describe() const {
+    std::ostringstream os;
+    os << levelName(level);
+    if (level == kPrescaled) {
+        os << " (1/" << prescale << ")";
+    } else if (level == kFiltered) {
+        os << " (";
+        if (filterGainTransition) os << "gain";
+        if (filterGainTransition && filterSigma > 0) os << ",";
+        if (filterSigma > 0) os << "sigma>" << filterSigma;
+        os << ")";
+    }
+    return os.str();
+}
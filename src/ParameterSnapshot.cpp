@@ -0,0 +1,82 @@
+#include "ParameterSnapshot.h"
+#include <cmath>
+
+#define SNAPSHOT_FIELD(name) {#name, &ParameterSnapshot::name}
+
+const std::vector<std::pair<std::string, ParameterSnapshot::Field>>& ParameterSnapshot::fields() {
+    static const std::vector<std::pair<std::string, Field>> table = {
+        // 晶体参数
+        SNAPSHOT_FIELD(EcalMIPEnergy),
+        SNAPSHOT_FIELD(EcalCryMipLY),
+        SNAPSHOT_FIELD(EcalCryEffLY),
+        SNAPSHOT_FIELD(EcalCryIntLY),
+        SNAPSHOT_FIELD(EcalCryIntLYFlu),
+        SNAPSHOT_FIELD(EcalCryLOFlu),
+        SNAPSHOT_FIELD(EcalCryLYUn),
+        SNAPSHOT_FIELD(EcalCryAtt),
+        
+        // SiPM参数
+        SNAPSHOT_FIELD(EcalSiPMDigiVerbose),
+        SNAPSHOT_FIELD(EcalSiPMPDE),
+        SNAPSHOT_FIELD(EcalSiPMPDEFlu),
+        SNAPSHOT_FIELD(EcalSiPMDCR),
+        SNAPSHOT_FIELD(EcalSiPMCT),
+        SNAPSHOT_FIELD(EcalSiPMCTMode),
+        SNAPSHOT_FIELD(EcalSiPMNeuFluence),
+        SNAPSHOT_FIELD(EcalSiPMGainMean),
+        SNAPSHOT_FIELD(EcalSiPMGainSigma),
+        SNAPSHOT_FIELD(EcalSiPMGainMeanFlu),
+        SNAPSHOT_FIELD(EcalSiPMInvTolerance),
+        
+        // 触发参数
+        SNAPSHOT_FIELD(EcalTriggerThreshold),
+        SNAPSHOT_FIELD(EcalTimeInterval),
+        SNAPSHOT_FIELD(EcalRatioTimeInterval),
+        
+        // 电子学参数
+        SNAPSHOT_FIELD(EcalFEENoiseSigma),
+        SNAPSHOT_FIELD(EcalASICNoiseSigma),
+        SNAPSHOT_FIELD(EcalADCError),
+        SNAPSHOT_FIELD(EcalMIP_Thre),
+        SNAPSHOT_FIELD(ADCbit),
+        SNAPSHOT_FIELD(ADCSwitch),
+        SNAPSHOT_FIELD(NofGain),
+        SNAPSHOT_FIELD(Pedestal),
+        SNAPSHOT_FIELD(SiPMDigiVerbose),
+        SNAPSHOT_FIELD(TotalGain),
+        SNAPSHOT_FIELD(GainRatio_12),
+        SNAPSHOT_FIELD(GainRatio_23),
+    };
+    return table;
+}
+
+#undef SNAPSHOT_FIELD
+
+bool ParameterSnapshot::isKnownParameter(const std::string& name) {
+    for (const auto& field : fields()) {
+        if (field.first == name) return true;
+    }
+    return false;
+}
+
+void ParameterSnapshot::computeDerived() {
+    invPhotonNorm = 1.0 / (EcalCryIntLY * EcalCryAtt);
+    invPENorm = 1.0 / (EcalCryIntLY * EcalCryAtt * EcalSiPMPDE);
+    
+    meanDarkCount = EcalSiPMDCR * EcalTimeInterval;
+    darkPedestal = meanDarkCount * (1 + EcalSiPMCT);
+    borelCrosstalk = clampCrosstalk(EcalSiPMCT);
+    gainSigmaAbs = EcalSiPMGainMean * EcalSiPMGainSigma;
+    
+    adcMax = static_cast<int>(std::pow(2, static_cast<int>(ADCbit))) - 1;
+    
+    // 高、中、低三个增益档位
+    const double ratio[3] = {1.0, GainRatio_12, GainRatio_12 * GainRatio_23};
+    for (int g = 0; g < 3; ++g) {
+        rangeGain[g] = EcalSiPMGainMean / ratio[g];
+        rangeFEENoise[g] = EcalFEENoiseSigma / ratio[g];
+        rangeADCSigma[g] = std::sqrt(rangeFEENoise[g] * rangeFEENoise[g] + 
+                                     EcalASICNoiseSigma * EcalASICNoiseSigma);
+        rangePedestalMean[g] = Pedestal + darkPedestal * rangeGain[g];
+    }
+}
@@ -0,0 +1,265 @@
+#include "PhiloxRandom.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define PHILOX_AVX2_KERNEL 1
+#endif
+
+namespace {
+
+// Philox4x32 的乘数和密钥增量（Salmon et al., SC'11）
+const UInt_t kMul0 = 0xD2511F53;
+const UInt_t kMul1 = 0xCD9E8D57;
+const UInt_t kWeyl0 = 0x9E3779B9;
+const UInt_t kWeyl1 = 0xBB67AE85;
+const int kRounds = 10;
+
+inline void mulhilo(UInt_t a, UInt_t b, UInt_t& hi, UInt_t& lo) {
+    ULong64_t product = static_cast<ULong64_t>(a) * b;
+    hi = static_cast<UInt_t>(product >> 32);
+    lo = static_cast<UInt_t>(product);
+}
+
+// 正态分布的 128 层 ziggurat（Marsaglia & Tsang 2000），层号与取值用不同的 32 位整数
+const double kZigR = 3.442619855899;      // 底层右端
+const double kZigV = 9.91256303526217e-3; // 每层面积
+
+struct ZigguratTables {
+    UInt_t kn[128];   // |取值| 小于此值时直接落在矩形内
+    double wn[128];   // 整数取值 -> 坐标
+    double fn[128];   // 各层边界处的密度 exp(-x^2/2)
+    
+    ZigguratTables() {
+        const double m1 = 2147483648.0;
+        double dn = kZigR, tn = kZigR;
+        const double q = kZigV / std::exp(-0.5 * dn * dn);
+        kn[0] = static_cast<UInt_t>((dn / q) * m1);
+        kn[1] = 0;
+        wn[0] = q / m1;
+        wn[127] = dn / m1;
+        fn[0] = 1.0;
+        fn[127] = std::exp(-0.5 * dn * dn);
+        for (int i = 126; i >= 1; --i) {
+            dn = std::sqrt(-2.0 * std::log(kZigV / dn + std::exp(-0.5 * dn * dn)));
+            kn[i + 1] = static_cast<UInt_t>((dn / tn) * m1);
+            tn = dn;
+            fn[i] = std::exp(-0.5 * dn * dn);
+            wn[i] = dn / m1;
+        }
+    }
+};
+
+const ZigguratTables& zigguratTables() {
+    static const ZigguratTables tables;
+    return tables;
+}
+
+// 快速路径：取值 hz 落在第 iz 层的矩形内
+inline bool insideRectangle(const ZigguratTables& t, Int_t hz, UInt_t iz) {
+    const UInt_t magnitude = hz < 0 ? 0u - static_cast<UInt_t>(hz) : static_cast<UInt_t>(hz);
+    return magnitude < t.kn[iz];
+}
+
+// 并行生成的路数
+const size_t kLanes = 8;
+
+// 事件 event0..event0+7 各自流的首个块的前两个字
+void firstWordsScalar(UInt_t event0, UInt_t energySlot, UInt_t stage, const UInt_t key[2],
+                      UInt_t w0[kLanes], UInt_t w1[kLanes]) {
+    for (size_t l = 0; l < kLanes; ++l) {
+        const UInt_t ctr[4] = {0, event0 + static_cast<UInt_t>(l), energySlot, stage};
+        UInt_t out[4];
+        PhiloxRandom::philox(ctr, key, out);
+        w0[l] = out[0];
+        w1[l] = out[1];
+    }
+}
+
+#ifdef PHILOX_AVX2_KERNEL
+// 8 路 32 位乘法的高、低位：偶数路和奇数路分别做 32x32->64 乘法后拼回
+__attribute__((target("avx2")))
+inline void mulhilo8(__m256i a, __m256i m, __m256i& hi, __m256i& lo) {
+    const __m256i even = _mm256_mul_epu32(a, m);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+__attribute__((target("avx2")))
+void firstWordsAVX2(UInt_t event0, UInt_t energySlot, UInt_t stage, const UInt_t key[2],
+                    UInt_t w0[kLanes], UInt_t w1[kLanes]) {
+    const __m256i mul0 = _mm256_set1_epi32(static_cast<int>(kMul0));
+    const __m256i mul1 = _mm256_set1_epi32(static_cast<int>(kMul1));
+    __m256i c0 = _mm256_setzero_si256();
+    __m256i c1 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(event0)),
+                                  _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i c2 = _mm256_set1_epi32(static_cast<int>(energySlot));
+    __m256i c3 = _mm256_set1_epi32(static_cast<int>(stage));
+    UInt_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < kRounds; ++round) {
+        __m256i hi0, lo0, hi1, lo1;
+        mulhilo8(c0, mul0, hi0, lo0);
+        mulhilo8(c2, mul1, hi1, lo1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+        c1 = lo1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+        c3 = lo0;
+        k0 += kWeyl0;
+        k1 += kWeyl1;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(w0), c0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(w1), c1);
+}
+#endif
+
+using FirstWordsKernel = void (*)(UInt_t, UInt_t, UInt_t, const UInt_t*, UInt_t*, UInt_t*);
+
+// 按CPU选择一次内核
+FirstWordsKernel selectFirstWordsKernel() {
+#ifdef PHILOX_AVX2_KERNEL
+    if (__builtin_cpu_supports("avx2")) return firstWordsAVX2;
+#endif
+    return firstWordsScalar;
+}
+
+} // namespace
+
+PhiloxRandom::PhiloxRandom(UInt_t seed, UInt_t streamId)
+    : key{seed, streamId} {
+}
+
+void PhiloxRandom::SetSeed(ULong_t seed) {
+    key[0] = static_cast<UInt_t>(seed);
+    setStream(0, 0, 0);
+}
+
+void PhiloxRandom::setStreamId(UInt_t streamId) {
+    key[1] = streamId;
+    setStream(0, 0, 0);
+}
+
+UInt_t PhiloxRandom::streamIdFromName(const std::string& name) {
+    // FNV-1a 哈希
+    UInt_t hash = 2166136261u;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+void PhiloxRandom::setStream(UInt_t event, UInt_t energySlot, UInt_t stage) {
+    counter[0] = 0;
+    counter[1] = event;
+    counter[2] = energySlot;
+    counter[3] = stage;
+    bufferPos = 4;
+}
+
+void PhiloxRandom::skipTo(ULong64_t position) {
+    counter[0] = static_cast<UInt_t>(position / 4);
+    bufferPos = 4;
+    int offset = static_cast<int>(position % 4);
+    if (offset > 0) {
+        nextBlock(buffer);
+        bufferPos = offset;
+    }
+}
+
+void PhiloxRandom::philox(const UInt_t ctr[4], const UInt_t k[2], UInt_t out[4]) {
+    UInt_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    UInt_t k0 = k[0], k1 = k[1];
+    for (int round = 0; round < kRounds; ++round) {
+        UInt_t hi0, lo0, hi1, lo1;
+        mulhilo(kMul0, c0, hi0, lo0);
+        mulhilo(kMul1, c2, hi1, lo1);
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += kWeyl0;
+        k1 += kWeyl1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+void PhiloxRandom::nextBlock(UInt_t out[4]) {
+    philox(counter, key, out);
+    ++counter[0];
+}
+
+void PhiloxRandom::RndmArray(Int_t n, Double_t* array) {
+    Int_t i = 0;
+    // 先用完缓冲中剩余的数
+    while (i < n && bufferPos < 4) {
+        array[i++] = toUniform(buffer[bufferPos++]);
+    }
+    // 整块生成
+    UInt_t block[4];
+    for (; i + 4 <= n; i += 4) {
+        nextBlock(block);
+        array[i] = toUniform(block[0]);
+        array[i + 1] = toUniform(block[1]);
+        array[i + 2] = toUniform(block[2]);
+        array[i + 3] = toUniform(block[3]);
+    }
+    // 剩余部分
+    for (; i < n; ++i) {
+        array[i] = Rndm();
+    }
+}
+
+void PhiloxRandom::RndmArray(Int_t n, Float_t* array) {
+    for (Int_t i = 0; i < n; ++i) {
+        // 单精度下 (x+0.5)/2^32 可能舍入为 1，限制在开区间内
+        Float_t u = static_cast<Float_t>(Rndm());
+        array[i] = u < 1.0f ? u : 0.99999994f;
+    }
+}
+
+Double_t PhiloxRandom::normal() {
+    const ZigguratTables& t = zigguratTables();
+    for (;;) {
+        const Int_t hz = static_cast<Int_t>(nextWord());
+        const UInt_t iz = nextWord() & 127;
+        const double x = hz * t.wn[iz];
+        if (insideRectangle(t, hz, iz)) return x;
+        
+        // 底层：尾部 |x| > r 用指数分布拒绝抽样
+        if (iz == 0) {
+            double tail, y;
+            do {
+                tail = -std::log(Rndm()) / kZigR;
+                y = -std::log(Rndm());
+            } while (y + y < tail * tail);
+            return hz > 0 ? kZigR + tail : -kZigR - tail;
+        }
+        // 楔形区：按密度接受，否则重新抽取
+        if (t.fn[iz] + Rndm() * (t.fn[iz - 1] - t.fn[iz]) < std::exp(-0.5 * x * x)) return x;
+    }
+}
+
+void PhiloxRandom::fillNormals(UInt_t firstEvent, UInt_t energySlot, UInt_t stage, size_t n, Double_t* out) {
+    static const FirstWordsKernel firstWords = selectFirstWordsKernel();
+    const ZigguratTables& t = zigguratTables();
+    UInt_t w0[kLanes], w1[kLanes];
+    for (size_t base = 0; base < n; base += kLanes) {
+        const UInt_t event0 = firstEvent + static_cast<UInt_t>(base);
+        firstWords(event0, energySlot, stage, key, w0, w1);
+        const size_t lanes = std::min(kLanes, n - base);
+        for (size_t l = 0; l < lanes; ++l) {
+            const Int_t hz = static_cast<Int_t>(w0[l]);
+            const UInt_t iz = w1[l] & 127;
+            if (insideRectangle(t, hz, iz)) {
+                out[base + l] = hz * t.wn[iz];
+            } else {
+                setStream(event0 + static_cast<UInt_t>(l), energySlot, stage);
+                out[base + l] = normal();
+            }
+        }
+    }
+}
@@ -0,0 +1,456 @@
+#include "ResponseTable.h"
+#include "DigitizationBase.h"
+#include <TFile.h>
+#include <TTree.h>
+#include <TNamed.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+void ResponseTable::makeLevels(int nQuantiles) {
+    levels.resize(nQuantiles);
+    for (int j = 0; j < nQuantiles; ++j) {
+        levels[j] = 0.5 * (1.0 - std::cos(M_PI * j / (nQuantiles - 1)));
+    }
+    levels.front() = 0.0;
+    levels.back() = 1.0;
+}
+
+bool ResponseTable::build(DigitizationBase& digitizer, const DetectorParameters& params, double eMin,
+                          double eMax, int nEnergies, int nSamples, int nQuantiles) {
+    if (eMin <= 0 || eMax <= eMin || nEnergies < 2 || nQuantiles < 2 || nSamples < nQuantiles) {
+        std::cerr << "错误：无效的查找表网格 [" << eMin << ", " << eMax << "] MeV, "
+                  << nEnergies << " 个能量点, " << nQuantiles << " 个分位数, 每点 "
+                  << nSamples << " 个事件" << std::endl;
+        return false;
+    }
+    
+    // 输出能量格点：档位 g 的ADC整数值扣除基线后按增益换算；中增益档的上界取
+    // 高增益ADC切换到低增益档处对应的高增益档能量
+    const ParameterSnapshot par = params.createSnapshot();
+    std::copy_n(par.rangeGain, 3, latticeGain);
+    std::copy_n(par.rangePedestalMean, 3, latticePedestal);
+    latticeNorm = par.invPENorm;
+    latticeEdge[0] = (par.ADCSwitch - latticePedestal[0]) / latticeGain[0] * latticeNorm;
+    latticeEdge[1] = (std::ceil((par.ADCSwitch + 1) * par.GainRatio_12) - 0.5 - latticePedestal[0]) /
+                     latticeGain[0] * latticeNorm;
+    zeroThreshold = par.EcalMIP_Thre * par.EcalMIPEnergy;
+    
+    // 对数等间距网格，加上两个档位切换能量两侧的加密点；相距不到 0.05% 的点只保留一个
+    energies.clear();
+    const double logEMin = std::log(eMin);
+    const double logStep = (std::log(eMax) - logEMin) / (nEnergies - 1);
+    for (int k = 0; k < nEnergies; ++k) {
+        energies.push_back(std::exp(logEMin + k * logStep));
+    }
+    transitions.clear();
+    for (double edge : latticeEdge) {
+        const double transition = inputEnergyForOutput(digitizer, edge, eMin, eMax);
+        if (transition <= 0) continue;
+        transitions.push_back(transition);
+        for (double offset : kTransitionOffsets) {
+            for (double energy : {transition * (1 - offset), transition * (1 + offset)}) {
+                if (energy > eMin && energy < eMax) energies.push_back(energy);
+            }
+        }
+    }
+    std::sort(energies.begin(), energies.end());
+    energies.erase(std::unique(energies.begin(), energies.end(),
+                               [](double a, double b) { return b < a * 1.0005; }),
+                   energies.end());
+    logEnergies.resize(energies.size());
+    std::transform(energies.begin(), energies.end(), logEnergies.begin(), [](double e) { return std::log(e); });
+    
+    const int nPoints = energyCount();
+    makeLevels(nQuantiles);
+    nRanges = 3;
+    zeroFrac.assign(nPoints, 0.0f);
+    rangeFrac.assign(static_cast<size_t>(nPoints) * nRanges, 0.0f);
+    quantiles.assign(static_cast<size_t>(nPoints) * nRanges * nQuantiles, 0.0f);
+    
+    // 每个能量点直接数字化 nSamples 个事件，非零输出按所选增益档位分开，排序后取条件分位数；
+    // 切换能量附近两个档位的输出在切换点两侧交叠，只有分档位保存才能放回正确的格点
+    const size_t kChunk = 65536;
+    std::vector<double> inputs(kChunk), outputs(kChunk), modes(kChunk);
+    DigitizationBase::BatchIntermediates aux;
+    aux.gainMode = modes.data();
+    std::vector<double> nonZero[3];
+    for (int k = 0; k < nPoints; ++k) {
+        for (auto& values : nonZero) values.clear();
+        std::fill(inputs.begin(), inputs.end(), energies[k]);
+        for (int done = 0; done < nSamples; done += static_cast<int>(kChunk)) {
+            const size_t n = std::min<size_t>(kChunk, nSamples - done);
+            digitizer.digitizeBatch(inputs.data(), outputs.data(), n, &aux);
+            for (size_t i = 0; i < n; ++i) {
+                if (outputs[i] == 0.0) continue;
+                nonZero[std::clamp(static_cast<int>(modes[i]) - 1, 0, 2)].push_back(outputs[i]);
+            }
+        }
+        const size_t total = nonZero[0].size() + nonZero[1].size() + nonZero[2].size();
+        zeroFrac[k] = static_cast<float>(1.0 - static_cast<double>(total) / nSamples);
+        
+        for (int g = 0; g < nRanges; ++g) {
+            std::vector<double>& values = nonZero[g];
+            if (values.empty()) continue;
+            rangeFrac[static_cast<size_t>(k) * nRanges + g] = static_cast<float>(static_cast<double>(values.size()) / total);
+            std::sort(values.begin(), values.end());
+            float* row = &quantiles[(static_cast<size_t>(k) * nRanges + g) * nQuantiles];
+            const double last = static_cast<double>(values.size() - 1);
+            for (int j = 0; j < nQuantiles; ++j) {
+                const double h = levels[j] * last;
+                const size_t lo = static_cast<size_t>(h);
+                const size_t hi = std::min(lo + 1, values.size() - 1);
+                const double value = values[lo] + (h - lo) * (values[hi] - values[lo]);
+                row[j] = static_cast<float>(value / energies[k]);
+            }
+        }
+    }
+    
+    std::cout << "响应查找表: " << nPoints << " 个能量点 [" << eMin << ", " << eMax
+              << "] MeV（其中 " << nPoints - nEnergies << " 个为增益档位切换处的加密点）, 每点 "
+              << nQuantiles << " 个分位数, 由 " << nSamples << " 个直接数字化事件生成" << std::endl;
+    for (double transition : transitions) {
+        std::cout << "  增益档位切换能量 " << transition << " MeV" << std::endl;
+    }
+    return true;
+}
+
+double ResponseTable::inputEnergyForOutput(DigitizationBase& digitizer, double output,
+                                           double eMin, double eMax) {
+    // 平均输出能量随沉积能量单调增加，每次用 4000 个事件估计均值
+    const size_t kProbe = 4000;
+    std::vector<double> inputs(kProbe), outputs(kProbe);
+    auto meanOutput = [&](double energy) {
+        std::fill(inputs.begin(), inputs.end(), energy);
+        digitizer.digitizeBatch(inputs.data(), outputs.data(), kProbe);
+        double sum = 0.0;
+        for (double value : outputs) sum += value;
+        return sum / kProbe;
+    };
+    if (meanOutput(eMin) >= output || meanOutput(eMax) <= output) return 0.0;
+    
+    double lo = std::log(eMin);
+    double hi = std::log(eMax);
+    for (int iteration = 0; iteration < 40; ++iteration) {
+        const double mid = 0.5 * (lo + hi);
+        if (meanOutput(std::exp(mid)) < output) lo = mid;
+        else hi = mid;
+    }
+    return std::exp(0.5 * (lo + hi));
+}
+
+bool ResponseTable::save(const std::string& filename) const {
+    if (empty()) {
+        std::cerr << "错误：查找表为空，无法保存" << std::endl;
+        return false;
+    }
+    
+    std::unique_ptr<TFile> file(TFile::Open(filename.c_str(), "RECREATE"));
+    if (!file || file->IsZombie()) {
+        std::cerr << "错误: 无法创建输出文件 " << filename << std::endl;
+        return false;
+    }
+    
+    // 每个能量点一个条目，quantile 按档位依次存放 nRanges 行
+    TTree* tree = new TTree("responseTable", "Response Quantile Table");
+    double energy;
+    float zero;
+    int nQuantiles = quantileCount();
+    int ranges = nRanges;
+    int nValues = nRanges * nQuantiles;
+    std::vector<float> fraction(nRanges);
+    std::vector<float> row(nValues);
+    tree->Branch("energy", &energy, "energy/D");
+    tree->Branch("zeroFraction", &zero, "zeroFraction/F");
+    tree->Branch("nQuantiles", &nQuantiles, "nQuantiles/I");
+    tree->Branch("nRanges", &ranges, "nRanges/I");
+    tree->Branch("rangeFraction", fraction.data(), "rangeFraction[nRanges]/F");
+    tree->Branch("nValues", &nValues, "nValues/I");
+    tree->Branch("quantile", row.data(), "quantile[nValues]/F");
+    for (int k = 0; k < energyCount(); ++k) {
+        energy = energies[k];
+        zero = zeroFrac[k];
+        std::copy_n(&rangeFrac[static_cast<size_t>(k) * nRanges], nRanges, fraction.begin());
+        std::copy_n(&quantiles[static_cast<size_t>(k) * nValues], nValues, row.begin());
+        tree->Fill();
+    }
+    tree->Write();
+    
+    TNamed* scheme = new TNamed("levelScheme", "u_j = (1 - cos(pi*j/(nQuantiles-1)))/2; quantile[g*nQuantiles+j] = Q_g(u_j)/energy");
+    scheme->Write();
+    
+    // 输出能量格点，抽样时把插值结果放回格点
+    TTree* latticeTree = new TTree("outputLattice", "Output Energy Lattice");
+    double gain[3], pedestal[3], edge[2], norm = latticeNorm, threshold = zeroThreshold;
+    std::copy_n(latticeGain, 3, gain);
+    std::copy_n(latticePedestal, 3, pedestal);
+    std::copy_n(latticeEdge, 2, edge);
+    latticeTree->Branch("gain", gain, "gain[3]/D");
+    latticeTree->Branch("pedestal", pedestal, "pedestal[3]/D");
+    latticeTree->Branch("norm", &norm, "norm/D");
+    latticeTree->Branch("edge", edge, "edge[2]/D");
+    latticeTree->Branch("threshold", &threshold, "threshold/D");
+    latticeTree->Fill();
+    latticeTree->Write();
+    
+    // 生成查找表时的参数
+    TTree* paramTree = new TTree("parameters", "Digitization Parameters");
+    char name[100];
+    double value;
+    paramTree->Branch("name", name, "name[100]/C");
+    paramTree->Branch("value", &value, "value/D");
+    auto& params = DetectorParameters::getInstance();
+    for (const auto& param : params.getAllParameterNames()) {
+        strncpy(name, param.c_str(), 99);
+        name[99] = '\0';
+        value = params.getParameter(param);
+        paramTree->Fill();
+    }
+    paramTree->Write();
+    
+    file->Close();
+    std::cout << "查找表已保存到 " << filename << std::endl;
+    return true;
+}
+
+bool ResponseTable::load(const std::string& filename) {
+    std::unique_ptr<TFile> file(TFile::Open(filename.c_str(), "READ"));
+    if (!file || file->IsZombie()) {
+        std::cerr << "错误: 无法打开查找表文件 " << filename << std::endl;
+        return false;
+    }
+    TTree* tree = file->Get<TTree>("responseTable");
+    if (!tree || tree->GetEntries() < 2) {
+        std::cerr << "错误: " << filename << " 中没有有效的 responseTable 树" << std::endl;
+        return false;
+    }
+    
+    // 先读取分位数和档位个数，再按该长度读取每一行；没有 nRanges 的旧表每点只有一行
+    int nQuantiles = 0;
+    int ranges = 1;
+    const bool hasRanges = tree->GetBranch("nRanges") != nullptr;
+    tree->SetBranchAddress("nQuantiles", &nQuantiles);
+    if (hasRanges) tree->SetBranchAddress("nRanges", &ranges);
+    tree->GetEntry(0);
+    if (nQuantiles < 2 || (ranges != 1 && ranges != 3)) {
+        std::cerr << "错误: " << filename << " 中的分位数或档位个数无效" << std::endl;
+        return false;
+    }
+    
+    const int nEnergies = static_cast<int>(tree->GetEntries());
+    double energy;
+    float zero;
+    std::vector<float> fraction(ranges, 1.0f);
+    std::vector<float> row(static_cast<size_t>(ranges) * nQuantiles);
+    tree->SetBranchAddress("energy", &energy);
+    tree->SetBranchAddress("zeroFraction", &zero);
+    if (hasRanges) tree->SetBranchAddress("rangeFraction", fraction.data());
+    tree->SetBranchAddress("quantile", row.data());
+    
+    nRanges = ranges;
+    energies.resize(nEnergies);
+    zeroFrac.resize(nEnergies);
+    rangeFrac.resize(static_cast<size_t>(nEnergies) * nRanges);
+    quantiles.resize(static_cast<size_t>(nEnergies) * row.size());
+    for (int k = 0; k < nEnergies; ++k) {
+        tree->GetEntry(k);
+        energies[k] = energy;
+        zeroFrac[k] = zero;
+        std::copy(fraction.begin(), fraction.end(), &rangeFrac[static_cast<size_t>(k) * nRanges]);
+        std::copy(row.begin(), row.end(), &quantiles[static_cast<size_t>(k) * row.size()]);
+    }
+    makeLevels(nQuantiles);
+    logEnergies.resize(nEnergies);
+    std::transform(energies.begin(), energies.end(), logEnergies.begin(), [](double e) { return std::log(e); });
+    transitions.clear();
+    
+    // 没有格点信息的旧表输出连续值
+    latticeNorm = 0.0;
+    TTree* latticeTree = file->Get<TTree>("outputLattice");
+    if (latticeTree && latticeTree->GetEntries() > 0) {
+        latticeTree->SetBranchAddress("gain", latticeGain);
+        latticeTree->SetBranchAddress("pedestal", latticePedestal);
+        latticeTree->SetBranchAddress("norm", &latticeNorm);
+        latticeTree->SetBranchAddress("edge", latticeEdge);
+        latticeTree->SetBranchAddress("threshold", &zeroThreshold);
+        latticeTree->GetEntry(0);
+    } else {
+        std::cout << "注意: " << filename << " 中没有输出格点信息，查表输出为连续值" << std::endl;
+    }
+    
+    std::cout << "已读取查找表 " << filename << ": " << nEnergies << " 个能量点 ["
+              << minEnergy() << ", " << maxEnergy() << "] MeV, 每点 " << nQuantiles
+              << " 个分位数" << std::endl;
+    return true;
+}
+
+void ResponseTable::locate(double energy, int& k, double& w) const {
+    // 网格在切换能量附近加密，不再等间距，按对数能量二分查找所在区间
+    const int last = energyCount() - 2;
+    const double x = energy > 0 ? std::log(energy) : logEnergies.front();
+    k = static_cast<int>(std::upper_bound(logEnergies.begin(), logEnergies.end(), x) - logEnergies.begin()) - 1;
+    k = std::clamp(k, 0, last);
+    w = std::clamp((x - logEnergies[k]) / (logEnergies[k + 1] - logEnergies[k]), 0.0, 1.0);
+}
+
+double ResponseTable::relativeQuantile(int k, int range, double v) const {
+    // 由分位水平的余弦分布直接求出所在区间，区间内按 v 线性插值
+    const int n = quantileCount();
+    int j = static_cast<int>(std::acos(std::clamp(1.0 - 2.0 * v, -1.0, 1.0)) / M_PI * (n - 1));
+    j = std::clamp(j, 0, n - 2);
+    if (v < levels[j] && j > 0) --j;
+    else if (v > levels[j + 1] && j < n - 2) ++j;
+    const double a = std::clamp((v - levels[j]) / (levels[j + 1] - levels[j]), 0.0, 1.0);
+    const float* row = &quantiles[(static_cast<size_t>(k) * nRanges + range) * n];
+    return row[j] + a * (row[j + 1] - row[j]);
+}
+
+double ResponseTable::snapToLattice(double value, int range, double dither) const {
+    if (latticeNorm <= 0) return value;
+    const int g = range >= 0 ? range : (value <= latticeEdge[0] ? 0 : (value <= latticeEdge[1] ? 1 : 2));
+    const double gain = latticeGain[g];
+    const double pedestal = latticePedestal[g];
+    if (gain <= 0) return value;
+    
+    // 与 Total 链相同的表达式，格点上的输出与直接数字化逐位相同；非零输出不低于零压缩阈值
+    double adc = std::floor(value / latticeNorm * gain + pedestal + dither);
+    double snapped = (adc - pedestal) / gain * latticeNorm;
+    while (snapped < zeroThreshold) {
+        adc += 1;
+        snapped = (adc - pedestal) / gain * latticeNorm;
+    }
+    // 高增益档的ADC不超过切换阈值；中、低增益档的ADC重新抽取，没有这一上界
+    while (g == 0 && snapped > latticeEdge[0] && snapped - latticeNorm / gain >= zeroThreshold) {
+        adc -= 1;
+        snapped = (adc - pedestal) / gain * latticeNorm;
+    }
+    return snapped;
+}
+
+double ResponseTable::zeroFraction(double energy) const {
+    if (empty()) return 0.0;
+    int k;
+    double w;
+    locate(energy, k, w);
+    return (1.0 - w) * zeroFrac[k] + w * zeroFrac[k + 1];
+}
+
+double ResponseTable::sample(double energy, double u) const {
+    if (empty()) return 0.0;
+    int k;
+    double w;
+    locate(energy, k, w);
+    
+    const double zero = (1.0 - w) * zeroFrac[k] + w * zeroFrac[k + 1];
+    if (u < zero) return 0.0;
+    
+    // 非零部分：先按两侧能量点线性插值的档位比例选出档位，余下的部分为档位内的条件分位水平
+    double v = (u - zero) / (1.0 - zero);
+    int g = 0;
+    for (; g < nRanges - 1; ++g) {
+        const double fraction = (1.0 - w) * rangeFraction(k, g) + w * rangeFraction(k + 1, g);
+        if (v < fraction) {
+            v /= fraction;
+            break;
+        }
+        v -= fraction;
+    }
+    if (g == nRanges - 1) {
+        const double fraction = (1.0 - w) * rangeFraction(k, g) + w * rangeFraction(k + 1, g);
+        v = fraction > 0 ? std::min(v / fraction, 1.0) : 0.5;
+    }
+    
+    // 取格点时按到两侧格点的距离随机舍入，插值在两个相邻格点之间的输出按比例分配；
+    // 随机数取 frac(u*4096)，即 u 在 2^-12 以下的部分，与决定分位水平的高位近似独立
+    const double scaled = u * 4096.0;
+    const double dither = scaled - std::floor(scaled);
+    const int range = nRanges == 1 ? -1 : g;
+    
+    // 最近的三个能量点在同一条件分位水平处的相对分位数按对数能量做二次插值，
+    // 饱和区相对分位数随能量弯曲，线性插值的偏差可达分辨率的十分之一；
+    // 三个点中有该档位没有输出的点，或两段间距相差两倍以上（加密区的边缘，曲率由窄的一段
+    // 外推到宽的一段）时，退为两侧能量点的线性插值
+    auto present = [&](int point) { return rangeFraction(point, g) > 0; };
+    const int c = std::clamp(w > 0.5 ? k + 1 : k, 1, std::max(energyCount() - 2, 1));
+    const bool quadratic = energyCount() >= 3 && present(c - 1) && present(c) && present(c + 1) &&
+        [&] {
+            const double ratio = (logEnergies[c + 1] - logEnergies[c]) / (logEnergies[c] - logEnergies[c - 1]);
+            return ratio > 0.5 && ratio < 2.0;
+        }();
+    if (quadratic) {
+        // 三个点在对数能量上不一定等间距，用 Lagrange 基函数
+        const double x = logEnergies[k] + w * (logEnergies[k + 1] - logEnergies[k]);
+        const double x0 = logEnergies[c - 1], x1 = logEnergies[c], x2 = logEnergies[c + 1];
+        const double r = (x - x1) * (x - x2) / ((x0 - x1) * (x0 - x2)) * relativeQuantile(c - 1, g, v) +
+                         (x - x0) * (x - x2) / ((x1 - x0) * (x1 - x2)) * relativeQuantile(c, g, v) +
+                         (x - x0) * (x - x1) / ((x2 - x0) * (x2 - x1)) * relativeQuantile(c + 1, g, v);
+        return snapToLattice(r * energy, range, dither);
+    }
+    double r;
+    if (present(k) && present(k + 1)) {
+        r = (1.0 - w) * relativeQuantile(k, g, v) + w * relativeQuantile(k + 1, g, v);
+    } else {
+        r = relativeQuantile(present(k) ? k : k + 1, g, v);
+    }
+    return snapToLattice(r * energy, range, dither);
+}
+
+ResponseTable::Comparison ResponseTable::compare(double energy, std::vector<double>& direct,
+                                                 std::vector<double>& table) {
+    Comparison c;
+    c.energy = energy;
+    std::vector<double>* samples[2] = {&direct, &table};
+    for (int s = 0; s < 2; ++s) {
+        std::vector<double>& x = *samples[s];
+        if (x.empty()) continue;
+        std::sort(x.begin(), x.end());
+        
+        double sum = 0.0, sum2 = 0.0;
+        size_t zeros = 0;
+        for (double v : x) {
+            sum += v;
+            sum2 += v * v;
+            if (v == 0.0) ++zeros;
+        }
+        const double n = static_cast<double>(x.size());
+        c.mean[s] = sum / n;
+        c.rms[s] = std::sqrt(std::max(sum2 / n - c.mean[s] * c.mean[s], 0.0));
+        c.zeroFraction[s] = zeros / n;
+        auto quantile = [&](double q) { return x[std::min(static_cast<size_t>(q * n), x.size() - 1)]; };
+        c.q01[s] = quantile(0.01);
+        c.q50[s] = quantile(0.50);
+        c.q99[s] = quantile(0.99);
+    }
+    
+    // 两个经验分布函数之差的最大值
+    size_t i = 0, j = 0;
+    const double na = static_cast<double>(direct.size());
+    const double nb = static_cast<double>(table.size());
+    while (i < direct.size() && j < table.size()) {
+        const double x = std::min(direct[i], table[j]);
+        while (i < direct.size() && direct[i] <= x) ++i;
+        while (j < table.size() && table[j] <= x) ++j;
+        c.ks = std::max(c.ks, std::abs(i / na - j / nb));
+    }
+    return c;
+}
+
+void ResponseTable::printComparison(const std::vector<Comparison>& results) {
+    std::cout << std::setw(10) << "E [MeV]"
+              << std::setw(13) << "mean(MC)" << std::setw(13) << "mean(表)"
+              << std::setw(11) << "rms(MC)" << std::setw(11) << "rms(表)"
+              << std::setw(10) << "零(MC)" << std::setw(10) << "零(表)"
+              << std::setw(13) << "Q99(MC)" << std::setw(13) << "Q99(表)"
+              << std::setw(10) << "KS" << std::endl;
+    for (const auto& c : results) {
+        std::cout << std::setw(10) << c.energy
+                  << std::setw(13) << c.mean[0] << std::setw(13) << c.mean[1]
+                  << std::setw(11) << c.rms[0] << std::setw(11) << c.rms[1]
+                  << std::setw(10) << c.zeroFraction[0] << std::setw(10) << c.zeroFraction[1]
+                  << std::setw(13) << c.q99[0] << std::setw(13) << c.q99[1]
+                  << std::setw(10) << c.ks << std::endl;
+    }
+}
@@ -0,0 +1,192 @@
+#include "RunInstrumentation.h"
+#include <TDirectory.h>
+#include <TNamed.h>
+#include <TTree.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sys/resource.h>
+
+namespace {
+
+const char* timerNameOf(unsigned t) {
+    return RunInstrumentation::timerName(static_cast<RunTimer>(t));
+}
+
+const char* counterNameOf(unsigned c) {
+    return RunInstrumentation::counterName(static_cast<RunCounter>(c));
+}
+
+} // namespace
+
+void RunInstrumentation::merge(const RunInstrumentation& other) {
+    for (size_t t = 0; t < seconds.size(); ++t) seconds[t] += other.seconds[t];
+    for (size_t c = 0; c < counts.size(); ++c) counts[c] += other.counts[c];
+}
+
+void RunInstrumentation::apportionStageTimes() {
+    const double sampled = seconds[kTimerSamplingStages] + seconds[kTimerResponseStages]
+                         + seconds[kTimerOtherStages];
+    const double measured = seconds[kTimerDigitize] - seconds[kTimerNormals];
+    if (sampled <= 0 || measured <= 0) return;
+    const double scale = measured / sampled;
+    seconds[kTimerSamplingStages] *= scale;
+    seconds[kTimerResponseStages] *= scale;
+    seconds[kTimerOtherStages] *= scale;
+}
+
+const char* RunInstrumentation::timerName(RunTimer t) {
+    static const char* names[kTimerCount] = {
+        "digitize", "normals", "samplingStages", "responseStages", "otherStages",
+        "treeFill", "histogramFill"
+    };
+    return t < kTimerCount ? names[t] : "unknown";
+}
+
+const char* RunInstrumentation::counterName(RunCounter c) {
+    static const char* names[kCounterCount] = {
+        "gainRange1", "gainRange2", "gainRange3", "darkCounts", "crosstalkCounts",
+        "crosstalkIterations", "clampedPhotoelectrons", "clampedCharge", "clampedSignal",
+        "clampedADCLow", "clampedADCHigh", "zeroSuppressed"
+    };
+    return c < kCounterCount ? names[c] : "unknown";
+}
+
+double RunInstrumentation::clockOverhead() {
+    static const double overhead = [] {
+        auto best = std::chrono::steady_clock::duration::max();
+        for (int k = 0; k < 1000; ++k) {
+            const auto a = std::chrono::steady_clock::now();
+            const auto b = std::chrono::steady_clock::now();
+            best = std::min(best, b - a);
+        }
+        return std::chrono::duration<double>(best).count();
+    }();
+    return overhead;
+}
+
+double RunReport::peakRSS() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    // Linux 上 ru_maxrss 的单位为 kB
+    return usage.ru_maxrss / 1024.0;
+}
+
+void RunReport::print(std::ostream& os) const {
+    os << "运行报告 (" << digitizer << ", " << mode << "): " << events << " 事件, "
+       << wallSeconds << " s, " << eventsPerSecond() << " 事件/s, 峰值内存 "
+       << peakRSSMB << " MB" << std::endl;
+    if (inputSeconds > 0 && digitizeSeconds > 0) {
+        // 读取慢于数字化时输入是瓶颈
+        os << "  读取输入 " << inputSeconds << " s (" << inputRate() << " 击中/s), 数字化 "
+           << digitizeSeconds << " s (" << digitizeRate() << " 击中/s)" << std::endl;
+    }
+    if (!kInstrumentation) {
+        os << "  计时和计数器未编译 (DIGITIZATION_INSTRUMENTATION=0)" << std::endl;
+        return;
+    }
+    
+    // 各项时间为所有线程之和，百分比相对于 digitize、事件树和直方图填充之和
+    const double total = stats.seconds[kTimerDigitize] + stats.seconds[kTimerTreeFill]
+                       + stats.seconds[kTimerHistogramFill];
+    os << "  耗时 (各线程之和):" << std::endl;
+    for (unsigned t = 0; t < kTimerCount; ++t) {
+        const double s = stats.seconds[t];
+        os << "    " << std::setw(16) << std::left << timerNameOf(t) << std::right
+           << std::setw(10) << std::setprecision(4) << s << " s";
+        if (total > 0) os << "  " << std::setw(5) << std::setprecision(3) << 100 * s / total << "%";
+        if (events > 0) os << "  " << std::setprecision(4) << s / events * 1e9 << " ns/事件";
+        os << std::endl;
+    }
+    os << std::setprecision(6);
+    
+    os << "  计数:";
+    for (unsigned c = 0; c < kCounterCount; ++c) {
+        os << (c % 4 == 0 ? "\n    " : ", ") << counterNameOf(c) << " = " << stats.counts[c];
+    }
+    os << std::endl;
+}
+
+void RunReport::write(TDirectory* dir) const {
+    if (!dir) return;
+    TDirectory::TContext context(dir);
+    
+    TNamed* enabled = new TNamed("instrumentation", kInstrumentation ? "enabled" : "disabled");
+    enabled->Write();
+    
+    // 与 parameters 树相同的 (name, value) 结构
+    TTree* reportTree = new TTree("runReport", "Digitization Run Report");
+    char name[64];
+    double value;
+    reportTree->Branch("name", name, "name[64]/C");
+    reportTree->Branch("value", &value, "value/D");
+    auto fill = [&](const std::string& key, double v) {
+        strncpy(name, key.c_str(), sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        value = v;
+        reportTree->Fill();
+    };
+    
+    fill("threads", threads);
+    fill("events", static_cast<double>(events));
+    fill("wallSeconds", wallSeconds);
+    fill("eventsPerSecond", eventsPerSecond());
+    fill("peakRSSMB", peakRSSMB);
+    fill("inputSeconds", inputSeconds);
+    fill("digitizeSeconds", digitizeSeconds);
+    if (kInstrumentation) {
+        fill("stageProfileStride", kStageProfileStride);
+        for (unsigned t = 0; t < kTimerCount; ++t) {
+            fill(std::string("time_") + timerNameOf(t), stats.seconds[t]);
+        }
+        for (unsigned c = 0; c < kCounterCount; ++c) {
+            fill(std::string("count_") + counterNameOf(c), static_cast<double>(stats.counts[c]));
+        }
+    }
+    reportTree->Write();
+}
+
+bool RunReport::writeJSON(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "警告：无法写入运行报告 " << filename << std::endl;
+        return false;
+    }
+    
+    out << std::setprecision(10);
+    out << "{\n";
+    out << "  \"digitizer\": \"" << digitizer << "\",\n";
+    out << "  \"mode\": \"" << mode << "\",\n";
+    out << "  \"instrumentation\": " << (kInstrumentation ? "true" : "false") << ",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"events\": " << events << ",\n";
+    out << "  \"wall_seconds\": " << wallSeconds << ",\n";
+    out << "  \"events_per_s\": " << eventsPerSecond() << ",\n";
+    out << "  \"peak_rss_mb\": " << peakRSSMB << ",\n";
+    out << "  \"input_seconds\": " << inputSeconds << ",\n";
+    out << "  \"input_hits_per_s\": " << inputRate() << ",\n";
+    out << "  \"digitize_seconds\": " << digitizeSeconds << ",\n";
+    out << "  \"digitize_hits_per_s\": " << digitizeRate();
+    if (kInstrumentation) {
+        out << ",\n  \"stage_profile_stride\": " << kStageProfileStride << ",\n";
+        out << "  \"timers_seconds\": {";
+        for (unsigned t = 0; t < kTimerCount; ++t) {
+            out << (t ? ", " : "") << "\"" << timerNameOf(t) << "\": " << stats.seconds[t];
+        }
+        out << "},\n  \"counters\": {";
+        for (unsigned c = 0; c < kCounterCount; ++c) {
+            out << (c ? ", " : "") << "\"" << counterNameOf(c) << "\": " << stats.counts[c];
+        }
+        out << "}";
+    }
+    out << "\n}\n";
+    
+    if (!out) {
+        std::cerr << "警告：写入运行报告 " << filename << " 失败" << std::endl;
+        return false;
+    }
+    std::cout << "运行报告已写入 " << filename << std::endl;
+    return true;
+}
@@ -0,0 +1,74 @@
+#include "SiPMResponseInverse.h"
+#include <algorithm>
+#include <cmath>
+
+void SiPMResponseInverse::build(const std::function<double(double)>& response, 
+                                double xMin, double xMax, double tol) {
+    xs.clear();
+    ys.clear();
+    // 容差过小会使表过大，限制在 kMinTolerance 以上
+    tolerance = std::max(tol, kMinTolerance);
+    
+    int nDecades = static_cast<int>(std::ceil(std::log10(xMax / xMin)));
+    int nPoints = std::max(2, nDecades * kPointsPerDecade + 1);
+    double step = std::log(xMax / xMin) / (nPoints - 1);
+    
+    double x0 = xMin;
+    double y0 = response(x0);
+    xs.push_back(x0);
+    ys.push_back(y0);
+    
+    for (int i = 1; i < nPoints; ++i) {
+        double x1 = xMin * std::exp(step * i);
+        double y1 = response(x1);
+        refine(response, x0, y0, x1, y1, 0);
+        x0 = x1;
+        y0 = y1;
+    }
+    
+    // 截断到严格递增的部分，保证逆函数唯一
+    size_t n = 1;
+    while (n < ys.size() && std::isfinite(ys[n]) && ys[n] > ys[n - 1]) ++n;
+    xs.resize(n);
+    ys.resize(n);
+    
+    lowSlope = ys.front() / xs.front();
+}
+
+void SiPMResponseInverse::refine(const std::function<double(double)>& response,
+                                 double x0, double y0, double x1, double y1, int depth) {
+    double xm = 0.5 * (x0 + x1);
+    double ym = response(xm);
+    
+    // 非单调或非有限区间不再加密，建表结束时截断
+    if (!(y1 > y0) || !(ym > y0 && ym < y1)) {
+        xs.push_back(xm);
+        ys.push_back(ym);
+        xs.push_back(x1);
+        ys.push_back(y1);
+        return;
+    }
+    
+    // 线性插值逆函数在中点处的误差
+    double xInterp = x0 + (ym - y0) / (y1 - y0) * (x1 - x0);
+    bool converged = std::abs(xInterp - xm) <= tolerance * xm;
+    
+    if (converged || depth >= kMaxDepth) {
+        xs.push_back(x1);
+        ys.push_back(y1);
+        return;
+    }
+    
+    refine(response, x0, y0, xm, ym, depth + 1);
+    refine(response, xm, ym, x1, y1, depth + 1);
+}
+
+double SiPMResponseInverse::invert(double y) const {
+    if (y <= ys.front()) return y / lowSlope;
+    if (y >= ys.back()) return xs.back();
+    
+    // ys[i-1] <= y < ys[i]
+    size_t i = std::upper_bound(ys.begin(), ys.end(), y) - ys.begin();
+    double t = (y - ys[i - 1]) / (ys[i] - ys[i - 1]);
+    return xs[i - 1] + t * (xs[i] - xs[i - 1]);
+}
@@ -0,0 +1,307 @@
+#include "StreamingStats.h"
+#include <algorithm>
+#include <cmath>
+
+// ===== RunningMoments =====
+
+void RunningMoments::add(double x) {
+    ++n;
+    if (n == 1) {
+        xMin = xMax = x;
+    } else {
+        xMin = std::min(xMin, x);
+        xMax = std::max(xMax, x);
+    }
+    double delta = x - mu;
+    mu += delta / n;
+    m2 += delta * (x - mu);
+}
+
+void RunningMoments::merge(const RunningMoments& other) {
+    if (other.n == 0) return;
+    if (n == 0) {
+        *this = other;
+        return;
+    }
+
+    int64_t total = n + other.n;
+    double delta = other.mu - mu;
+    mu += delta * other.n / total;
+    m2 += other.m2 + delta * delta * (static_cast<double>(n) * other.n / total);
+    xMin = std::min(xMin, other.xMin);
+    xMax = std::max(xMax, other.xMax);
+    n = total;
+}
+
+double RunningMoments::rms() const {
+    return std::sqrt(variance());
+}
+
+// ===== QuantileSketch =====
+
+QuantileSketch::QuantileSketch(double relativeAccuracy)
+    : alpha(relativeAccuracy),
+      gamma((1 + relativeAccuracy) / (1 - relativeAccuracy)),
+      logGamma(std::log(gamma)) {
+}
+
+int QuantileSketch::keyOf(double x) const {
+    return static_cast<int>(std::ceil(std::log(x) / logGamma));
+}
+
+double QuantileSketch::valueOf(int key) const {
+    // 桶 (gamma^(k-1), gamma^k] 中相对误差最小的代表值
+    return 2.0 * std::pow(gamma, key) / (gamma + 1.0);
+}
+
+void QuantileSketch::Store::add(int key, int64_t count) {
+    if (counts.empty()) {
+        offset = key;
+        counts.assign(1, 0);
+    }
+
+    const int top = offset + static_cast<int>(counts.size()) - 1;
+    if (key < offset || key > top) {
+        // 扩展键范围，超过 kMaxBuckets 时把最低的桶合并到新的最低桶
+        int newLow = std::min(offset, key);
+        int newHigh = std::max(top, key);
+        if (newHigh - newLow + 1 > kMaxBuckets) {
+            newLow = newHigh - kMaxBuckets + 1;
+        }
+
+        std::vector<int64_t> resized(newHigh - newLow + 1, 0);
+        for (size_t i = 0; i < counts.size(); ++i) {
+            int k = std::max(offset + static_cast<int>(i), newLow);
+            resized[k - newLow] += counts[i];
+        }
+        counts.swap(resized);
+        offset = newLow;
+    }
+
+    counts[std::max(key, offset) - offset] += count;
+}
+
+void QuantileSketch::Store::merge(const Store& other) {
+    if (other.counts.empty()) return;
+
+    // 先一次性扩展到对方的键范围
+    add(other.offset, 0);
+    add(other.offset + static_cast<int>(other.counts.size()) - 1, 0);
+    for (size_t i = 0; i < other.counts.size(); ++i) {
+        if (other.counts[i] > 0) {
+            add(other.offset + static_cast<int>(i), other.counts[i]);
+        }
+    }
+}
+
+void QuantileSketch::add(double x) {
+    if (!std::isfinite(x)) return;
+
+    if (x > 0) {
+        positive.add(keyOf(x), 1);
+    } else if (x < 0) {
+        negative.add(keyOf(-x), 1);
+    } else {
+        ++zeroCount;
+    }
+    ++total;
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    positive.merge(other.positive);
+    negative.merge(other.negative);
+    zeroCount += other.zeroCount;
+    total += other.total;
+}
+
+void QuantileSketch::clear() {
+    positive = Store();
+    negative = Store();
+    zeroCount = 0;
+    total = 0;
+}
+
+std::vector<QuantileSketch::Bin> QuantileSketch::sortedBins() const {
+    std::vector<Bin> bins;
+    for (size_t i = negative.counts.size(); i-- > 0;) {
+        if (negative.counts[i] > 0) {
+            int key = negative.offset + static_cast<int>(i);
+            bins.push_back({-std::pow(gamma, key), -std::pow(gamma, key - 1),
+                            -valueOf(key), negative.counts[i]});
+        }
+    }
+    if (zeroCount > 0) {
+        bins.push_back({0.0, 0.0, 0.0, zeroCount});
+    }
+    for (size_t i = 0; i < positive.counts.size(); ++i) {
+        if (positive.counts[i] > 0) {
+            int key = positive.offset + static_cast<int>(i);
+            bins.push_back({std::pow(gamma, key - 1), std::pow(gamma, key),
+                            valueOf(key), positive.counts[i]});
+        }
+    }
+    return bins;
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (total == 0) return 0.0;
+
+    q = std::min(std::max(q, 0.0), 1.0);
+    const double rank = q * (total - 1);
+    int64_t cumulative = 0;
+    std::vector<Bin> bins = sortedBins();
+    for (const auto& bin : bins) {
+        cumulative += bin.count;
+        if (cumulative > rank) return bin.value;
+    }
+    return bins.back().value;
+}
+
+double QuantileSketch::shortestHalfWidth(double fraction) const {
+    if (total == 0) return 0.0;
+
+    const int64_t needed = static_cast<int64_t>(std::ceil(fraction * total));
+    std::vector<Bin> bins = sortedBins();
+
+    // 双指针：对每个起点找到满足计数的最近终点
+    double best = bins.back().value - bins.front().value;
+    int64_t windowCount = 0;
+    size_t end = 0;
+    for (size_t begin = 0; begin < bins.size(); ++begin) {
+        while (end < bins.size() && windowCount < needed) {
+            windowCount += bins[end++].count;
+        }
+        if (windowCount < needed) break;
+        best = std::min(best, bins[end - 1].value - bins[begin].value);
+        windowCount -= bins[begin].count;
+    }
+    return 0.5 * best;
+}
+
+double QuantileSketch::fwhm(int nBins) const {
+    if (total == 0 || nBins < 3) return 0.0;
+
+    const double lo = quantile(0.005);
+    const double hi = quantile(0.995);
+    if (hi <= lo) return 0.0;
+    const double width = (hi - lo) / nBins;
+
+    // 按重叠长度把每个桶的计数分配到等宽箱中，避免桶宽与箱宽不匹配造成的锯齿
+    std::vector<double> hist(nBins, 0.0);
+    for (const auto& bin : sortedBins()) {
+        if (bin.upper <= lo || bin.lower >= hi) continue;
+        if (bin.upper <= bin.lower) {
+            int i = std::min(static_cast<int>((bin.value - lo) / width), nBins - 1);
+            hist[i] += bin.count;
+            continue;
+        }
+        const double density = bin.count / (bin.upper - bin.lower);
+        int first = std::max(static_cast<int>((bin.lower - lo) / width), 0);
+        int last = std::min(static_cast<int>((bin.upper - lo) / width), nBins - 1);
+        for (int i = first; i <= last; ++i) {
+            double overlap = std::min(bin.upper, lo + (i + 1) * width) -
+                             std::max(bin.lower, lo + i * width);
+            if (overlap > 0) hist[i] += density * overlap;
+        }
+    }
+
+    const int peak = static_cast<int>(std::max_element(hist.begin(), hist.end()) - hist.begin());
+    const double half = 0.5 * hist[peak];
+
+    // 在箱中心之间线性插值求半高位置
+    auto center = [&](int i) { return lo + (i + 0.5) * width; };
+    double left = lo;
+    for (int i = peak; i > 0; --i) {
+        if (hist[i - 1] < half) {
+            left = center(i - 1) + (half - hist[i - 1]) / (hist[i] - hist[i - 1]) * width;
+            break;
+        }
+    }
+    double right = hi;
+    for (int i = peak; i < nBins - 1; ++i) {
+        if (hist[i + 1] < half) {
+            right = center(i) + (hist[i] - half) / (hist[i] - hist[i + 1]) * width;
+            break;
+        }
+    }
+    return right - left;
+}
+
+double QuantileSketch::truncatedRMS(double lower, double upper) const {
+    if (total == 0) return 0.0;
+
+    const double rankLow = lower * total;
+    const double rankHigh = upper * total;
+    double sumW = 0.0;
+    double sumX = 0.0;
+    double sumX2 = 0.0;
+    double cumulative = 0.0;
+    for (const auto& bin : sortedBins()) {
+        // 桶与 [rankLow, rankHigh) 的重叠计数
+        double w = std::min(cumulative + bin.count, rankHigh) - std::max(cumulative, rankLow);
+        cumulative += bin.count;
+        if (w <= 0) continue;
+        sumW += w;
+        sumX += w * bin.value;
+        sumX2 += w * bin.value * bin.value;
+    }
+    if (sumW <= 0) return 0.0;
+
+    double mean = sumX / sumW;
+    return std::sqrt(std::max(sumX2 / sumW - mean * mean, 0.0));
+}
+
+// ===== EnergyPointStats =====
+
+void EnergyPointStats::fill(const double* values, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        double x = values[i];
+        moments.add(x);
+        sketch.add(x);
+        if (x < rangeMin) ++underflow;
+        else if (x >= rangeMax) ++overflow;
+    }
+}
+
+void EnergyPointStats::merge(const EnergyPointStats& other) {
+    moments.merge(other.moments);
+    sketch.merge(other.sketch);
+    underflow += other.underflow;
+    overflow += other.overflow;
+}
+
+void EnergyPointStats::clear() {
+    moments.clear();
+    sketch.clear();
+    underflow = 0;
+    overflow = 0;
+}
+
+// ===== ResponseSummary =====
+
+ResponseSummary ResponseSummary::compute(double energy, const EnergyPointStats& stats) {
+    ResponseSummary s;
+    s.energy = energy;
+    s.entries = stats.moments.count();
+    if (s.entries == 0) return s;
+
+    const double n = static_cast<double>(s.entries);
+    s.mean = stats.moments.mean();
+    s.rms = stats.moments.rms();
+    s.meanError = s.rms / std::sqrt(n);
+    s.sigmaEff = stats.sketch.shortestHalfWidth(0.6827);
+    s.fwhm = stats.sketch.fwhm();
+    s.truncatedRMS = stats.sketch.truncatedRMS(0.05, 0.95);
+    s.underflowFraction = stats.underflow / n;
+    s.overflowFraction = stats.overflow / n;
+
+    if (s.mean > 0) {
+        // 正态近似下 sigma/mean 的统计误差
+        s.resolution = s.rms / s.mean;
+        s.resolutionError = s.resolution * std::sqrt(1.0 / (2.0 * n) + s.resolution * s.resolution / n);
+    }
+    if (energy > 0) {
+        s.linearity = (s.mean - energy) / energy;
+    }
+    return s;
+}
@@ -1,276 +1,95 @@
 #include "TotalDigitizer.h"
+#include "ConvolutionModel.h"
 #include <iostream>
 #include <TCanvas.h>
 
 TotalDigitizer::TotalDigitizer() 
     : DigitizationBase("Total") {
+    // 事件树分支：计数和ADC码为整数，能量和光电子数为单精度
+    declareBranch("inputEnergy", &inputEnergy, BranchStorage::kFloat);
+    declareBranch("phScin", &phScin, BranchStorage::kInt);
+    declareBranch("phScinAtt", &phScinAtt, BranchStorage::kInt);
+    declareBranch("phScinAttLYRand", &phScinAttLYRand, BranchStorage::kInt);
+    declareBranch("peSiPM", &peSiPM, BranchStorage::kInt);
+    declareBranch("peSiPMSat", &peSiPMSat, BranchStorage::kFloat);
+    declareBranch("dc", &dc, BranchStorage::kInt);
+    declareBranch("dcCT", &dcCT, BranchStorage::kInt);
+    declareBranch("peSiPMSatDark", &peSiPMSatDark, BranchStorage::kFloat);
+    declareBranch("peSiPMSatDarkGainFlu", &peSiPMSatDarkGainFlu, BranchStorage::kFloat);
+    declareBranch("peSiPMSatDarkGainFluPedSub", &peSiPMSatDarkGainFluPedSub, BranchStorage::kFloat);
+    declareBranch("peSiPMSatDarkGainFluPedSubCut", &peSiPMSatDarkGainFluPedSubCut, BranchStorage::kFloat);
+    declareBranch("adcInitial", &adcInitial, BranchStorage::kInt);
+    declareBranch("adcGainCorr", &adcGainCorr, BranchStorage::kFloat);
+    declareBranch("gainMode", &gainMode, BranchStorage::kShort);
+    declareBranch("gain", &gain, BranchStorage::kFloat);
+    declareBranch("noiseFEE", &noiseFEE, BranchStorage::kFloat);
+    declareBranch("noiseASIC", &noiseASIC, BranchStorage::kFloat);
+    declareBranch("pedMean", &pedMean, BranchStorage::kFloat);
+    declareBranch("outputEnergy", &outputEnergy, BranchStorage::kFloat);
+}
+
+std::unique_ptr<DigitizationBase> TotalDigitizer::createWorker() const {
+    return std::make_unique<TotalDigitizer>();
 }
 
 void TotalDigitizer::initializeTree() {
     // 创建Tree
     dataTree = std::make_unique<TTree>("totalEvents", "Total Digitization Chain Events");
     
-    // 添加分支
-    dataTree->Branch("inputEnergy", &inputEnergy, "inputEnergy/D");
-    dataTree->Branch("phScin", &phScin, "phScin/D");
-    dataTree->Branch("phScinAtt", &phScinAtt, "phScinAtt/D");
-    dataTree->Branch("phScinAttLYRand", &phScinAttLYRand, "phScinAttLYRand/D");
-    dataTree->Branch("peSiPM", &peSiPM, "peSiPM/D");
-    dataTree->Branch("peSiPMSat", &peSiPMSat, "peSiPMSat/D");
-    dataTree->Branch("dc", &dc, "dc/D");
-    dataTree->Branch("dcCT", &dcCT, "dcCT/D");
-    dataTree->Branch("peSiPMSatDark", &peSiPMSatDark, "peSiPMSatDark/D");
-    dataTree->Branch("peSiPMSatDarkGainFlu", &peSiPMSatDarkGainFlu, "peSiPMSatDarkGainFlu/D");
-    dataTree->Branch("peSiPMSatDarkGainFluPedSub", &peSiPMSatDarkGainFluPedSub, "peSiPMSatDarkGainFluPedSub/D");
-    dataTree->Branch("peSiPMSatDarkGainFluPedSubCut", &peSiPMSatDarkGainFluPedSubCut, "peSiPMSatDarkGainFluPedSubCut/D");
-    dataTree->Branch("adcInitial", &adcInitial, "adcInitial/D");
-    dataTree->Branch("adcGainCorr", &adcGainCorr, "adcGainCorr/D");
-    dataTree->Branch("gainMode", &gainMode, "gainMode/D");
-    dataTree->Branch("gain", &gain, "gain/D");
-    dataTree->Branch("noiseFEE", &noiseFEE, "noiseFEE/D");
-    dataTree->Branch("noiseASIC", &noiseASIC, "noiseASIC/D");
-    dataTree->Branch("pedMean", &pedMean, "pedMean/D");
-    dataTree->Branch("outputEnergy", &outputEnergy, "outputEnergy/D");
+    // 按输出选项创建已声明的分支
+    createBranches(dataTree.get());
 }
 
 void TotalDigitizer::initializeSamplingTree() {
     // 创建均匀抽样树
     samplingTree = std::make_unique<TTree>("totalSampling", "Total Uniform Sampling Events");
     
-    // 添加分支 - 与常规树相同的分支
-    samplingTree->Branch("inputEnergy", &inputEnergy, "inputEnergy/D");
-    samplingTree->Branch("phScin", &phScin, "phScin/D");
-    samplingTree->Branch("phScinAtt", &phScinAtt, "phScinAtt/D");
-    samplingTree->Branch("phScinAttLYRand", &phScinAttLYRand, "phScinAttLYRand/D");
-    samplingTree->Branch("peSiPM", &peSiPM, "peSiPM/D");
-    samplingTree->Branch("peSiPMSat", &peSiPMSat, "peSiPMSat/D");
-    samplingTree->Branch("dc", &dc, "dc/D");
-    samplingTree->Branch("dcCT", &dcCT, "dcCT/D");
-    samplingTree->Branch("peSiPMSatDark", &peSiPMSatDark, "peSiPMSatDark/D");
-    samplingTree->Branch("peSiPMSatDarkGainFlu", &peSiPMSatDarkGainFlu, "peSiPMSatDarkGainFlu/D");
-    samplingTree->Branch("peSiPMSatDarkGainFluPedSub", &peSiPMSatDarkGainFluPedSub, "peSiPMSatDarkGainFluPedSub/D");
-    samplingTree->Branch("peSiPMSatDarkGainFluPedSubCut", &peSiPMSatDarkGainFluPedSubCut, "peSiPMSatDarkGainFluPedSubCut/D");
-    samplingTree->Branch("adcInitial", &adcInitial, "adcInitial/D");
-    samplingTree->Branch("adcGainCorr", &adcGainCorr, "adcGainCorr/D");
-    samplingTree->Branch("gainMode", &gainMode, "gainMode/D");
-    samplingTree->Branch("gain", &gain, "gain/D");
-    samplingTree->Branch("noiseFEE", &noiseFEE, "noiseFEE/D");
-    samplingTree->Branch("noiseASIC", &noiseASIC, "noiseASIC/D");
-    samplingTree->Branch("pedMean", &pedMean, "pedMean/D");
-    samplingTree->Branch("outputEnergy", &outputEnergy, "outputEnergy/D");
+    // 与常规树相同的分支
+    createBranches(samplingTree.get());
 }
 
 double TotalDigitizer::digitize(double energy) {
-    // 记录输入能量
-    inputEnergy = energy;
-    
-    // 闪烁体数字化
-    double MIPEnergy = params.getParameter("EcalMIPEnergy");
-    double LY = params.getParameter("EcalCryIntLY");
-    double Att = params.getParameter("EcalCryAtt");
-    double LYRandFactor = rand.Gaus(1.0, params.getParameter("EcalCryLYUn"));
-    
-    int ScinGen = 0;
-    if(params.getParameter("EcalCryLOFlu") == 0.0) {
-        ScinGen = std::round(rand.Poisson(energy * LY));
-    } else {
-        ScinGen = std::round(rand.Gaus(energy * LY, energy * LY * params.getParameter("EcalCryLOFlu")));
-    }
-    phScin = ScinGen;
-
-    int ScinGenAtt = 0;
-    if(ScinGen < 100)
-    {
-        ScinGenAtt = std::round(rand.Binomial(ScinGen, Att));
-    }
-    else{
-        if(ScinGen * Att < 20)
-        {
-            ScinGenAtt = std::round(rand.Poisson(ScinGen * Att));
-        }
-        else{
-            ScinGenAtt = std::round(rand.Gaus(ScinGen * Att, sqrt(ScinGen * Att * (1 - Att))));
-        }
-    }
-    phScinAtt = ScinGenAtt;
-    double nPhotons = std::round(ScinGenAtt * LYRandFactor);
-    if (nPhotons < 0) nPhotons = 0;
-    phScinAttLYRand = nPhotons;
-    
-    // SiPM数字化
-    double SiPMPDE = params.getParameter("EcalSiPMPDE");
-    double SiPMCT = params.getParameter("EcalSiPMCT");
-    double darkRate = params.getParameter("EcalSiPMDCR");
-    double gateTime = params.getParameter("EcalTimeInterval");
-    double SiPMGainMean = params.getParameter("EcalSiPMGainMean");
-    double SiPMGainSigma = params.getParameter("EcalSiPMGainSigma");
+    double output = 0.0;
+    digitizeBatch(&energy, &output, 1);
+    return output;
+}
 
-    TF1* f_SiPMResponse = params.getSiPMResponseFunction();
-    TF1* f_SiPMSigmaDet = params.getSiPMSigmaDetFunction();
-    TF1* f_SiPMSigmaRecp = params.getSiPMSigmaRecpFunction();
-    TF1* f_SiPMSigmaRecm = params.getSiPMSigmaRecmFunction();
-    TF1* f_AsymGauss = params.getAsymGaussFunction();
-    
-    int peSignal = std::round(nPhotons * SiPMPDE);
-    peSiPM = peSignal;
-    double peSignalSat = 0;
-    if(params.getParameter("EcalSiPMDigiVerbose") == 0 || peSignal < 100) {
-        peSignalSat = rand.Poisson(peSignal) * (1 + SiPMCT);
+void TotalDigitizer::digitizeBatch(const double* energies, double* outputs, size_t n,
+                                   const BatchIntermediates* aux) {
+    // 闪烁体、SiPM、ADC 各级串联为一个内核；击中模式下按通道读取刻度表参数
+    if (calibration && batchRows) {
+        runChain<TotalChain>(energies, outputs, n, aux, ChannelParameters{calibration->columns(), batchRows});
     } else {
-        double peSignal_ = f_SiPMResponse->Eval(peSignal);
-        peSignalSat = rand.Gaus(peSignal_, f_SiPMSigmaDet->Eval(peSignal_));
+        runChain<TotalChain>(energies, outputs, n, aux, GlobalParameters{par});
     }
-    if(peSignalSat < 0) peSignalSat = 0;
-    peSiPMSat = peSignalSat;
-
-    // 计算暗噪声和串扰
-    double darkCount = rand.Poisson(darkRate * gateTime);
-    dc = darkCount;
-
-    int darkCount_CT = 0;
-    for(int i=0;i<darkCount;i++) {
-        double dark_rdm = rand.Uniform(0, 1);
-        int sum_darkcounts = 1;
-        if(! (dark_rdm <= f_DarkNoise->Eval(sum_darkcounts))) {
-            double prob = f_DarkNoise->Eval(sum_darkcounts);
-            while(dark_rdm > prob) {
-                sum_darkcounts++;
-                prob += f_DarkNoise->Eval(sum_darkcounts);
-            }
-        }
-        darkCount_CT += sum_darkcounts;
-    }
-    dcCT = darkCount_CT;
-
-    double signalSiPM = peSignalSat + darkCount_CT;
-    peSiPMSatDark = signalSiPM;
-    double SiPMCharge_sigma = std::sqrt(signalSiPM * pow(SiPMGainMean * SiPMGainSigma, 2));
-    double SiPMCharge = gRandom->Gaus(signalSiPM * SiPMGainMean, SiPMCharge_sigma);
-    peSiPMSatDarkGainFlu = SiPMCharge / SiPMGainMean;
-
-    double totalSignal_PedSub = SiPMCharge / SiPMGainMean - darkRate * gateTime * (1 + SiPMCT);
-
-    if(totalSignal_PedSub < 0){
-        signalSiPM = 0;
-        totalSignal_PedSub = 0;
-    }
-    else {
-        signalSiPM = totalSignal_PedSub;
-    }
-    peSiPMSatDarkGainFluPedSub = totalSignal_PedSub;
     
-    // ADC数字化
-    double FEENoiseSigma = params.getParameter("EcalFEENoiseSigma");
-    double ASICNoiseSigma = params.getParameter("EcalASICNoiseSigma");
-    double pedestal = params.getParameter("Pedestal");
-    int ADCbit = params.getParameter("ADCbit");
-    int adcSwitch = params.getParameter("ADCSwitch");
-    // int adcMax = std::pow(2, ADCbit) - 1;
-    int adcMax = adcSwitch;
-    double gainRatio12 = params.getParameter("GainRatio_12");
-    double gainRatio23 = params.getParameter("GainRatio_23");
-    double MIPThreshold = params.getParameter("EcalMIP_Thre");
- 
-    signalSiPM = signalSiPM * params.getParameter("EcalRatioTimeInterval");
-    peSiPMSatDarkGainFluPedSubCut = signalSiPM;
-
-    // 计算ADC值
-    double adcMean = signalSiPM * SiPMGainMean + pedestal;
-    double adcSigma = std::sqrt(FEENoiseSigma * FEENoiseSigma + ASICNoiseSigma * ASICNoiseSigma);
-    int adc = std::round(rand.Gaus(adcMean, adcSigma));
-    if (adc < 0) adc = 0;
-    adcInitial = adc;
-    // 增益范围1（高增益）
-    if (adc <= adcSwitch) {
-        gainMode = 1;
-        gain = SiPMGainMean;
-        noiseFEE = FEENoiseSigma;
-        noiseASIC = ASICNoiseSigma;
-
-        if(params.getParameter("EcalSiPMDigiVerbose") >= 2 && signalSiPM >= 100) {
-            double signalSiPM_ADCRec = (adc - pedestal) / SiPMGainMean;
-            double signalSiPM_ADCRec_mean = f_SiPMResponse->GetX(signalSiPM_ADCRec);
-            adc = signalSiPM_ADCRec_mean * SiPMGainMean + pedestal;
-        }
-
-        double pedestal_mean = pedestal + darkRate * gateTime * (1 + SiPMCT) * SiPMGainMean;
-        pedMean = pedestal_mean;
-
-        if(adc < 0) adc = 0;
-        adcGainCorr = SiPMGainMean;
-        
-        // 转换回能量
-        outputEnergy = (adc - pedestal_mean) / SiPMGainMean / (LY * SiPMPDE * Att);
-    }
-    else if(adc > adcSwitch && static_cast<int>(adc / gainRatio12) <= adcSwitch) {
-        gainMode = 2;
-        
-        // 调整增益和噪声
-        double adjustedGain = SiPMGainMean / gainRatio12;
-        double adjustedFEENoise = FEENoiseSigma / gainRatio12;
-
-        gain = adjustedGain;
-        noiseFEE = adjustedFEENoise;
-        noiseASIC = ASICNoiseSigma;
-
-        adcMean = signalSiPM * adjustedGain + pedestal;
-        adcSigma = std::sqrt(adjustedFEENoise * adjustedFEENoise + ASICNoiseSigma * ASICNoiseSigma);
-        adc = std::round(rand.Gaus(adcMean, adcSigma));
-        if (adc < 0) adc = 0;
-        adcInitial = adc;
-
-        if(params.getParameter("EcalSiPMDigiVerbose") >= 2 && signalSiPM >= 100) {
-            double signalSiPM_ADCRec = (adc - pedestal) / SiPMGainMean;
-            double signalSiPM_ADCRec_mean = f_SiPMResponse->GetX(signalSiPM_ADCRec);
-            adc = signalSiPM_ADCRec_mean * adjustedGain + pedestal;
-        }
-        double pedestal_mean = pedestal + darkRate * gateTime * (1 + SiPMCT) * adjustedGain;
-        pedMean = pedestal_mean;
-        
-        if(adc < 0) adc = 0;
-        adcGainCorr = adjustedGain;
-
-        // 转换回能量
-        outputEnergy = (adc - pedestal_mean) / adjustedGain / (LY * SiPMPDE * Att);
-    }
-    else if(static_cast<int>(adc / gainRatio12) > adcSwitch) {
-        gainMode = 3;
-
-        // 调整增益和噪声
-        double adjustedGain = SiPMGainMean / gainRatio12 / gainRatio23;
-        double adjustedFEENoise = FEENoiseSigma / gainRatio12 / gainRatio23;
-
-        gain = adjustedGain;
-        noiseFEE = adjustedFEENoise;
-        noiseASIC = ASICNoiseSigma;
-
-        adcMean = signalSiPM * adjustedGain + pedestal;
-        adcSigma = std::sqrt(adjustedFEENoise * adjustedFEENoise + ASICNoiseSigma * ASICNoiseSigma);
-        adc = std::round(rand.Gaus(adcMean, adcSigma));
-        if (adc < 0) adc = 0;
-        if(adc > adcMax) adc = adcMax;
-        adcInitial = adc;
-
-        if(params.getParameter("EcalSiPMDigiVerbose") >= 2 && signalSiPM >= 100) {
-            double signalSiPM_ADCRec = (adc - pedestal) / SiPMGainMean;
-            double signalSiPM_ADCRec_mean = f_SiPMResponse->GetX(signalSiPM_ADCRec);
-            adc = signalSiPM_ADCRec_mean * adjustedGain + pedestal;
-        }
-        
-        double pedestal_mean = pedestal + darkRate * gateTime * (1 + SiPMCT) * adjustedGain;
-        pedMean = pedestal_mean;
-
-        if(adc < 0) adc = 0;
-        adcGainCorr = adjustedGain;
-        
-        // 转换回能量
-        outputEnergy = (adc - pedestal_mean) / adjustedGain / (LY * SiPMPDE * Att);
-    }
-    if (outputEnergy < MIPThreshold * MIPEnergy) outputEnergy = 0;
     // 填充Tree
-    if(dataTree) dataTree->Fill();
-    
-    return outputEnergy;
+    fillTreesFromBatch(energies, outputs, n);
+}
+
+void TotalDigitizer::loadBatchEvent(size_t i) {
+    const EventState& s = eventStates[i];
+    inputEnergy = s.energy;
+    phScin = s.phScin;
+    phScinAtt = s.phScinAtt;
+    phScinAttLYRand = s.phScinAttLYRand;
+    peSiPM = s.peSiPM;
+    peSiPMSat = s.peSiPMSat;
+    dc = s.dc;
+    dcCT = s.dcCT;
+    peSiPMSatDark = s.peTotal;
+    peSiPMSatDarkGainFlu = s.gainFluc;
+    peSiPMSatDarkGainFluPedSub = s.pedSub;
+    peSiPMSatDarkGainFluPedSubCut = s.signal;
+    // adcInitial 分支保存所选档位的ADC值（饱和修正前）
+    adcInitial = s.adc;
+    adcGainCorr = s.gain;
+    gainMode = s.gainMode;
+    gain = s.gain;
+    noiseFEE = s.noiseFEE;
+    noiseASIC = s.noiseASIC;
+    pedMean = s.pedMean;
+    outputEnergy = s.output;
 }
 
 void TotalDigitizer::run(int nEvents) {
@@ -281,6 +100,37 @@ void TotalDigitizer::run(int nEvents) {
     calculateENE();
 }
 
+void TotalDigitizer::runConvolution(int nEvents) {
+    refreshParameters();
+    initializeHistograms();
+    
+    // 没有逐事件数据，不输出事件树
+    dataTree.reset();
+    samplingTree.reset();
+    
+    std::cout << "运行 " << moduleName << " 数值卷积 (" << energies.size() 
+              << " 个能量点, 名义事件数 " << nEvents << ")..." << std::endl;
+    
+    eventsPerPoint.assign(energies.size(), nEvents);
+    clearResponseSummaries();
+    
+    ConvolutionModel model(params);
+    for (size_t i = 0; i < energies.size(); ++i) {
+        if (i >= h_Energies.size() || !h_Energies[i] || i >= energyStats.size()) {
+            std::cerr << "错误：能量点 " << energies[i] << " MeV 的直方图未初始化" << std::endl;
+            eventsPerPoint[i] = 0;
+            continue;
+        }
+        
+        ConvolutionModel::ResponsePdf response = model.evaluate(energies[i]);
+        ConvolutionModel::fillHistogram(response, h_Energies[i].get(), nEvents);
+        recordResponseSummary(ConvolutionModel::summarize(response, energyStats[i].rangeMin, 
+                                                          energyStats[i].rangeMax, nEvents));
+    }
+    
+    calculateENE();
+}
+
 void TotalDigitizer::calculateENE() {
     double ENE[3]; // 三种增益下的等效噪声能量
     